@@ -2,75 +2,468 @@
 """
 Queue-Aware GPSR Results Analysis
 Processes simulation results and generates statistics
+
+Result files are parsed once and converted into a columnar on-disk cache
+(numpy arrays, memory-mapped on load) next to the results. Later invocations
+only parse files that are new or changed, so re-analysing a large sweep costs
+little more than reading the cached arrays.
 """
 
+import argparse
+import glob
+import hashlib
+import json
 import os
 import sys
-import glob
-import pandas as pd
-import numpy as np
+from concurrent.futures import ProcessPoolExecutor
 from pathlib import Path
 
+import numpy as np
+import pandas as pd
+
 PROJECT_ROOT = Path(__file__).parent.parent
 RESULTS_DIR = PROJECT_ROOT / "results"
+CACHE_VERSION = 1
+
+# Vectors needed by compute_statistics(); other vectors are skipped when a .vci index is available
+DELAY_VECTORS = ("endToEndDelay", "taskCompletionLatency")
+QUEUE_VECTORS = ("queueLength",)
+DEFAULT_VECTORS = DELAY_VECTORS + QUEUE_VECTORS
+
+CHUNK_LINES = 1 << 20
+
+#
+# Result file parsing
+#
+
+def split_fields(line):
+    """Split a header line of a result file, honoring double-quoted fields"""
+    if '"' not in line:
+        return line.split()
+    fields, current, quoted = [], "", False
+    for ch in line.strip():
+        if ch == '"':
+            quoted = not quoted
+        elif ch.isspace() and not quoted:
+            if current:
+                fields.append(current)
+            current = ""
+        else:
+            current += ch
+    if current:
+        fields.append(current)
+    return fields
+
+def base_name(name):
+    """Strip the recording mode suffix, e.g. endToEndDelay:vector -> endToEndDelay"""
+    return name.split(":", 1)[0]
+
+def parse_data_lines(lines):
+    """Convert vector data lines into (vectorId, time, value) arrays in one vectorized step"""
+    tokens = b" ".join(lines).split()
+    ncols = len(lines[0].split())
+    if len(tokens) == ncols * len(lines):
+        groups = [np.array(tokens, dtype=np.bytes_).astype(np.float64).reshape(-1, ncols)]
+    else:
+        # mixed column layouts (e.g. ETV and TV vectors in one file): group by width
+        by_width = {}
+        for line in lines:
+            fields = line.split()
+            by_width.setdefault(len(fields), []).extend(fields)
+        groups = [np.array(tok, dtype=np.bytes_).astype(np.float64).reshape(-1, width) for width, tok in by_width.items()]
+    ids, times, values = [], [], []
+    for arr in groups:
+        # ETV: id event time value, TV: id time value
+        ids.append(arr[:, 0].astype(np.int64))
+        times.append(arr[:, -2])
+        values.append(arr[:, -1])
+    return np.concatenate(ids), np.concatenate(times), np.concatenate(values)
+
+def parse_header(fields, runs, state):
+    """Handle run/attr/itervar lines; returns False for lines it does not own"""
+    kind = fields[0]
+    if kind == "run":
+        state["run"] = fields[1]
+        state["inVector"] = False
+        runs.setdefault(state["run"], {})
+    elif kind in ("attr", "itervar"):
+        if not state.get("inVector") and len(fields) >= 3:
+            runs[state["run"]][fields[1]] = fields[2]
+    elif kind not in ("version", "config", "param", "file"):
+        return False
+    return True
+
+def parse_scalar_file(path):
+    """Stream a .sca file into run attributes and parallel scalar columns"""
+    runs, state = {}, {}
+    run_col, module_col, name_col, value_col = [], [], [], []
+    with open(path) as f:
+        for line in f:
+            fields = split_fields(line)
+            if not fields or parse_header(fields, runs, state):
+                continue
+            if fields[0] == "scalar" and len(fields) >= 4:
+                module, name, value = fields[1], fields[2], fields[3]
+            elif fields[0] == "statistic" and len(fields) >= 3:
+                state["statistic"] = (fields[1], fields[2])
+                continue
+            elif fields[0] == "field" and "statistic" in state and len(fields) >= 3:
+                module, name = state["statistic"]
+                name, value = f"{name}:{fields[1]}", fields[2]
+            else:
+                continue
+            run_col.append(state["run"])
+            module_col.append(module)
+            name_col.append(name)
+            value_col.append(float(value) if value not in ("nan", "-nan") else np.nan)
+    return runs, run_col, module_col, name_col, np.array(value_col, dtype=np.float64)
+
+def parse_vector_index(path):
+    """Read a .vci index: vector declarations and the file blocks holding their data"""
+    runs, state, vectors = {}, {}, {}
+    with open(path) as f:
+        for line in f:
+            if line[:1].isdigit():
+                # block: vectorId offset size firstEvent lastEvent firstTime lastTime count ...
+                # (blocks of different vectors interleave, so the block names its vector)
+                fields = line.split()
+                vectors[int(fields[0])]["blocks"].append((int(fields[1]), int(fields[2])))
+                continue
+            fields = split_fields(line)
+            if not fields:
+                continue
+            if fields[0] == "vector" and len(fields) >= 4:
+                state["inVector"] = True
+                state["vector"] = int(fields[1])
+                vectors[state["vector"]] = {"id": int(fields[1]), "run": state["run"], "module": fields[2],
+                                            "name": fields[3], "blocks": []}
+                continue
+            parse_header(fields, runs, state)
+    return runs, vectors
+
+def read_vector_blocks(path, blocks):
+    """Read only the given byte ranges of a .vec file"""
+    ids, times, values = [], [], []
+    with open(path, "rb") as f:
+        for offset, size in blocks:
+            f.seek(offset)
+            lines = [l for l in f.read(size).splitlines() if l[:1].isdigit()]
+            if lines:
+                i, t, v = parse_data_lines(lines)
+                ids.append(i), times.append(t), values.append(v)
+    if not ids:
+        return np.empty(0, np.int64), np.empty(0), np.empty(0)
+    return np.concatenate(ids), np.concatenate(times), np.concatenate(values)
+
+def parse_vector_file(path, wanted, use_index=True):
+    """Stream a .vec file; with a .vci index only the blocks of wanted vectors are read"""
+    index = Path(path).with_suffix(".vci")
+    if index.exists() and use_index:
+        runs, vectors = parse_vector_index(index)
+        selected = [v for v in vectors.values() if base_name(v["name"]) in wanted]
+        ids, times, values = read_vector_blocks(path, [b for v in selected for b in v["blocks"]])
+        for v in vectors.values():
+            del v["blocks"]
+        return runs, vectors, ids, times, values
+
+    runs, state, vectors = {}, {}, {}
+    ids, times, values, pending = [], [], [], []
+    def flush():
+        if pending:
+            i, t, v = parse_data_lines(pending)
+            ids.append(i), times.append(t), values.append(v)
+            pending.clear()
+    with open(path, "rb") as f:
+        for raw in f:
+            if raw[:1].isdigit():
+                pending.append(raw)
+                if len(pending) >= CHUNK_LINES:
+                    flush()
+                continue
+            fields = split_fields(raw.decode())
+            if not fields:
+                continue
+            if fields[0] == "vector" and len(fields) >= 4:
+                state["inVector"] = True
+                vectors[int(fields[1])] = {"id": int(fields[1]), "run": state["run"], "module": fields[2], "name": fields[3]}
+                continue
+            parse_header(fields, runs, state)
+    flush()
+    if not ids:
+        return runs, vectors, np.empty(0, np.int64), np.empty(0), np.empty(0)
+    ids, times, values = np.concatenate(ids), np.concatenate(times), np.concatenate(values)
+    keep = np.isin(ids, [vid for vid, v in vectors.items() if base_name(v["name"]) in wanted])
+    return runs, vectors, ids[keep], times[keep], values[keep]
+
+def verify_vector_index(path, wanted):
+    """Compare the indexed read of a .vec file with a full scan; returns a list of mismatches"""
+    def per_vector(parsed):
+        _, vectors, ids, times, values = parsed
+        order = np.argsort(ids, kind="stable")
+        ids, times, values = ids[order], times[order], values[order]
+        return vectors, {vid: (times[ids == vid], values[ids == vid]) for vid in np.unique(ids).tolist()}
+    indexed_vectors, indexed = per_vector(parse_vector_file(path, wanted))
+    scanned_vectors, scanned = per_vector(parse_vector_file(path, wanted, use_index=False))
+    problems = []
+    if sorted(indexed_vectors) != sorted(scanned_vectors):
+        problems.append(f"{path}: index declares vectors {sorted(indexed_vectors)}, file {sorted(scanned_vectors)}")
+    for vid in sorted(set(indexed) | set(scanned)):
+        empty = (np.empty(0), np.empty(0))
+        (it, iv), (st, sv) = indexed.get(vid, empty), scanned.get(vid, empty)
+        if len(it) != len(st) or not (np.array_equal(it, st) and np.array_equal(iv, sv, equal_nan=True)):
+            problems.append(f"{path}: vector {vid} has {len(it)} indexed and {len(st)} scanned samples, or they differ")
+    return problems
+
+#
+# Columnar cache
+#
+
+def cache_entry(cache_dir, path, wanted=()):
+    """Cache directory of a result file; the key changes whenever the file (or vector selection) does"""
+    st = os.stat(path)
+    key = f"{CACHE_VERSION}:{os.path.abspath(path)}:{st.st_size}:{st.st_mtime_ns}:{','.join(sorted(wanted))}"
+    return Path(cache_dir) / f"{Path(path).name}-{hashlib.sha1(key.encode()).hexdigest()[:16]}"
+
+def build_scalar_cache(path, entry):
+    runs, run_col, module_col, name_col, values = parse_scalar_file(path)
+    entry.mkdir(parents=True, exist_ok=True)
+    columns = {}
+    for col, data in (("run", run_col), ("module", module_col), ("name", name_col)):
+        # strings are dictionary-encoded: one int32 code column plus a string table
+        table, codes = np.unique(np.array(data, dtype=object).astype(str), return_inverse=True) if data else (np.array([]), np.array([]))
+        np.save(entry / f"{col}.npy", codes.astype(np.int32))
+        columns[col] = table.tolist()
+    np.save(entry / "value.npy", values)
+    (entry / "meta.json").write_text(json.dumps({"source": str(path), "runs": runs, "strings": columns}))
+    return entry
+
+def build_vector_cache(path, entry, wanted):
+    runs, vectors, ids, times, values = parse_vector_file(path, set(wanted))
+    entry.mkdir(parents=True, exist_ok=True)
+    # sort by vector id (stable, so time order is kept) and store offsets for O(1) slicing
+    order = np.argsort(ids, kind="stable")
+    ids, times, values = ids[order], times[order], values[order]
+    vector_ids = np.array(sorted(vectors), dtype=np.int64)
+    offsets = np.searchsorted(ids, np.append(vector_ids, np.iinfo(np.int64).max))
+    np.save(entry / "time.npy", times)
+    np.save(entry / "value.npy", values)
+    np.save(entry / "offsets.npy", offsets)
+    meta = {"source": str(path), "runs": runs, "vectors": [vectors[v] for v in vector_ids.tolist()]}
+    (entry / "meta.json").write_text(json.dumps(meta))
+    return entry
 
-def load_scalar_results(pattern="*.sca"):
-    """Load scalar result files"""
-    files = glob.glob(str(RESULTS_DIR / pattern))
+def build_caches(jobs, workers):
+    """Parse uncached files in parallel, one process per file"""
+    if not jobs:
+        return
+    print(f"Parsing {len(jobs)} result file(s) into cache...")
+    with ProcessPoolExecutor(max_workers=workers) as pool:
+        for future in [pool.submit(*job) for job in jobs]:
+            future.result()
+
+def find_files(results_dir, pattern):
+    return sorted(glob.glob(str(Path(results_dir) / "**" / pattern), recursive=True))
+
+def run_frame(runs):
+    rows = [{"run": run, "config": attrs.get("configname", ""), "iterationvars": attrs.get("iterationvars", ""),
+             "repetition": attrs.get("repetition", "")} for run, attrs in runs.items()]
+    return pd.DataFrame(rows, columns=["run", "config", "iterationvars", "repetition"])
+
+#
+# Loading
+#
+
+def load_scalar_results(pattern="*.sca", results_dir=RESULTS_DIR, cache_dir=None, workers=None):
+    """Load scalar result files as a DataFrame (run, config, iterationvars, module, name, value)"""
+    files = find_files(results_dir, pattern)
     if not files:
         print(f"No result files found matching: {pattern}")
         return None
-    
+
     print(f"Found {len(files)} result file(s)")
-    # TODO: Parse OMNeT++ scalar files
-    # Use omnetpp.scavetool or pandas
-    return files
+    cache_dir = cache_dir or Path(results_dir) / ".analysis_cache"
+    entries = [cache_entry(cache_dir, f) for f in files]
+    build_caches([(build_scalar_cache, f, e) for f, e in zip(files, entries) if not (e / "meta.json").exists()], workers)
+
+    frames, runs = [], {}
+    for entry in entries:
+        meta = json.loads((entry / "meta.json").read_text())
+        runs.update(meta["runs"])
+        frame = pd.DataFrame({"value": np.load(entry / "value.npy", mmap_mode="r")})
+        for col in ("run", "module", "name"):
+            codes = np.load(entry / f"{col}.npy", mmap_mode="r")
+            frame[col] = pd.Categorical.from_codes(codes, categories=meta["strings"][col]) if len(codes) else []
+        frames.append(frame.astype({"run": str, "module": str, "name": str}))
+    scalars = pd.concat(frames, ignore_index=True)
+    return scalars.merge(run_frame(runs), on="run", how="left")
 
-def load_vector_results(pattern="*.vec"):
-    """Load vector result files"""
-    files = glob.glob(str(RESULTS_DIR / pattern))
+def load_vector_results(pattern="*.vec", results_dir=RESULTS_DIR, cache_dir=None, workers=None, wanted=DEFAULT_VECTORS):
+    """Load vector result files as a DataFrame of vectors with memory-mapped time/value arrays"""
+    files = find_files(results_dir, pattern)
     if not files:
         print(f"No result files found matching: {pattern}")
         return None
-    
+
     print(f"Found {len(files)} vector file(s)")
-    # TODO: Parse OMNeT++ vector files
-    return files
+    cache_dir = cache_dir or Path(results_dir) / ".analysis_cache"
+    entries = [cache_entry(cache_dir, f, wanted) for f in files]
+    build_caches([(build_vector_cache, f, e, wanted) for f, e in zip(files, entries) if not (e / "meta.json").exists()], workers)
+
+    rows, runs = [], {}
+    for entry in entries:
+        meta = json.loads((entry / "meta.json").read_text())
+        runs.update(meta["runs"])
+        times = np.load(entry / "time.npy", mmap_mode="r")
+        values = np.load(entry / "value.npy", mmap_mode="r")
+        offsets = np.load(entry / "offsets.npy")
+        for i, vector in enumerate(meta["vectors"]):
+            if base_name(vector["name"]) not in wanted:
+                continue
+            begin, end = offsets[i], offsets[i + 1]
+            rows.append({"run": vector["run"], "module": vector["module"], "name": base_name(vector["name"]),
+                         "time": times[begin:end], "value": values[begin:end]})
+    vectors = pd.DataFrame(rows, columns=["run", "module", "name", "time", "value"])
+    return vectors.merge(run_frame(runs), on="run", how="left")
+
+#
+# Statistics
+#
+
+def delay_statistics(vectors):
+    """End-to-end delay percentiles per run, over all samples of all receivers"""
+    rows = []
+    for (run, name), group in vectors[vectors["name"].isin(DELAY_VECTORS)].groupby(["run", "name"]):
+        samples = np.concatenate([np.asarray(v) for v in group["value"]]) if len(group) else np.empty(0)
+        if samples.size == 0:
+            continue
+        p50, p95, p99 = np.percentile(samples, [50, 95, 99])
+        rows.append({"run": run, "metric": name, "samples": samples.size, "mean": samples.mean(),
+                     "p50": p50, "p95": p95, "p99": p99, "max": samples.max()})
+    return pd.DataFrame(rows)
+
+def queue_statistics(vectors):
+    """Time-weighted queue length and busy fraction per run (queue vectors are step functions)"""
+    rows = []
+    for run, group in vectors[vectors["name"].isin(QUEUE_VECTORS)].groupby("run"):
+        end = max((float(t[-1]) for t in group["time"] if len(t)), default=0.0)
+        area = busy = observed = 0.0
+        for times, values in zip(group["time"], group["value"]):
+            if len(times) == 0 or end <= times[0]:
+                continue
+            durations = np.diff(np.append(np.asarray(times), end))
+            area += float(np.dot(durations, values))
+            busy += float(durations[np.asarray(values) > 0].sum())
+            observed += end - float(times[0])
+        if observed > 0:
+            rows.append({"run": run, "meanQueueLength": area / observed, "queueUtilization": busy / observed})
+    return pd.DataFrame(rows)
+
+def scalar_sum(scalars, name, module_suffix):
+    """Per-run sum of a scalar over modules whose path ends in module_suffix"""
+    mask = (scalars["name"] == name) & scalars["module"].str.contains(module_suffix + "$", regex=True)
+    return scalars[mask].groupby("run")["value"].sum()
 
 def compute_statistics(data):
     """Compute key statistics"""
-    # TODO: Implement statistical analysis
-    # - End-to-end delay (mean, median, percentiles)
-    # - Packet delivery ratio
-    # - Routing overhead
-    # - Queue utilization
-    pass
-
-def generate_report(results):
+    scalars, vectors = data
+    per_run = []
+
+    if scalars is not None:
+        # Packet delivery ratio over all UDP applications
+        sent = scalar_sum(scalars, "packetSent:count", r"\.app\[\d+\]")
+        received = scalar_sum(scalars, "packetReceived:count", r"\.app\[\d+\]")
+        # Routing overhead: UDP packets not sent by applications are GPSR beacons
+        udp_sent = scalar_sum(scalars, "packetSent:count", r"\.udp")
+        frame = pd.DataFrame({"packetsSent": sent, "packetsReceived": received})
+        frame["pdr"] = frame["packetsReceived"] / frame["packetsSent"].replace(0, np.nan)
+        frame["controlPackets"] = (udp_sent - sent).clip(lower=0)
+        frame["overheadPerDelivered"] = frame["controlPackets"] / frame["packetsReceived"].replace(0, np.nan)
+        for name in ("tiebreakerActivations", "tasksProcessed", "tasksDeadlineMissed"):
+            frame[name] = scalars[scalars["name"] == name].groupby("run")["value"].sum()
+        per_run.append(frame)
+
+    delays = pd.DataFrame()
+    if vectors is not None and len(vectors):
+        delays = delay_statistics(vectors)
+        if len(delays):
+            wide = delays.pivot(index="run", columns="metric", values=["mean", "p50", "p95", "p99"])
+            wide.columns = [f"{metric}.{stat}" for stat, metric in wide.columns]
+            per_run.append(wide)
+        queues = queue_statistics(vectors)
+        if len(queues):
+            per_run.append(queues.set_index("run"))
+
+    if not per_run:
+        return None
+    runs = pd.concat(per_run, axis=1)
+    runs.index.name = "run"
+    attrs = pd.concat([f[["run", "config", "iterationvars"]] for f in (scalars, vectors) if f is not None]).drop_duplicates("run")
+    runs = runs.reset_index().merge(attrs, on="run", how="left")
+    # average repetitions of the same configuration/iteration
+    summary = runs.groupby(["config", "iterationvars"], dropna=False).mean(numeric_only=True)
+    summary["runs"] = runs.groupby(["config", "iterationvars"], dropna=False).size()
+    return {"runs": runs, "summary": summary.reset_index(), "delays": delays}
+
+def generate_report(results, output=None):
     """Generate analysis report"""
-    # TODO: Create markdown/text report
-    pass
+    output = output or RESULTS_DIR / "analysis_report.md"
+    summary = results["summary"]
+    lines = ["# Queue-Aware GPSR Results", "", f"{len(results['runs'])} run(s), {len(summary)} configuration(s)", ""]
+    for _, row in summary.iterrows():
+        title = row["config"] + (f" ({row['iterationvars']})" if row["iterationvars"] else "")
+        lines += [f"## {title}", "", "| Metric | Value |", "|---|---|"]
+        for metric, value in row.items():
+            if metric in ("config", "iterationvars") or pd.isna(value):
+                continue
+            lines.append(f"| {metric} | {value:.6g} |")
+        lines.append("")
+    Path(output).write_text("\n".join(lines))
+    print("\n".join(lines))
+    print(f"Report written to {output}")
 
 def main():
+    parser = argparse.ArgumentParser(description="Analyze Queue-Aware GPSR simulation results")
+    parser.add_argument("--results-dir", type=Path, default=RESULTS_DIR)
+    parser.add_argument("--cache-dir", type=Path, default=None, help="columnar cache (default: <results-dir>/.analysis_cache)")
+    parser.add_argument("-j", "--jobs", type=int, default=os.cpu_count(), help="parallel parser processes")
+    parser.add_argument("--output", type=Path, default=None, help="report file (default: <results-dir>/analysis_report.md)")
+    parser.add_argument("--csv", type=Path, default=None, help="also write per-run statistics as CSV")
+    parser.add_argument("--verify-index", action="store_true",
+                        help="check that every .vci index reads the same samples as a full scan of its .vec file")
+    args = parser.parse_args()
+
     print("=" * 60)
     print("Queue-Aware GPSR Results Analysis")
     print("=" * 60)
     print()
-    
-    if not RESULTS_DIR.exists():
-        print(f"Error: Results directory not found: {RESULTS_DIR}")
+
+    if not args.results_dir.exists():
+        print(f"Error: Results directory not found: {args.results_dir}")
         sys.exit(1)
-    
+
+    if args.verify_index:
+        pairs = [f for f in find_files(args.results_dir, "*.vec") if Path(f).with_suffix(".vci").exists()]
+        problems = [p for f in pairs for p in verify_vector_index(f, set(DEFAULT_VECTORS))]
+        for problem in problems:
+            print(problem)
+        print(f"Checked {len(pairs)} .vci/.vec pair(s): {'FAILED' if problems else 'ok'}")
+        sys.exit(1 if problems else 0)
+
     # Load results
-    scalar_files = load_scalar_results()
-    vector_files = load_vector_results()
-    
-    if not scalar_files and not vector_files:
+    scalars = load_scalar_results(results_dir=args.results_dir, cache_dir=args.cache_dir, workers=args.jobs)
+    vectors = load_vector_results(results_dir=args.results_dir, cache_dir=args.cache_dir, workers=args.jobs)
+
+    if scalars is None and vectors is None:
         print("No result files found. Run simulations first.")
         sys.exit(1)
-    
-    # TODO: Implement full analysis pipeline
-    print("\nAnalysis complete. (Implementation pending)")
+
+    results = compute_statistics((scalars, vectors))
+    if results is None:
+        print("No recognized statistics in the result files.")
+        sys.exit(1)
+    if args.csv:
+        results["runs"].to_csv(args.csv, index=False)
+    generate_report(results, args.output or args.results_dir / "analysis_report.md")
 
 if __name__ == "__main__":
     main()
@@ -0,0 +1,292 @@
+#!/usr/bin/env python3
+"""
+Parallel Parameter-Sweep Runner
+Expands omnetpp.ini configurations (iteration variables x repetitions) into
+individual runs, executes them across all cores and merges the .sca/.vec
+outputs into a single indexed SQLite result store.
+
+Usage:
+    scripts/run_sweep.py simulations/delay_tiebreaker/omnetpp.ini \\
+        -c MultiHopPerformanceBaseline -c MultiHopPerformanceEnhanced -j 8
+
+Interrupted sweeps can simply be restarted: runs that already completed
+(marker file present) are skipped, and result files already merged into the
+store are not ingested twice.
+"""
+
+import argparse
+import os
+import re
+import sqlite3
+import subprocess
+import sys
+import time
+from concurrent.futures import ThreadPoolExecutor, as_completed
+from pathlib import Path
+
+PROJECT_ROOT = Path(__file__).resolve().parent.parent
+DEFAULT_EXECUTABLE = PROJECT_ROOT / "Research_project"
+DEFAULT_NED_PATH = f"{PROJECT_ROOT / 'src'}:{PROJECT_ROOT.parent / 'inet4.5' / 'src'}:."
+DEFAULT_RESULT_DIR = PROJECT_ROOT / "results" / "sweep"
+DEFAULT_LOG_DIR = PROJECT_ROOT / "logs" / "sweep"
+
+RUN_LINE = re.compile(r"^Run (\d+):\s*(.*)$")
+
+#
+# Run expansion
+#
+
+def base_command(args, ini):
+    return [str(args.executable), "-u", "Cmdenv", "-n", args.ned_path, "-f", ini.name]
+
+def expand_runs(args, ini, config):
+    """Ask the simulation binary to expand a config into (runNumber, iterationvars) pairs"""
+    cmd = base_command(args, ini) + ["-c", config, "-s", "-q", "runs"]
+    out = subprocess.run(cmd, cwd=ini.parent, capture_output=True, text=True)
+    runs = []
+    for line in out.stdout.splitlines():
+        match = RUN_LINE.match(line.strip())
+        if match:
+            runs.append((int(match.group(1)), match.group(2).strip()))
+    if not runs:
+        # older releases only support "numruns"
+        cmd = base_command(args, ini) + ["-c", config, "-s", "-q", "numruns"]
+        out = subprocess.run(cmd, cwd=ini.parent, capture_output=True, text=True)
+        numbers = [int(tok) for tok in out.stdout.split() if tok.isdigit()]
+        if not numbers:
+            raise RuntimeError(f"Cannot expand config {config}: {out.stderr.strip() or out.stdout.strip()}")
+        runs = [(i, "") for i in range(numbers[-1])]
+    return runs
+
+#
+# Job execution
+#
+
+def job_paths(args, config, run):
+    stem = f"{config}-#{run}"
+    return {
+        "sca": args.result_dir / f"{stem}.sca",
+        "vec": args.result_dir / f"{stem}.vec",
+        "done": args.result_dir / f"{stem}.done",
+        "log": args.log_dir / f"{stem}.log",
+    }
+
+def run_job(args, ini, config, run):
+    paths = job_paths(args, config, run)
+    cmd = base_command(args, ini) + [
+        "-c", config, "-r", str(run),
+        f"--result-dir={args.result_dir}",
+        f"--output-scalar-file={paths['sca']}",
+        f"--output-vector-file={paths['vec']}",
+    ]
+    if args.sim_time_limit:
+        cmd.append(f"--sim-time-limit={args.sim_time_limit}")
+    # a rerun (--no-resume) invalidates the old marker until it finishes cleanly itself,
+    # otherwise a failed rerun would leave partial result files marked as complete
+    paths["done"].unlink(missing_ok=True)
+    start = time.time()
+    with open(paths["log"], "w") as log:
+        code = subprocess.run(cmd, cwd=ini.parent, stdout=log, stderr=subprocess.STDOUT).returncode
+    if code == 0:
+        # completion marker: a run is only skipped on resume if it finished cleanly
+        paths["done"].write_text(f"{time.time() - start:.1f}\n")
+    return config, run, code, time.time() - start
+
+#
+# Result store
+#
+
+SCHEMA = """
+CREATE TABLE IF NOT EXISTS files (path TEXT PRIMARY KEY, mtime REAL, runId TEXT);
+CREATE TABLE IF NOT EXISTS runs (runId TEXT PRIMARY KEY, config TEXT, runNumber INTEGER, iterationvars TEXT);
+CREATE TABLE IF NOT EXISTS runattrs (runId TEXT, name TEXT, value TEXT, PRIMARY KEY (runId, name));
+CREATE TABLE IF NOT EXISTS scalars (runId TEXT, module TEXT, name TEXT, value REAL);
+CREATE TABLE IF NOT EXISTS vectors (vectorKey INTEGER PRIMARY KEY AUTOINCREMENT, runId TEXT, vectorId INTEGER, module TEXT, name TEXT);
+CREATE TABLE IF NOT EXISTS vectordata (vectorKey INTEGER, eventNumber INTEGER, time REAL, value REAL);
+CREATE INDEX IF NOT EXISTS scalars_name ON scalars (name, module);
+CREATE INDEX IF NOT EXISTS scalars_run ON scalars (runId);
+CREATE INDEX IF NOT EXISTS vectors_name ON vectors (name, module);
+CREATE INDEX IF NOT EXISTS vectordata_key ON vectordata (vectorKey);
+"""
+
+def split_fields(line):
+    """Split a result file line, honoring double-quoted fields"""
+    if '"' not in line:
+        return line.split()
+    return [tok.strip('"') for tok in re.findall(r'"(?:[^"\\]|\\.)*"|\S+', line)]
+
+def to_float(text):
+    try:
+        return float(text)
+    except ValueError:
+        return float("nan")
+
+def ingest_header(db, fields, state):
+    """Handle run/attr/itervar lines shared by .sca and .vec files"""
+    kind = fields[0]
+    if kind == "run":
+        state["runId"] = fields[1]
+        state["attrs"] = {}
+    elif kind in ("attr", "itervar") and len(fields) >= 3 and not state.get("inVector"):
+        state["attrs"][fields[1]] = fields[2]
+        db.execute("INSERT OR IGNORE INTO runattrs VALUES (?, ?, ?)", (state["runId"], fields[1], fields[2]))
+    elif kind in ("config", "param", "version"):
+        pass
+    else:
+        return False
+    return True
+
+def finish_run(db, state):
+    attrs = state.get("attrs", {})
+    db.execute("INSERT OR IGNORE INTO runs VALUES (?, ?, ?, ?)",
+               (state["runId"], attrs.get("configname"), int(attrs.get("runnumber", -1)), attrs.get("iterationvars", "")))
+
+def ingest_scalars(db, path):
+    state = {}
+    with open(path) as f:
+        for line in f:
+            fields = split_fields(line)
+            if not fields:
+                continue
+            if fields[0] == "run" and "runId" in state:
+                finish_run(db, state)
+            if ingest_header(db, fields, state):
+                continue
+            if fields[0] == "scalar" and len(fields) >= 4:
+                db.execute("INSERT INTO scalars VALUES (?, ?, ?, ?)", (state["runId"], fields[1], fields[2], to_float(fields[3])))
+            elif fields[0] == "statistic" and len(fields) >= 3:
+                state["statistic"] = (fields[1], fields[2])
+            elif fields[0] == "field" and "statistic" in state and len(fields) >= 3:
+                # statistic fields are stored as scalars named <statistic>:<field>
+                module, name = state["statistic"]
+                db.execute("INSERT INTO scalars VALUES (?, ?, ?, ?)", (state["runId"], module, f"{name}:{fields[1]}", to_float(fields[2])))
+    if "runId" in state:
+        finish_run(db, state)
+    return state.get("runId")
+
+def ingest_vectors(db, path, batch_size=50000):
+    state = {}
+    vector_keys = {}
+    batch = []
+    with open(path) as f:
+        for line in f:
+            if line[:1].isdigit():
+                # data line: vectorId eventNumber time value (ETV)
+                fields = line.split()
+                key = vector_keys.get(int(fields[0]))
+                if key is not None and len(fields) >= 4:
+                    batch.append((key, int(fields[1]), float(fields[2]), to_float(fields[3])))
+                    if len(batch) >= batch_size:
+                        db.executemany("INSERT INTO vectordata VALUES (?, ?, ?, ?)", batch)
+                        batch.clear()
+                continue
+            fields = split_fields(line)
+            if not fields:
+                continue
+            if fields[0] == "run" and "runId" in state:
+                finish_run(db, state)
+            if fields[0] == "vector" and len(fields) >= 4:
+                # attr lines following a vector declaration describe the vector, not the run
+                state["inVector"] = True
+                cursor = db.execute("INSERT INTO vectors (runId, vectorId, module, name) VALUES (?, ?, ?, ?)",
+                                    (state["runId"], int(fields[1]), fields[2], fields[3]))
+                vector_keys[int(fields[1])] = cursor.lastrowid
+                continue
+            ingest_header(db, fields, state)
+    if batch:
+        db.executemany("INSERT INTO vectordata VALUES (?, ?, ?, ?)", batch)
+    if "runId" in state:
+        finish_run(db, state)
+    return state.get("runId")
+
+def forget_run(db, run_id):
+    """Remove a run's rows so that a rerun replaces rather than duplicates them"""
+    db.execute("DELETE FROM vectordata WHERE vectorKey IN (SELECT vectorKey FROM vectors WHERE runId = ?)", (run_id,))
+    for table in ("vectors", "scalars", "runattrs", "runs", "files"):
+        db.execute(f"DELETE FROM {table} WHERE runId = ?", (run_id,))
+
+def merge_results(store, result_dir):
+    """Merge new or modified result files of completed runs into the store"""
+    db = sqlite3.connect(store)
+    db.executescript(SCHEMA)
+    merged = 0
+    for path in sorted(list(result_dir.glob("*.sca")) + list(result_dir.glob("*.vec"))):
+        if not path.with_suffix(".done").exists():
+            continue  # run failed or is still in progress
+        mtime = path.stat().st_mtime
+        row = db.execute("SELECT mtime, runId FROM files WHERE path = ?", (str(path),)).fetchone()
+        if row and row[0] == mtime:
+            continue
+        if row:
+            forget_run(db, row[1])
+        if path.suffix == ".sca":
+            run_id = ingest_scalars(db, path)
+        else:
+            run_id = ingest_vectors(db, path)
+        db.execute("INSERT INTO files VALUES (?, ?, ?)", (str(path), mtime, run_id))
+        db.commit()
+        merged += 1
+    db.close()
+    return merged
+
+#
+# Main
+#
+
+def main():
+    parser = argparse.ArgumentParser(description="Run an OMNeT++ parameter sweep in parallel and merge the results")
+    parser.add_argument("ini", type=Path, help="omnetpp.ini file")
+    parser.add_argument("-c", "--config", action="append", required=True, help="configuration to sweep (repeatable)")
+    parser.add_argument("-j", "--jobs", type=int, default=os.cpu_count(), help="parallel runs (default: all cores)")
+    parser.add_argument("--executable", type=Path, default=DEFAULT_EXECUTABLE, help="simulation binary")
+    parser.add_argument("--ned-path", default=DEFAULT_NED_PATH, help="NED path passed with -n")
+    parser.add_argument("--result-dir", type=Path, default=DEFAULT_RESULT_DIR)
+    parser.add_argument("--log-dir", type=Path, default=DEFAULT_LOG_DIR)
+    parser.add_argument("--store", type=Path, default=None, help="SQLite result store (default: <result-dir>/results.db)")
+    parser.add_argument("--sim-time-limit", default=None)
+    parser.add_argument("--no-resume", action="store_true", help="rerun runs that already completed")
+    parser.add_argument("--merge-only", action="store_true", help="only merge existing result files into the store")
+    args = parser.parse_args()
+
+    args.ini = args.ini.resolve()
+    args.executable = args.executable.resolve()
+    args.result_dir = args.result_dir.resolve()
+    args.result_dir.mkdir(parents=True, exist_ok=True)
+    args.log_dir.mkdir(parents=True, exist_ok=True)
+    store = args.store or args.result_dir / "results.db"
+
+    print("=" * 60)
+    print("Queue-Aware GPSR Parameter Sweep")
+    print("=" * 60)
+
+    if not args.merge_only:
+        jobs = []
+        for config in args.config:
+            runs = expand_runs(args, args.ini, config)
+            print(f"{config}: {len(runs)} run(s)")
+            for run, itervars in runs:
+                if not args.no_resume and job_paths(args, config, run)["done"].exists():
+                    continue
+                jobs.append((config, run, itervars))
+        print(f"{len(jobs)} run(s) to execute on {args.jobs} worker(s)\n")
+
+        failed = []
+        with ThreadPoolExecutor(max_workers=args.jobs) as pool:
+            futures = [pool.submit(run_job, args, args.ini, config, run) for config, run, _ in jobs]
+            for done, future in enumerate(as_completed(futures), 1):
+                config, run, code, elapsed = future.result()
+                status = "ok" if code == 0 else f"FAILED (exit {code})"
+                print(f"[{done}/{len(jobs)}] {config} #{run}: {status} in {elapsed:.1f}s")
+                if code != 0:
+                    failed.append(job_paths(args, config, run)["log"])
+        if failed:
+            print("\nFailed runs (see logs):")
+            for log in failed:
+                print(f"  {log}")
+
+    merged = merge_results(store, args.result_dir)
+    print(f"\nMerged {merged} new result file(s) into {store}")
+    return 0
+
+if __name__ == "__main__":
+    sys.exit(main())
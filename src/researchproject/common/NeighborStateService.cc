@@ -0,0 +1,105 @@
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+//
+
+#include <algorithm>
+
+#include "NeighborStateService.h"
+
+namespace researchproject {
+
+Define_Module(NeighborStateService);
+
+void NeighborStateService::initialize()
+{
+    WATCH(numUpdates);
+}
+
+void NeighborStateService::handleMessage(cMessage *message)
+{
+    throw cRuntimeError("This module does not process messages");
+}
+
+void NeighborStateService::refreshDisplay() const
+{
+    char text[32];
+    snprintf(text, sizeof(text), "%d neighbors", (int)neighbors.size());
+    getDisplayString().setTagArg("t", 0, text);
+}
+
+void NeighborStateService::finish()
+{
+    recordScalar("neighborStateUpdates", numUpdates);
+}
+
+void NeighborStateService::updateNeighbor(const L3Address& address, const NeighborState& state)
+{
+    Enter_Method("updateNeighbor");
+    neighbors[address] = state;
+    numUpdates++;
+    EV_DEBUG << "Updated neighbor state: address = " << address << ", position = " << state.position << endl;
+}
+
+void NeighborStateService::removeNeighbor(const L3Address& address)
+{
+    Enter_Method("removeNeighbor");
+    neighbors.erase(address);
+}
+
+void NeighborStateService::removeOldNeighbors(simtime_t lastUpdateBefore)
+{
+    Enter_Method("removeOldNeighbors");
+    for (auto it = neighbors.begin(); it != neighbors.end();) {
+        if (it->second.lastUpdate < lastUpdateBefore)
+            it = neighbors.erase(it);
+        else
+            ++it;
+    }
+}
+
+void NeighborStateService::clear()
+{
+    Enter_Method("clear");
+    neighbors.clear();
+}
+
+const NeighborStateService::NeighborState *NeighborStateService::findNeighbor(const L3Address& address) const
+{
+    auto it = neighbors.find(address);
+    return it != neighbors.end() ? &it->second : nullptr;
+}
+
+std::vector<L3Address> NeighborStateService::getNeighborAddresses() const
+{
+    std::vector<L3Address> addresses;
+    for (const auto& it : neighbors)
+        addresses.push_back(it.first);
+    return addresses;
+}
+
+std::vector<L3Address> NeighborStateService::getFreshNeighborAddresses(simtime_t maxAge) const
+{
+    std::vector<L3Address> addresses;
+    for (const auto& it : neighbors)
+        if (simTime() - it.second.lastUpdate <= maxAge)
+            addresses.push_back(it.first);
+    return addresses;
+}
+
+simtime_t NeighborStateService::getOldestUpdate() const
+{
+    simtime_t oldestUpdate = SimTime::getMaxTime();
+    for (const auto& it : neighbors)
+        oldestUpdate = std::min(oldestUpdate, it.second.lastUpdate);
+    return oldestUpdate;
+}
+
+Coord NeighborStateService::getExtrapolatedPosition(const L3Address& address, simtime_t time) const
+{
+    const NeighborState *state = findNeighbor(address);
+    if (state == nullptr)
+        throw cRuntimeError("Unknown neighbor %s", address.str().c_str());
+    return state->position + state->velocity * (time - state->lastUpdate).dbl();
+}
+
+} // namespace researchproject
@@ -0,0 +1,80 @@
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+//
+
+#ifndef __RESEARCHPROJECT_NEIGHBORSTATESERVICE_H
+#define __RESEARCHPROJECT_NEIGHBORSTATESERVICE_H
+
+#include <map>
+#include <vector>
+
+#include "inet/common/geometry/common/Coord.h"
+#include "inet/networklayer/common/L3Address.h"
+
+using namespace omnetpp;
+using namespace inet;
+
+namespace researchproject {
+
+/**
+ * Per-node table of what the neighbors last advertised: position and
+ * velocity, link rate, TX backlog and MAC queue sojourn time, and CPU
+ * offload capacity.
+ *
+ * The module that runs neighbor discovery (QueueGpsr) is the only writer; it
+ * updates an entry once per received beacon (or oracle discovery tick) and
+ * removes entries when the neighbor expires or the node goes down. Routing,
+ * offload logic and applications of the same node read the table through
+ * this C++ interface instead of parsing beacons or keeping their own copies.
+ * Entries carry their update time, so readers decide themselves how old
+ * information they accept.
+ */
+class NeighborStateService : public cSimpleModule
+{
+  public:
+    struct NeighborState {
+        Coord position;
+        Coord velocity;                     // m/s, when the beacon was created
+        double txBitrate = 0;               // bps, 0 = unknown
+        uint32_t backlogBytes = 0;          // TX backlog
+        double sojournTime = -1;            // MAC queue sojourn time (s), negative = not advertised
+        double linkDelayMean = -1;          // our link to the neighbor as measured by it (s), negative = unknown
+        double linkDelayVariance = 0;
+        double cpuOffloadHz = 0;            // effective CPU capacity available for offloading
+        double cpuOffloadBacklogCycles = 0;
+        simtime_t lastUpdate;               // when the advertised state was valid
+    };
+
+  protected:
+    std::map<L3Address, NeighborState> neighbors;
+    long numUpdates = 0;
+
+  protected:
+    virtual void initialize() override;
+    virtual void handleMessage(cMessage *message) override;
+    virtual void refreshDisplay() const override;
+    virtual void finish() override;
+
+  public:
+    // writer interface
+    void updateNeighbor(const L3Address& address, const NeighborState& state);
+    void removeNeighbor(const L3Address& address);
+    void removeOldNeighbors(simtime_t lastUpdateBefore);
+    void clear();
+
+    // reader interface
+    int getNumNeighbors() const { return neighbors.size(); }
+    bool hasNeighbor(const L3Address& address) const { return neighbors.find(address) != neighbors.end(); }
+    const NeighborState *findNeighbor(const L3Address& address) const;
+    std::vector<L3Address> getNeighborAddresses() const;
+    // Neighbors whose state is at most maxAge old at the current simulation time
+    std::vector<L3Address> getFreshNeighborAddresses(simtime_t maxAge) const;
+    // Update time of the stalest entry, SimTime::getMaxTime() if there are no neighbors
+    simtime_t getOldestUpdate() const;
+    // Last advertised position moved along the advertised velocity to the given time
+    Coord getExtrapolatedPosition(const L3Address& address, simtime_t time) const;
+};
+
+} // namespace researchproject
+
+#endif
@@ -0,0 +1,133 @@
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+//
+
+#ifndef __RESEARCHPROJECT_SPATIALGRIDINDEX_H
+#define __RESEARCHPROJECT_SPATIALGRIDINDEX_H
+
+#include <cmath>
+#include <cstdint>
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+#include "inet/common/geometry/common/Coord.h"
+
+namespace researchproject {
+
+/**
+ * Uniform grid over 3D space for fixed-radius neighbor queries.
+ *
+ * Every key is stored with its position and a value in the cell containing
+ * the position. A range query visits the cells overlapping the bounding box
+ * of the query sphere and checks the exact distance, so with the cell size
+ * equal to the query range it inspects 27 cells (9 in a plane) instead of
+ * every key. Keys must be ordered (operator<).
+ */
+template <typename Key, typename Value>
+class SpatialGridIndex
+{
+  private:
+    struct Cell {
+        int64_t x, y, z;
+        bool operator==(const Cell& other) const { return x == other.x && y == other.y && z == other.z; }
+    };
+    struct CellHash {
+        size_t operator()(const Cell& cell) const {
+            return std::hash<int64_t>()(cell.x * 73856093 ^ cell.y * 19349663 ^ cell.z * 83492791);
+        }
+    };
+    struct Entry {
+        inet::Coord position;
+        Value value;
+        Cell cell;
+    };
+
+    double cellSize = 0;
+    std::map<Key, Entry> entries;
+    std::unordered_map<Cell, std::vector<Key>, CellHash> cells;
+
+    Cell getCell(const inet::Coord& position) const {
+        return Cell { (int64_t)std::floor(position.x / cellSize), (int64_t)std::floor(position.y / cellSize), (int64_t)std::floor(position.z / cellSize) };
+    }
+
+    void removeFromCell(const Cell& cell, const Key& key) {
+        auto it = cells.find(cell);
+        if (it == cells.end())
+            return;
+        auto& keys = it->second;
+        for (size_t i = 0; i < keys.size(); i++) {
+            if (!(keys[i] < key) && !(key < keys[i])) {
+                keys[i] = keys.back();
+                keys.pop_back();
+                break;
+            }
+        }
+        if (keys.empty())
+            cells.erase(it);
+    }
+
+  public:
+    // The cell size can only change while the index is empty
+    bool setCellSize(double size) {
+        if (size <= 0 || (!entries.empty() && size != cellSize))
+            return false;
+        cellSize = size;
+        return true;
+    }
+    double getCellSize() const { return cellSize; }
+    size_t size() const { return entries.size(); }
+
+    void update(const Key& key, const inet::Coord& position, const Value& value) {
+        Cell cell = getCell(position);
+        auto it = entries.find(key);
+        if (it == entries.end()) {
+            entries.emplace(key, Entry { position, value, cell });
+            cells[cell].push_back(key);
+            return;
+        }
+        if (!(it->second.cell == cell)) {
+            removeFromCell(it->second.cell, key);
+            cells[cell].push_back(key);
+        }
+        it->second = Entry { position, value, cell };
+    }
+
+    void remove(const Key& key) {
+        auto it = entries.find(key);
+        if (it == entries.end())
+            return;
+        removeFromCell(it->second.cell, key);
+        entries.erase(it);
+    }
+
+    void clear() {
+        entries.clear();
+        cells.clear();
+    }
+
+    // Calls f(key, position, value) for every key within range of center (inclusive)
+    template <typename F>
+    void forEachWithinRange(const inet::Coord& center, double range, F f) const {
+        Cell low = getCell(center - inet::Coord(range, range, range));
+        Cell high = getCell(center + inet::Coord(range, range, range));
+        for (int64_t x = low.x; x <= high.x; x++) {
+            for (int64_t y = low.y; y <= high.y; y++) {
+                for (int64_t z = low.z; z <= high.z; z++) {
+                    auto it = cells.find(Cell { x, y, z });
+                    if (it == cells.end())
+                        continue;
+                    for (const Key& key : it->second) {
+                        const Entry& entry = entries.at(key);
+                        if (entry.position.distance(center) <= range)
+                            f(key, entry.position, entry.value);
+                    }
+                }
+            }
+        }
+    }
+};
+
+} // namespace researchproject
+
+#endif
@@ -0,0 +1,324 @@
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+//
+
+#include "SojournFairQueue.h"
+#include <algorithm>
+#include <cmath>
+#include "inet/common/ModuleAccess.h"
+#include "inet/common/ProtocolTag_m.h"
+#include "inet/common/Simsignals.h"
+#include "inet/common/packet/dissector/PacketDissector.h"
+#include "inet/common/packet/dissector/ProtocolDissectorRegistry.h"
+#include "inet/linklayer/common/MacAddressTag_m.h"
+#include "inet/networklayer/base/NetworkHeaderBase_m.h"
+
+using namespace omnetpp;
+using namespace inet;
+
+namespace researchproject {
+
+Define_Module(SojournFairQueue);
+
+namespace {
+
+// Remembers the first network header while dissecting a MAC frame
+class NetworkHeaderFinder : public PacketDissector::ICallback
+{
+  public:
+    Ptr<const NetworkHeaderBase> header;
+
+    virtual bool shouldDissectProtocolDataUnit(const Protocol *protocol) override { return header == nullptr; }
+    virtual void startProtocolDataUnit(const Protocol *protocol) override {}
+    virtual void endProtocolDataUnit(const Protocol *protocol) override {}
+    virtual void markIncorrect() override {}
+    virtual void visitChunk(const Ptr<const Chunk>& chunk, const Protocol *protocol) override {
+        if (header == nullptr)
+            header = dynamicPtrCast<const NetworkHeaderBase>(chunk);
+    }
+};
+
+} // namespace
+
+void SojournFairQueue::initialize(int stage)
+{
+    PacketQueueBase::initialize(stage);
+    if (stage == INITSTAGE_LOCAL) {
+        inputGate = gate("in");
+        producer = findConnectedModule<queueing::IActivePacketSource>(inputGate);
+        outputGate = gate("out");
+        collector = findConnectedModule<queueing::IActivePacketSink>(outputGate);
+        packetCapacity = par("packetCapacity");
+        dataCapacity = b(par("dataCapacity"));
+        const char *flowKeyString = par("flowKey");
+        if (!strcmp(flowKeyString, "nextHop"))
+            flowKeyMode = FLOW_KEY_NEXT_HOP;
+        else if (!strcmp(flowKeyString, "destination"))
+            flowKeyMode = FLOW_KEY_DESTINATION;
+        else if (!strcmp(flowKeyString, "flow"))
+            flowKeyMode = FLOW_KEY_FLOW;
+        else
+            throw cRuntimeError("Unknown flowKey '%s'", flowKeyString);
+        quantum = B(par("quantum")).get();
+        target = par("target");
+        interval = par("interval");
+        if (quantum <= 0)
+            throw cRuntimeError("quantum must be positive");
+        if (target <= 0 || interval <= 0)
+            throw cRuntimeError("target and interval must be positive");
+        sojournTimeSignal = registerSignal("sojournTime");
+        WATCH(numPackets);
+        WATCH(codelDrops);
+        WATCH(overflowDrops);
+    }
+    else if (stage == INITSTAGE_QUEUEING) {
+        checkPacketOperationSupport(inputGate);
+        checkPacketOperationSupport(outputGate);
+        if (producer != nullptr)
+            producer->handleCanPushPacketChanged(inputGate->getPathStartGate());
+    }
+}
+
+void SojournFairQueue::finish()
+{
+    recordScalar("codelDrops", codelDrops);
+    recordScalar("overflowDrops", overflowDrops);
+}
+
+SojournFairQueue::FlowKey SojournFairQueue::classifyPacket(Packet *packet) const
+{
+    FlowKey key;
+    if (flowKeyMode == FLOW_KEY_NEXT_HOP) {
+        if (auto macAddressReq = packet->findTag<MacAddressReq>())
+            key.nextHop = macAddressReq->getDestAddress();
+        return key;
+    }
+    // The network header sits behind the MAC header; frames without one (management) share a flow
+    NetworkHeaderFinder finder;
+    if (packet->findTag<PacketProtocolTag>() != nullptr) {
+        PacketDissector dissector(ProtocolDissectorRegistry::getInstance(), finder);
+        dissector.dissectPacket(packet);
+    }
+    if (finder.header != nullptr) {
+        key.destination = finder.header->getDestinationAddress();
+        if (flowKeyMode == FLOW_KEY_FLOW)
+            key.source = finder.header->getSourceAddress();
+    }
+    return key;
+}
+
+SojournFairQueue::Entry SojournFairQueue::popHead(Flow& flow)
+{
+    Entry entry = flow.packets.front();
+    flow.packets.pop_front();
+    b length = entry.packet->getTotalLength();
+    flow.length -= length;
+    totalLength -= length;
+    numPackets--;
+    return entry;
+}
+
+// CoDel's ok_to_drop decision (RFC 8289 dodequeue) for a packet just taken from the flow
+bool SojournFairQueue::isSojournAboveTarget(Flow& flow, simtime_t sojournTime, simtime_t now) const
+{
+    if (sojournTime < target || flow.length <= maxPacketLength) {
+        flow.firstAboveTime = 0;
+        return false;
+    }
+    if (flow.firstAboveTime == 0) {
+        flow.firstAboveTime = now + interval;
+        return false;
+    }
+    return now >= flow.firstAboveTime;
+}
+
+void SojournFairQueue::advanceSchedule()
+{
+    // Deficit round-robin: a flow that used up its deficit gets another quantum at the back of oldFlows
+    while (!newFlows.empty() || !oldFlows.empty()) {
+        std::list<FlowKey>& list = !newFlows.empty() ? newFlows : oldFlows;
+        Flow& flow = flows[list.front()];
+        if (flow.deficit > 0)
+            return;
+        flow.deficit += quantum;
+        oldFlows.splice(oldFlows.end(), list, list.begin());
+    }
+}
+
+void SojournFairQueue::unscheduleIfEmpty(const FlowKey& key, Flow& flow)
+{
+    if (!flow.packets.empty() || !flow.scheduled)
+        return;
+    // the CoDel state stays with the flow, so a flow that comes back quickly resumes dropping
+    newFlows.remove(key);
+    oldFlows.remove(key);
+    flow.scheduled = false;
+}
+
+bool SojournFairQueue::isOverloaded() const
+{
+    return (packetCapacity != -1 && numPackets > packetCapacity) ||
+           (dataCapacity != b(-1) && totalLength > dataCapacity);
+}
+
+void SojournFairQueue::dropOverflow()
+{
+    while (isOverloaded()) {
+        auto longest = flows.end();
+        for (auto it = flows.begin(); it != flows.end(); ++it)
+            if (!it->second.packets.empty() && (longest == flows.end() || it->second.length > longest->second.length))
+                longest = it;
+        Entry entry = popHead(longest->second);
+        EV_INFO << "Queue overflow, dropping head of the longest flow" << EV_FIELD(packet, *entry.packet) << EV_ENDL;
+        overflowDrops++;
+        unscheduleIfEmpty(longest->first, longest->second);
+        dropPacket(entry.packet, QUEUE_OVERFLOW, packetCapacity);
+    }
+    advanceSchedule();
+}
+
+void SojournFairQueue::pushPacket(Packet *packet, const cGate *gate)
+{
+    Enter_Method("pushPacket");
+    take(packet);
+    cNamedObject packetPushStartedDetails("atomicOperationStarted");
+    emit(packetPushStartedSignal, packet, &packetPushStartedDetails);
+    EV_INFO << "Pushing packet" << EV_FIELD(packet) << EV_ENDL;
+    FlowKey key = classifyPacket(packet);
+    Flow& flow = flows[key];
+    b length = packet->getTotalLength();
+    flow.packets.push_back(Entry { packet, simTime() });
+    flow.length += length;
+    totalLength += length;
+    numPackets++;
+    maxPacketLength = std::max(maxPacketLength, length);
+    if (!flow.scheduled) {
+        flow.scheduled = true;
+        flow.deficit = quantum;
+        newFlows.push_back(key);
+    }
+    dropOverflow();
+    cNamedObject packetPushEndedDetails("atomicOperationEnded");
+    emit(packetPushEndedSignal, nullptr, &packetPushEndedDetails);
+    updateDisplayString();
+    if (collector != nullptr && !isEmpty())
+        collector->handleCanPullPacketChanged(outputGate->getPathEndGate());
+}
+
+Packet *SojournFairQueue::pullPacket(const cGate *gate)
+{
+    Enter_Method("pullPacket");
+    if (isEmpty())
+        throw cRuntimeError("Cannot pull from an empty queue");
+    simtime_t now = simTime();
+    FlowKey key = getScheduledFlow();
+    Flow& flow = flows[key];
+    // CoDel dequeue (RFC 8289); ok_to_drop requires more than one packet's worth of data
+    // left in the flow, so the loops below never empty it
+    Entry entry = popHead(flow);
+    bool okToDrop = isSojournAboveTarget(flow, now - entry.enqueueTime, now);
+    if (flow.dropping) {
+        if (!okToDrop)
+            flow.dropping = false;
+        while (flow.dropping && now >= flow.dropNext) {
+            EV_INFO << "Sojourn time above target, dropping packet" << EV_FIELD(packet, *entry.packet) << EV_ENDL;
+            dropPacket(entry.packet, CONGESTION);
+            codelDrops++;
+            flow.count++;
+            entry = popHead(flow);
+            if (!isSojournAboveTarget(flow, now - entry.enqueueTime, now))
+                flow.dropping = false;
+            else
+                flow.dropNext = getDropNext(flow.dropNext, flow.count);
+        }
+    }
+    else if (okToDrop) {
+        EV_INFO << "Sojourn time above target for an interval, dropping packet" << EV_FIELD(packet, *entry.packet) << EV_ENDL;
+        dropPacket(entry.packet, CONGESTION);
+        codelDrops++;
+        entry = popHead(flow);
+        isSojournAboveTarget(flow, now - entry.enqueueTime, now);
+        flow.dropping = true;
+        // resume near the previous drop rate when the last dropping state ended recently
+        int delta = flow.count - flow.lastCount;
+        flow.count = (delta > 1 && now - flow.dropNext < 16 * interval) ? delta : 1;
+        flow.dropNext = getDropNext(now, flow.count);
+        flow.lastCount = flow.count;
+    }
+    Packet *packet = entry.packet;
+    flow.deficit -= packet->getByteLength();
+    lastSojournTime = now - entry.enqueueTime;
+    emit(sojournTimeSignal, lastSojournTime);
+    unscheduleIfEmpty(key, flow);
+    advanceSchedule();
+    drop(packet);
+    EV_INFO << "Pulling packet" << EV_FIELD(packet) << EV_FIELD(sojournTime, lastSojournTime) << EV_ENDL;
+    emit(packetPulledSignal, packet);
+    updateDisplayString();
+    return packet;
+}
+
+Packet *SojournFairQueue::getPacket(int index) const
+{
+    if (index < 0 || index >= numPackets)
+        throw cRuntimeError("Packet index %d out of range", index);
+    // in service order of the flows, packets of a flow in FIFO order
+    for (const std::list<FlowKey> *list : { &newFlows, &oldFlows }) {
+        for (const FlowKey& key : *list) {
+            const Flow& flow = flows.at(key);
+            if (index < (int)flow.packets.size())
+                return flow.packets[index].packet;
+            index -= flow.packets.size();
+        }
+    }
+    throw cRuntimeError("Packet index out of range");
+}
+
+void SojournFairQueue::removePacket(Packet *packet)
+{
+    Enter_Method("removePacket");
+    EV_INFO << "Removing packet" << EV_FIELD(packet) << EV_ENDL;
+    for (auto& it : flows) {
+        Flow& flow = it.second;
+        auto entry = std::find_if(flow.packets.begin(), flow.packets.end(), [&] (const Entry& e) { return e.packet == packet; });
+        if (entry == flow.packets.end())
+            continue;
+        b length = packet->getTotalLength();
+        flow.packets.erase(entry);
+        flow.length -= length;
+        totalLength -= length;
+        numPackets--;
+        unscheduleIfEmpty(it.first, flow);
+        advanceSchedule();
+        drop(packet);
+        emit(packetRemovedSignal, packet);
+        updateDisplayString();
+        return;
+    }
+    throw cRuntimeError("Packet %s is not in the queue", packet->getName());
+}
+
+void SojournFairQueue::removeAllPackets()
+{
+    Enter_Method("removeAllPackets");
+    std::vector<Packet *> packets;
+    for (int i = 0; i < numPackets; i++)
+        packets.push_back(getPacket(i));
+    for (auto packet : packets) {
+        removePacket(packet);
+        delete packet;
+    }
+}
+
+simtime_t SojournFairQueue::getSojournTime() const
+{
+    if (isEmpty())
+        return 0;
+    simtime_t oldestEnqueueTime = simTime();
+    for (const auto& it : flows)
+        if (!it.second.packets.empty())
+            oldestEnqueueTime = std::min(oldestEnqueueTime, it.second.packets.front().enqueueTime);
+    return std::max(lastSojournTime, simTime() - oldestEnqueueTime);
+}
+
+} // namespace researchproject
@@ -0,0 +1,148 @@
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+//
+
+#ifndef __RESEARCHPROJECT_SOJOURNFAIRQUEUE_H
+#define __RESEARCHPROJECT_SOJOURNFAIRQUEUE_H
+
+#include <cmath>
+#include <deque>
+#include <list>
+#include <map>
+#include <vector>
+
+#include "inet/linklayer/common/MacAddress.h"
+#include "inet/networklayer/common/L3Address.h"
+#include "inet/queueing/base/PacketQueueBase.h"
+#include "inet/queueing/contract/IActivePacketSink.h"
+#include "inet/queueing/contract/IActivePacketSource.h"
+
+using namespace omnetpp;
+using namespace inet;
+
+namespace researchproject {
+
+/**
+ * MAC queue with per-flow fair queueing and CoDel active queue management
+ * (in the spirit of fq_codel, RFC 8290).
+ *
+ * Packets are timestamped on enqueue and classified into flows by next hop
+ * (MacAddressReq), network destination or network source/destination pair.
+ * Flows are served by deficit round-robin with a byte quantum; each flow runs
+ * its own CoDel controller (RFC 8289) on the sojourn time of its packets, so a
+ * flow that keeps a standing queue above the target for an interval is thinned
+ * out at the head without affecting the others. When the packet capacity is
+ * exceeded, the head of the longest flow is dropped.
+ *
+ * getSojournTime() is the queueing delay a packet sees here right now; QueueGpsr
+ * advertises it in beacons instead of the raw backlog (queueDelayMetric = "sojourn").
+ */
+class SojournFairQueue : public queueing::PacketQueueBase
+{
+  public:
+    enum FlowKeyMode { FLOW_KEY_NEXT_HOP, FLOW_KEY_DESTINATION, FLOW_KEY_FLOW };
+
+  protected:
+    struct FlowKey {
+        MacAddress nextHop;
+        L3Address source;
+        L3Address destination;
+        bool operator<(const FlowKey& other) const {
+            if (nextHop != other.nextHop)
+                return nextHop < other.nextHop;
+            if (source != other.source)
+                return source < other.source;
+            return destination < other.destination;
+        }
+    };
+    struct Entry {
+        Packet *packet;
+        simtime_t enqueueTime;
+    };
+    struct Flow {
+        std::deque<Entry> packets;
+        b length = b(0);
+        int64_t deficit = 0;            // bytes the flow may still send in this round
+        bool scheduled = false;         // in newFlows or oldFlows
+        // CoDel state
+        simtime_t firstAboveTime;       // 0: sojourn time below target (or too little data queued)
+        simtime_t dropNext;
+        int count = 0;                  // drops in the current dropping state
+        int lastCount = 0;
+        bool dropping = false;
+    };
+
+    cGate *inputGate = nullptr;
+    cGate *outputGate = nullptr;
+    queueing::IActivePacketSource *producer = nullptr;
+    queueing::IActivePacketSink *collector = nullptr;
+
+    int packetCapacity = -1;
+    b dataCapacity = b(-1);
+    FlowKeyMode flowKeyMode = FLOW_KEY_FLOW;
+    int64_t quantum = 0;                // bytes
+    simtime_t target;
+    simtime_t interval;
+
+    std::map<FlowKey, Flow> flows;
+    // Round-robin order, the flow served next first. Flows that become backlogged join newFlows,
+    // which is served before oldFlows, so sparse flows see almost no queueing delay; a flow that
+    // used up its quantum moves to the back of oldFlows, an empty flow leaves the schedule
+    std::list<FlowKey> newFlows;
+    std::list<FlowKey> oldFlows;
+    int numPackets = 0;
+    b totalLength = b(0);
+    b maxPacketLength = b(0);           // largest packet seen, CoDel never drops below this backlog
+    simtime_t lastSojournTime;          // of the last dequeued packet
+
+    simsignal_t sojournTimeSignal;
+    long codelDrops = 0;
+    long overflowDrops = 0;
+
+  protected:
+    virtual void initialize(int stage) override;
+    virtual void finish() override;
+
+    FlowKey classifyPacket(Packet *packet) const;
+    const FlowKey& getScheduledFlow() const { return !newFlows.empty() ? newFlows.front() : oldFlows.front(); }
+    Entry popHead(Flow& flow);
+    bool isSojournAboveTarget(Flow& flow, simtime_t sojournTime, simtime_t now) const;
+    simtime_t getDropNext(simtime_t time, int count) const { return time + interval / sqrt(count); }
+    void advanceSchedule();
+    void unscheduleIfEmpty(const FlowKey& key, Flow& flow);
+    bool isOverloaded() const;
+    void dropOverflow();
+
+  public:
+    virtual int getMaxNumPackets() const override { return packetCapacity; }
+    virtual int getNumPackets() const override { return numPackets; }
+
+    virtual b getMaxTotalLength() const override { return dataCapacity; }
+    virtual b getTotalLength() const override { return totalLength; }
+
+    virtual bool isEmpty() const override { return numPackets == 0; }
+    virtual Packet *getPacket(int index) const override;
+    virtual void removePacket(Packet *packet) override;
+    virtual void removeAllPackets() override;
+
+    virtual bool supportsPacketPushing(const cGate *gate) const override { return inputGate == gate; }
+    virtual bool canPushSomePacket(const cGate *gate) const override { return true; }
+    virtual bool canPushPacket(Packet *packet, const cGate *gate) const override { return true; }
+    virtual void pushPacket(Packet *packet, const cGate *gate) override;
+
+    virtual bool supportsPacketPulling(const cGate *gate) const override { return outputGate == gate; }
+    virtual bool canPullSomePacket(const cGate *gate) const override { return !isEmpty(); }
+    virtual Packet *canPullPacket(const cGate *gate) const override { return !isEmpty() ? getPacket(0) : nullptr; }
+    virtual Packet *pullPacket(const cGate *gate) override;
+
+    virtual void enqueuePacket(Packet *packet) override { pushPacket(packet, inputGate); }
+    virtual Packet *dequeuePacket() override { return pullPacket(outputGate); }
+
+    // Queueing delay of a packet arriving now: 0 when empty, otherwise the larger of the last
+    // dequeued packet's sojourn time and the age of the oldest queued packet
+    simtime_t getSojournTime() const;
+};
+
+} // namespace researchproject
+
+#endif
@@ -0,0 +1,242 @@
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+//
+
+#include "CandidateScoring.h"
+
+#include <cmath>
+#include <limits>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace researchproject {
+namespace gpsrcore {
+
+static const double INF = std::numeric_limits<double>::infinity();
+
+void CandidateBatch::assign(const Params& params, NeighborSpan neighbors)
+{
+    size_t n = neighbors.size;
+    x.resize(n);
+    y.resize(n);
+    z.resize(n);
+    distanceDelayScale.resize(n);
+    linkDelayOffset.resize(n);
+    queueDelay.resize(n);
+    double modeledOffset = getModeledLinkDelayOffset(params);
+    for (size_t i = 0; i < n; i++) {
+        const Neighbor& neighbor = neighbors[i];
+        x[i] = neighbor.position.x;
+        y[i] = neighbor.position.y;
+        z[i] = neighbor.position.z;
+        bool measured = hasMeasuredLinkDelay(params, neighbor);
+        distanceDelayScale[i] = measured ? 0 : 1;
+        linkDelayOffset[i] = measured ? estimateLinkDelay(params, Vec3(), neighbor) : modeledOffset;
+        queueDelay[i] = estimateNeighborQueueDelay(params, neighbor);
+    }
+}
+
+static void resizeScores(size_t n, CandidateScores& scores)
+{
+    scores.distance.resize(n);
+    scores.progress.resize(n);
+    scores.delay.resize(n);
+    scores.cost.resize(n);
+}
+
+static inline double distanceOne(const Vec3& point, const CandidateBatch& batch, size_t i)
+{
+    double dx = point.x - batch.x[i];
+    double dy = point.y - batch.y[i];
+    double dz = point.z - batch.z[i];
+    return std::sqrt(dx * dx + dy * dy + dz * dz);
+}
+
+double estimateCandidateDelay(const Vec3& self, double delayEstimationFactor, const CandidateBatch& batch, size_t i)
+{
+    double sx = batch.x[i] - self.x;
+    double sy = batch.y[i] - self.y;
+    double sz = batch.z[i] - self.z;
+    // same operand order as estimateNeighborDelay
+    return (std::sqrt(sx * sx + sy * sy + sz * sz) * delayEstimationFactor * batch.distanceDelayScale[i] + batch.linkDelayOffset[i]) + batch.queueDelay[i];
+}
+
+static inline void scoreOne(const Vec3& self, const Vec3& destination, double selfDistance, double delayEstimationFactor,
+                            const CandidateBatch& batch, size_t i, CandidateScores& scores)
+{
+    double distance = distanceOne(destination, batch, i);
+    double progress = selfDistance - distance;
+    double delay = estimateCandidateDelay(self, delayEstimationFactor, batch, i);
+    scores.distance[i] = distance;
+    scores.progress[i] = progress;
+    scores.delay[i] = delay;
+    scores.cost[i] = progress > 0 ? delay / progress : INF;
+}
+
+void scoreCandidatesScalar(const Vec3& self, const Vec3& destination, double delayEstimationFactor, const CandidateBatch& batch, CandidateScores& scores)
+{
+    size_t n = batch.size();
+    resizeScores(n, scores);
+    double selfDistance = destination.distance(self);
+    for (size_t i = 0; i < n; i++)
+        scoreOne(self, destination, selfDistance, delayEstimationFactor, batch, i, scores);
+}
+
+#if defined(__AVX2__)
+
+const char *getCandidateScoringIsa() { return "avx2"; }
+
+void scoreCandidates(const Vec3& self, const Vec3& destination, double delayEstimationFactor, const CandidateBatch& batch, CandidateScores& scores)
+{
+    size_t n = batch.size();
+    resizeScores(n, scores);
+    double selfDistance = destination.distance(self);
+    // NOTE: separate multiplies and adds (no FMA) keep the results identical to the scalar path
+    const __m256d destX = _mm256_set1_pd(destination.x), destY = _mm256_set1_pd(destination.y), destZ = _mm256_set1_pd(destination.z);
+    const __m256d selfX = _mm256_set1_pd(self.x), selfY = _mm256_set1_pd(self.y), selfZ = _mm256_set1_pd(self.z);
+    const __m256d selfDist = _mm256_set1_pd(selfDistance), factor = _mm256_set1_pd(delayEstimationFactor);
+    const __m256d zero = _mm256_setzero_pd(), inf = _mm256_set1_pd(INF);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256d x = _mm256_loadu_pd(&batch.x[i]), y = _mm256_loadu_pd(&batch.y[i]), z = _mm256_loadu_pd(&batch.z[i]);
+        __m256d dx = _mm256_sub_pd(destX, x), dy = _mm256_sub_pd(destY, y), dz = _mm256_sub_pd(destZ, z);
+        __m256d sx = _mm256_sub_pd(x, selfX), sy = _mm256_sub_pd(y, selfY), sz = _mm256_sub_pd(z, selfZ);
+        __m256d distance = _mm256_sqrt_pd(_mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy)), _mm256_mul_pd(dz, dz)));
+        __m256d hop = _mm256_sqrt_pd(_mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(sx, sx), _mm256_mul_pd(sy, sy)), _mm256_mul_pd(sz, sz)));
+        __m256d progress = _mm256_sub_pd(selfDist, distance);
+        __m256d linkDelay = _mm256_add_pd(_mm256_mul_pd(_mm256_mul_pd(hop, factor), _mm256_loadu_pd(&batch.distanceDelayScale[i])), _mm256_loadu_pd(&batch.linkDelayOffset[i]));
+        __m256d delay = _mm256_add_pd(linkDelay, _mm256_loadu_pd(&batch.queueDelay[i]));
+        __m256d cost = _mm256_blendv_pd(inf, _mm256_div_pd(delay, progress), _mm256_cmp_pd(progress, zero, _CMP_GT_OQ));
+        _mm256_storeu_pd(&scores.distance[i], distance);
+        _mm256_storeu_pd(&scores.progress[i], progress);
+        _mm256_storeu_pd(&scores.delay[i], delay);
+        _mm256_storeu_pd(&scores.cost[i], cost);
+    }
+    for (; i < n; i++)
+        scoreOne(self, destination, selfDistance, delayEstimationFactor, batch, i, scores);
+}
+
+void computeDistances(const Vec3& point, const CandidateBatch& batch, std::vector<double>& distances)
+{
+    size_t n = batch.size();
+    distances.resize(n);
+    const __m256d px = _mm256_set1_pd(point.x), py = _mm256_set1_pd(point.y), pz = _mm256_set1_pd(point.z);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256d dx = _mm256_sub_pd(px, _mm256_loadu_pd(&batch.x[i]));
+        __m256d dy = _mm256_sub_pd(py, _mm256_loadu_pd(&batch.y[i]));
+        __m256d dz = _mm256_sub_pd(pz, _mm256_loadu_pd(&batch.z[i]));
+        _mm256_storeu_pd(&distances[i], _mm256_sqrt_pd(_mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy)), _mm256_mul_pd(dz, dz))));
+    }
+    for (; i < n; i++)
+        distances[i] = distanceOne(point, batch, i);
+}
+
+#elif defined(__SSE2__)
+
+const char *getCandidateScoringIsa() { return "sse2"; }
+
+void scoreCandidates(const Vec3& self, const Vec3& destination, double delayEstimationFactor, const CandidateBatch& batch, CandidateScores& scores)
+{
+    size_t n = batch.size();
+    resizeScores(n, scores);
+    double selfDistance = destination.distance(self);
+    const __m128d destX = _mm_set1_pd(destination.x), destY = _mm_set1_pd(destination.y), destZ = _mm_set1_pd(destination.z);
+    const __m128d selfX = _mm_set1_pd(self.x), selfY = _mm_set1_pd(self.y), selfZ = _mm_set1_pd(self.z);
+    const __m128d selfDist = _mm_set1_pd(selfDistance), factor = _mm_set1_pd(delayEstimationFactor);
+    const __m128d zero = _mm_setzero_pd(), inf = _mm_set1_pd(INF);
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+        __m128d x = _mm_loadu_pd(&batch.x[i]), y = _mm_loadu_pd(&batch.y[i]), z = _mm_loadu_pd(&batch.z[i]);
+        __m128d dx = _mm_sub_pd(destX, x), dy = _mm_sub_pd(destY, y), dz = _mm_sub_pd(destZ, z);
+        __m128d sx = _mm_sub_pd(x, selfX), sy = _mm_sub_pd(y, selfY), sz = _mm_sub_pd(z, selfZ);
+        __m128d distance = _mm_sqrt_pd(_mm_add_pd(_mm_add_pd(_mm_mul_pd(dx, dx), _mm_mul_pd(dy, dy)), _mm_mul_pd(dz, dz)));
+        __m128d hop = _mm_sqrt_pd(_mm_add_pd(_mm_add_pd(_mm_mul_pd(sx, sx), _mm_mul_pd(sy, sy)), _mm_mul_pd(sz, sz)));
+        __m128d progress = _mm_sub_pd(selfDist, distance);
+        __m128d linkDelay = _mm_add_pd(_mm_mul_pd(_mm_mul_pd(hop, factor), _mm_loadu_pd(&batch.distanceDelayScale[i])), _mm_loadu_pd(&batch.linkDelayOffset[i]));
+        __m128d delay = _mm_add_pd(linkDelay, _mm_loadu_pd(&batch.queueDelay[i]));
+        // SSE2 has no blend: select with and/andnot on the comparison mask
+        __m128d mask = _mm_cmpgt_pd(progress, zero);
+        __m128d cost = _mm_or_pd(_mm_and_pd(mask, _mm_div_pd(delay, progress)), _mm_andnot_pd(mask, inf));
+        _mm_storeu_pd(&scores.distance[i], distance);
+        _mm_storeu_pd(&scores.progress[i], progress);
+        _mm_storeu_pd(&scores.delay[i], delay);
+        _mm_storeu_pd(&scores.cost[i], cost);
+    }
+    for (; i < n; i++)
+        scoreOne(self, destination, selfDistance, delayEstimationFactor, batch, i, scores);
+}
+
+void computeDistances(const Vec3& point, const CandidateBatch& batch, std::vector<double>& distances)
+{
+    size_t n = batch.size();
+    distances.resize(n);
+    const __m128d px = _mm_set1_pd(point.x), py = _mm_set1_pd(point.y), pz = _mm_set1_pd(point.z);
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+        __m128d dx = _mm_sub_pd(px, _mm_loadu_pd(&batch.x[i]));
+        __m128d dy = _mm_sub_pd(py, _mm_loadu_pd(&batch.y[i]));
+        __m128d dz = _mm_sub_pd(pz, _mm_loadu_pd(&batch.z[i]));
+        _mm_storeu_pd(&distances[i], _mm_sqrt_pd(_mm_add_pd(_mm_add_pd(_mm_mul_pd(dx, dx), _mm_mul_pd(dy, dy)), _mm_mul_pd(dz, dz))));
+    }
+    for (; i < n; i++)
+        distances[i] = distanceOne(point, batch, i);
+}
+
+#else
+
+const char *getCandidateScoringIsa() { return "scalar"; }
+
+void scoreCandidates(const Vec3& self, const Vec3& destination, double delayEstimationFactor, const CandidateBatch& batch, CandidateScores& scores)
+{
+    scoreCandidatesScalar(self, destination, delayEstimationFactor, batch, scores);
+}
+
+void computeDistances(const Vec3& point, const CandidateBatch& batch, std::vector<double>& distances)
+{
+    size_t n = batch.size();
+    distances.resize(n);
+    for (size_t i = 0; i < n; i++)
+        distances[i] = distanceOne(point, batch, i);
+}
+
+#endif
+
+void selectCandidates(const CandidateScores& scores, double distanceEqualityThreshold, CandidateSelection& selection)
+{
+    size_t n = scores.distance.size();
+    selection.closest = NO_NEIGHBOR;
+    selection.closestDistance = INF;
+    selection.ties.clear();
+    selection.fastestTie = NO_NEIGHBOR;
+    selection.cheapest = NO_NEIGHBOR;
+    double cheapestCost = INF;
+    for (size_t i = 0; i < n; i++) {
+        if (scores.progress[i] <= 0)
+            continue;
+        if (scores.distance[i] < selection.closestDistance) {
+            selection.closestDistance = scores.distance[i];
+            selection.closest = i;
+        }
+        if (scores.cost[i] < cheapestCost) {
+            cheapestCost = scores.cost[i];
+            selection.cheapest = i;
+        }
+    }
+    if (selection.closest == NO_NEIGHBOR)
+        return;
+    for (size_t i = 0; i < n; i++) {
+        if (scores.progress[i] > 0 && scores.distance[i] - selection.closestDistance < distanceEqualityThreshold) {
+            selection.ties.push_back(i);
+            if (selection.fastestTie == NO_NEIGHBOR || scores.delay[i] < scores.delay[selection.fastestTie])
+                selection.fastestTie = i;
+        }
+    }
+}
+
+} // namespace gpsrcore
+} // namespace researchproject
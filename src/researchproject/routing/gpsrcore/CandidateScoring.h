@@ -0,0 +1,86 @@
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+//
+
+#ifndef __RESEARCHPROJECT_CANDIDATESCORING_H
+#define __RESEARCHPROJECT_CANDIDATESCORING_H
+
+#include <vector>
+
+#include "GpsrCore.h"
+
+namespace researchproject {
+namespace gpsrcore {
+
+/**
+ * Batch scoring of greedy forwarding candidates.
+ *
+ * Neighbor positions and the per-neighbor delay terms are stored as
+ * contiguous arrays (structure of arrays), so that the distances to the
+ * destination, the progress and the estimated delay of all candidates are
+ * computed in one vectorized pass. The kernel uses AVX2 or SSE2 when the
+ * translation unit is compiled for them and falls back to scalar code
+ * otherwise; scoreCandidatesScalar always runs the scalar path.
+ *
+ * The arithmetic is the same as estimateNeighborDelay and the greedy loop
+ * (sqrt(dx*dx + dy*dy + dz*dz), (distance * delayEstimationFactor * scale +
+ * link delay offset) + queue delay, where scale is 1 for the distance model
+ * and 0 for a measured link delay, which then is the offset), so results are
+ * bit-identical unless the compiler contracts the scalar code into fused
+ * multiply-adds (-ffp-contract=off prevents it).
+ *
+ * Filling a batch costs about as much as scoring it, so the kernel pays off
+ * when the caller keeps its neighbor table in this layout; for a one-shot
+ * neighbor array the NeighborSpan entry points are faster.
+ */
+class CandidateBatch
+{
+  public:
+    std::vector<double> x, y, z;
+    std::vector<double> distanceDelayScale;   // 1: distance model, 0: measured link delay (in linkDelayOffset)
+    std::vector<double> linkDelayOffset;      // measured link delay if used, otherwise getModeledLinkDelayOffset()
+    std::vector<double> queueDelay;           // estimateNeighborQueueDelay()
+
+    size_t size() const { return x.size(); }
+    void assign(const Params& params, NeighborSpan neighbors);
+};
+
+struct CandidateScores
+{
+    std::vector<double> distance;     // candidate to destination
+    std::vector<double> progress;     // self distance - candidate distance (> 0: closer than self)
+    std::vector<double> delay;        // estimated one-hop delay (estimateNeighborDelay)
+    std::vector<double> cost;         // delay per meter of progress, +inf without progress
+};
+
+struct CandidateSelection
+{
+    int closest = NO_NEIGHBOR;        // argmin distance among candidates making progress
+    double closestDistance = 0;
+    std::vector<int> ties;            // candidates making progress within the threshold of closestDistance (incl. closest)
+    int fastestTie = NO_NEIGHBOR;     // argmin delay among ties
+    int cheapest = NO_NEIGHBOR;       // argmin cost
+};
+
+// Name of the instruction set used by scoreCandidates: "avx2", "sse2" or "scalar"
+const char *getCandidateScoringIsa();
+
+void scoreCandidates(const Vec3& self, const Vec3& destination, double delayEstimationFactor, const CandidateBatch& batch, CandidateScores& scores);
+void scoreCandidatesScalar(const Vec3& self, const Vec3& destination, double delayEstimationFactor, const CandidateBatch& batch, CandidateScores& scores);
+
+// Distances of all candidates to one point (the greedy loop only needs these; delays on demand)
+void computeDistances(const Vec3& point, const CandidateBatch& batch, std::vector<double>& distances);
+double estimateCandidateDelay(const Vec3& self, double delayEstimationFactor, const CandidateBatch& batch, size_t i);
+
+// Argmin plus tie set over computed scores; ties are collected relative to the closest candidate
+void selectCandidates(const CandidateScores& scores, double distanceEqualityThreshold, CandidateSelection& selection);
+
+// findGreedyNextHop on a batch kept up to date by the caller (same result as the NeighborSpan version);
+// only scores.distance is filled, the rest of scores is left untouched
+GreedyResult findGreedyNextHop(const Params& params, const Vec3& self, const Vec3& destination, const CandidateBatch& batch,
+                               CandidateScores& scores, const std::function<void(const TieEvent&)>& onTie = nullptr);
+
+} // namespace gpsrcore
+} // namespace researchproject
+
+#endif
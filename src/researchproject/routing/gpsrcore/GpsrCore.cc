@@ -0,0 +1,643 @@
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+//
+
+#include "GpsrCore.h"
+#include "CandidateScoring.h"
+
+#include <algorithm>
+#include <cassert>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+namespace researchproject {
+namespace gpsrcore {
+
+static const double INF = std::numeric_limits<double>::infinity();
+
+static inline double determinant(double a1, double a2, double b1, double b2)
+{
+    return a1 * b2 - a2 * b1;
+}
+
+//
+// Geometry
+//
+
+double getVectorAngle(const Vec3& vector)
+{
+    assert(!(vector == Vec3()));
+    double angle = std::atan2(-vector.y, vector.x);
+    if (angle < 0)
+        angle += 2 * M_PI;
+    return angle;
+}
+
+Vec3 computeIntersectionInsideLineSegments(const Vec3& begin1, const Vec3& end1, const Vec3& begin2, const Vec3& end2)
+{
+    // NOTE: we must explicitly avoid computing the intersection points inside due to double instability
+    if (begin1 == begin2 || begin1 == end2 || end1 == begin2 || end1 == end2)
+        return Vec3::nil();
+    double x1 = begin1.x;
+    double y1 = begin1.y;
+    double x2 = end1.x;
+    double y2 = end1.y;
+    double x3 = begin2.x;
+    double y3 = begin2.y;
+    double x4 = end2.x;
+    double y4 = end2.y;
+    double a = determinant(x1, y1, x2, y2);
+    double b = determinant(x3, y3, x4, y4);
+    double c = determinant(x1 - x2, y1 - y2, x3 - x4, y3 - y4);
+    double x = determinant(a, x1 - x2, b, x3 - x4) / c;
+    double y = determinant(a, y1 - y2, b, y3 - y4) / c;
+    if ((x <= x1 && x <= x2) || (x >= x1 && x >= x2) || (x <= x3 && x <= x4) || (x >= x3 && x >= x4) ||
+        (y <= y1 && y <= y2) || (y >= y1 && y >= y2) || (y <= y3 && y <= y4) || (y >= y3 && y >= y4))
+        return Vec3::nil();
+    return Vec3(x, y, 0);
+}
+
+std::vector<int> getPlanarNeighbors(const Params& params, const Vec3& self, NeighborSpan neighbors)
+{
+    std::vector<int> planarNeighbors;
+    for (size_t i = 0; i < neighbors.size; i++) {
+        const Vec3& neighborPosition = neighbors[i].position;
+        bool eliminated = false;
+        if (params.planarization == Planarization::RNG) {
+            double neighborDistance = neighborPosition.distance(self);
+            for (size_t j = 0; j < neighbors.size && !eliminated; j++) {
+                if (i == j)
+                    continue;
+                const Vec3& witnessPosition = neighbors[j].position;
+                double witnessDistance = witnessPosition.distance(self);
+                double neighborWitnessDistance = witnessPosition.distance(neighborPosition);
+                eliminated = neighborDistance > std::max(witnessDistance, neighborWitnessDistance);
+            }
+        }
+        else if (params.planarization == Planarization::GG) {
+            Vec3 middlePosition = (self + neighborPosition) / 2;
+            double neighborDistance = neighborPosition.distance(middlePosition);
+            for (size_t j = 0; j < neighbors.size && !eliminated; j++) {
+                if (i == j)
+                    continue;
+                eliminated = neighbors[j].position.distance(middlePosition) < neighborDistance;
+            }
+        }
+        if (!eliminated)
+            planarNeighbors.push_back(i);
+    }
+    return planarNeighbors;
+}
+
+Vec3 projectToPlane(const Vec3& position, int plane)
+{
+    switch (plane) {
+        case 0: return Vec3(position.x, position.y, 0);
+        case 1: return Vec3(position.x, position.z, 0);
+        default: return Vec3(position.y, position.z, 0);
+    }
+}
+
+static void sortByAngle(std::vector<int>& planarNeighbors, const Vec3& self, NeighborSpan neighbors, double startAngle, bool clockwise)
+{
+    // a neighbor at our own position (in a projection: straight above or below us) has no direction
+    // to be ordered by, so it is not part of the face
+    planarNeighbors.erase(std::remove_if(planarNeighbors.begin(), planarNeighbors.end(), [&] (int neighbor) {
+        return neighbors[neighbor].position == self;
+    }), planarNeighbors.end());
+    std::sort(planarNeighbors.begin(), planarNeighbors.end(), [&] (int neighbor1, int neighbor2) {
+        // NOTE: make sure the neighbor at startAngle goes to the end
+        auto angle1 = getVectorAngle(neighbors[neighbor1].position - self) - startAngle;
+        auto angle2 = getVectorAngle(neighbors[neighbor2].position - self) - startAngle;
+        if (clockwise) {
+            angle1 = -angle1;
+            angle2 = -angle2;
+        }
+        if (angle1 <= 0)
+            angle1 += 2 * M_PI;
+        if (angle2 <= 0)
+            angle2 += 2 * M_PI;
+        return angle1 < angle2;
+    });
+}
+
+std::vector<int> getPlanarNeighborsClockwise(const Params& params, const Vec3& self, NeighborSpan neighbors, double startAngle)
+{
+    std::vector<int> planarNeighbors = getPlanarNeighbors(params, self, neighbors);
+    sortByAngle(planarNeighbors, self, neighbors, startAngle, true);
+    return planarNeighbors;
+}
+
+std::vector<int> getPlanarNeighborsCounterClockwise(const Params& params, const Vec3& self, NeighborSpan neighbors, double startAngle)
+{
+    std::vector<int> planarNeighbors = getPlanarNeighbors(params, self, neighbors);
+    sortByAngle(planarNeighbors, self, neighbors, startAngle, false);
+    return planarNeighbors;
+}
+
+// Gabriel graph / RNG on the projected positions, except that an edge is only removed for a witness
+// closer to both ends in 3D than they are to each other: the witness then has a link to both, so
+// unlike plain planarization of the projection this never disconnects the graph (but may leave
+// crossings where the projection folds nodes at different altitudes onto each other)
+static std::vector<int> getProjectedPlanarNeighbors(const Params& params, const Vec3& self, NeighborSpan neighbors, NeighborSpan projected, const Vec3& projectedSelf)
+{
+    std::vector<int> planarNeighbors;
+    for (size_t i = 0; i < neighbors.size; i++) {
+        double linkDistance = neighbors[i].position.distance(self);
+        bool eliminated = false;
+        for (size_t j = 0; j < neighbors.size && !eliminated; j++) {
+            if (i == j || neighbors[j].position.distance(self) > linkDistance || neighbors[j].position.distance(neighbors[i].position) > linkDistance)
+                continue;
+            if (params.planarization == Planarization::RNG) {
+                double neighborDistance = projected[i].position.distance(projectedSelf);
+                eliminated = neighborDistance > std::max(projected[j].position.distance(projectedSelf), projected[j].position.distance(projected[i].position));
+            }
+            else if (params.planarization == Planarization::GG) {
+                Vec3 middlePosition = (projectedSelf + projected[i].position) / 2;
+                eliminated = projected[j].position.distance(middlePosition) < projected[i].position.distance(middlePosition);
+            }
+        }
+        if (!eliminated)
+            planarNeighbors.push_back(i);
+    }
+    return planarNeighbors;
+}
+
+//
+// Estimators
+//
+
+double estimateNeighborQueueDelay(const Params& params, const Neighbor& neighbor)
+{
+    // stale or unknown queue information leaves no queueing term
+    if (!params.enableQueueDelay || neighbor.queueInfoAge < 0 || neighbor.queueInfoAge > params.maxInfoAge)
+        return 0;
+    // a measured sojourn time takes precedence over backlog / bitrate, which needs a known bitrate
+    if (neighbor.sojournTime >= 0)
+        return neighbor.sojournTime;
+    return neighbor.txBitrate > 0 ? neighbor.backlogBytes * 8.0 / neighbor.txBitrate : 0;
+}
+
+bool hasMeasuredLinkDelay(const Params& params, const Neighbor& neighbor)
+{
+    return params.measuredLinkDelay && neighbor.linkDelayMean >= 0 && neighbor.queueInfoAge >= 0 && neighbor.queueInfoAge <= params.maxInfoAge;
+}
+
+double getModeledLinkDelayOffset(const Params& params)
+{
+    // a measured delay starts when we route the packet, so it includes our own queue; without the same
+    // term a modeled link would look faster than a measured one just because our queue is long
+    return params.measuredLinkDelay ? params.localQueueDelay : 0;
+}
+
+double estimateLinkDelay(const Params& params, const Vec3& self, const Neighbor& neighbor)
+{
+    if (hasMeasuredLinkDelay(params, neighbor))
+        return neighbor.linkDelayMean + params.linkDelayDeviationWeight * std::sqrt(neighbor.linkDelayVariance);
+    return neighbor.position.distance(self) * params.delayEstimationFactor + getModeledLinkDelayOffset(params);
+}
+
+double estimateNeighborDelay(const Params& params, const Vec3& self, const Neighbor& neighbor)
+{
+    return estimateLinkDelay(params, self, neighbor) + estimateNeighborQueueDelay(params, neighbor);
+}
+
+double estimateLocalProcessingTime(const Params& params, int taskBits, double cpuHz)
+{
+    if (cpuHz <= 0)
+        return INF;
+    return taskBits * params.taskCyclesPerBit / cpuHz;
+}
+
+double estimateLocalTaskDelay(const Params& params, int taskBits, double cpuHz, double backlogCycles)
+{
+    // Local processing also waits behind the work already queued on our own CPU
+    double delay = estimateLocalProcessingTime(params, taskBits, cpuHz);
+    if (cpuHz > 0)
+        delay += backlogCycles / cpuHz;
+    return delay;
+}
+
+double estimateRemoteProcessingTime(const Params& params, const Neighbor& neighbor, int taskBits)
+{
+    if (neighbor.cpuInfoAge < 0 || neighbor.cpuInfoAge > params.maxInfoAge || neighbor.cpuOffloadHz <= 0)
+        return INF;
+    double processingTime = taskBits * params.taskCyclesPerBit / neighbor.cpuOffloadHz;
+    double cpuQueueDelay = neighbor.cpuOffloadBacklogCycles > 0 ? neighbor.cpuOffloadBacklogCycles / neighbor.cpuOffloadHz : 0.0;
+    return processingTime + cpuQueueDelay;
+}
+
+double estimateOffloadTotalDelay(const Params& params, const Vec3& self, const Neighbor& neighbor, int taskBits)
+{
+    // T_off,k = T_tx,k + T_proc,k
+    return estimateNeighborDelay(params, self, neighbor) + estimateRemoteProcessingTime(params, neighbor, taskBits);
+}
+
+PathDelayModel estimatePathDelayModel(const Params& params, const Vec3& self, NeighborSpan neighbors)
+{
+    PathDelayModel path;
+    double queueDelaySum = 0, bitrateSum = 0;
+    int queueDelayCount = 0, bitrateCount = 0;
+    for (const Neighbor& neighbor : neighbors) {
+        path.hopProgress = std::max(path.hopProgress, neighbor.position.distance(self));
+        if (neighbor.queueInfoAge < 0 || neighbor.queueInfoAge > params.maxInfoAge)
+            continue;
+        if (params.enableQueueDelay && (neighbor.sojournTime >= 0 || neighbor.txBitrate > 0)) {
+            queueDelaySum += estimateNeighborQueueDelay(params, neighbor);
+            queueDelayCount++;
+        }
+        if (neighbor.txBitrate > 0) {
+            bitrateSum += neighbor.txBitrate;
+            bitrateCount++;
+        }
+    }
+    if (queueDelayCount > 0)
+        path.queueDelay = queueDelaySum / queueDelayCount;
+    if (bitrateCount > 0)
+        path.bitrate = bitrateSum / bitrateCount;
+    return path;
+}
+
+double estimatePathDelay(const Params& params, const PathDelayModel& path, double distance, int bits)
+{
+    if (!(distance > 0))
+        return 0;
+    double hops = path.hopProgress > 0 ? std::ceil(distance / path.hopProgress) : 1;
+    double hopDelay = path.queueDelay + (path.bitrate > 0 ? bits / path.bitrate : 0);
+    return distance * params.delayEstimationFactor + hops * hopDelay;
+}
+
+PipelineDelay estimateLocalPipelineDelay(const Params& params, const Vec3& self, const Vec3& destination, int taskBits,
+                                         double cpuHz, double backlogCycles, const PathDelayModel& path)
+{
+    PipelineDelay delay;
+    delay.processing = estimateLocalTaskDelay(params, taskBits, cpuHz, backlogCycles);
+    delay.delivery = estimatePathDelay(params, path, destination.distance(self), (int)(taskBits * params.reductionFactor));
+    return delay;
+}
+
+PipelineDelay estimateOffloadPipelineDelay(const Params& params, const Vec3& self, const Vec3& destination, const Neighbor& neighbor,
+                                           int taskBits, const PathDelayModel& path)
+{
+    PipelineDelay delay;
+    delay.transfer = estimateNeighborDelay(params, self, neighbor);
+    if (neighbor.queueInfoAge >= 0 && neighbor.queueInfoAge <= params.maxInfoAge && neighbor.txBitrate > 0)
+        delay.transfer += taskBits / neighbor.txBitrate;
+    delay.processing = estimateRemoteProcessingTime(params, neighbor, taskBits);
+    delay.delivery = estimatePathDelay(params, path, destination.distance(neighbor.position), (int)(taskBits * params.reductionFactor));
+    return delay;
+}
+
+double estimateProgressCost(const Params& params, const Vec3& self, const Vec3& destination, const Neighbor& neighbor)
+{
+    double progress = destination.distance(self) - destination.distance(neighbor.position);
+    if (progress <= 0)
+        return INF;
+    return estimateNeighborDelay(params, self, neighbor) / progress;
+}
+
+//
+// Decisions
+//
+
+// Greedy selection over per-candidate distance/delay accessors. The selection is sequential: with the
+// tiebreaker, the outcome depends on the neighbor order. Delays are only requested for the candidates
+// that need them.
+template <typename DistanceOf, typename DelayOf>
+static GreedyResult selectGreedyNextHop(const Params& params, double selfDistance, size_t size, DistanceOf distanceOf, DelayOf delayOf,
+                                        const std::function<void(const TieEvent&)>& onTie)
+{
+    GreedyResult result;
+    result.distance = selfDistance;
+    for (size_t i = 0; i < size; i++) {
+        double neighborDistance = distanceOf(i);
+        if (params.enableDelayTiebreaker && neighborDistance < result.distance) {
+            // This neighbor is strictly closer - it becomes the new best
+            result.distance = neighborDistance;
+            result.nextHop = i;
+            result.delay = delayOf(i);
+            result.greedySelections++;
+        }
+        else if (params.enableDelayTiebreaker && result.nextHop != NO_NEIGHBOR &&
+                 std::fabs(neighborDistance - result.distance) < params.distanceEqualityThreshold) {
+            // Neighbors are equidistant (within threshold) - use delay tiebreaker
+            double neighborDelay = delayOf(i);
+            bool wins = neighborDelay < result.delay;
+            if (onTie)
+                onTie(TieEvent { result.nextHop, result.distance, result.delay, (int)i, neighborDistance, neighborDelay, wins });
+            if (wins) {
+                result.distance = neighborDistance;
+                result.nextHop = i;
+                result.delay = neighborDelay;
+                result.tiebreakerActivations++;
+            }
+        }
+        else if (!params.enableDelayTiebreaker && neighborDistance < result.distance) {
+            // Original GPSR logic: just select strictly closer neighbor
+            result.distance = neighborDistance;
+            result.nextHop = i;
+        }
+    }
+    return result;
+}
+
+GreedyResult findGreedyNextHop(const Params& params, const Vec3& self, const Vec3& destination, NeighborSpan neighbors,
+                               const std::function<void(const TieEvent&)>& onTie)
+{
+    return selectGreedyNextHop(params, destination.distance(self), neighbors.size,
+            [&] (size_t i) { return destination.distance(neighbors[i].position); },
+            [&] (size_t i) { return estimateNeighborDelay(params, self, neighbors[i]); }, onTie);
+}
+
+GreedyResult findGreedyNextHop(const Params& params, const Vec3& self, const Vec3& destination, const CandidateBatch& batch,
+                               CandidateScores& scores, const std::function<void(const TieEvent&)>& onTie)
+{
+    computeDistances(destination, batch, scores.distance);
+    return selectGreedyNextHop(params, destination.distance(self), batch.size(),
+            [&] (size_t i) { return scores.distance[i]; },
+            [&] (size_t i) { return estimateCandidateDelay(self, params.delayEstimationFactor, batch, i); }, onTie);
+}
+
+int findLowestDelayNextHop(const Params& params, const Vec3& self, const Vec3& destination, NeighborSpan neighbors)
+{
+    int best = NO_NEIGHBOR;
+    double bestCost = INF;
+    for (size_t i = 0; i < neighbors.size; i++) {
+        double cost = estimateProgressCost(params, self, destination, neighbors[i]);
+        if (cost < bestCost) {
+            best = i;
+            bestCost = cost;
+        }
+    }
+    return best;
+}
+
+std::vector<int> findGreedyCandidateSet(const Params& params, const Vec3& self, const Vec3& destination, NeighborSpan neighbors)
+{
+    double selfDistance = destination.distance(self);
+    double closestDistance = selfDistance;
+    int closest = NO_NEIGHBOR;
+    for (size_t i = 0; i < neighbors.size; i++) {
+        double distance = destination.distance(neighbors[i].position);
+        if (distance < closestDistance) {
+            closestDistance = distance;
+            closest = i;
+        }
+    }
+    std::vector<int> candidates;
+    if (closest == NO_NEIGHBOR)
+        return candidates;
+    candidates.push_back(closest);
+    for (size_t i = 0; i < neighbors.size; i++) {
+        double distance = destination.distance(neighbors[i].position);
+        if ((int)i != closest && distance < selfDistance && distance - closestDistance < params.distanceEqualityThreshold)
+            candidates.push_back(i);
+    }
+    return candidates;
+}
+
+std::vector<double> getLoadSpreadingWeights(const Params& params, const Vec3& self, NeighborSpan neighbors, const std::vector<int>& candidates)
+{
+    std::vector<double> weights;
+    double sum = 0;
+    for (int candidate : candidates) {
+        // a zero delay estimate (co-located neighbor, zero delay factor) must not take all traffic
+        double delay = std::max(estimateNeighborDelay(params, self, neighbors[candidate]), 1e-9);
+        weights.push_back(1 / delay);
+        sum += weights.back();
+    }
+    for (double& weight : weights)
+        weight /= sum;
+    return weights;
+}
+
+int selectWeightedRandom(const std::vector<double>& weights, double random)
+{
+    double sum = 0;
+    for (double weight : weights)
+        sum += weight;
+    double threshold = random * sum;
+    for (size_t i = 0; i < weights.size(); i++) {
+        threshold -= weights[i];
+        if (threshold < 0)
+            return i;
+    }
+    return weights.empty() ? NO_NEIGHBOR : weights.size() - 1;
+}
+
+int selectDeficitRoundRobin(const std::vector<double>& weights, std::vector<double>& deficits)
+{
+    int selected = NO_NEIGHBOR;
+    for (size_t i = 0; i < weights.size(); i++) {
+        deficits[i] += weights[i];
+        if (selected == NO_NEIGHBOR || deficits[i] > deficits[selected])
+            selected = i;
+    }
+    if (selected != NO_NEIGHBOR)
+        deficits[selected] -= 1;
+    return selected;
+}
+
+BackpressureResult findBackpressureNextHop(const Params& params, const Vec3& self, const Vec3& destination, NeighborSpan neighbors,
+                                           double selfBacklogBytes, double linkBitrate)
+{
+    BackpressureResult result;
+    double selfDistance = destination.distance(self);
+    if (selfDistance <= 0 || linkBitrate <= 0)
+        return result;
+    for (size_t i = 0; i < neighbors.size; i++) {
+        const Neighbor& neighbor = neighbors[i];
+        double progress = selfDistance - destination.distance(neighbor.position);
+        // without a fresh backlog the differential is unknown; backward hops are left to greedy/perimeter
+        if (progress <= 0 || neighbor.queueInfoAge < 0 || neighbor.queueInfoAge > params.maxInfoAge)
+            continue;
+        result.eligible++;
+        double weight = (selfBacklogBytes - neighbor.backlogBytes) * linkBitrate * progress / selfDistance;
+        if (weight > result.weight) {
+            result.weight = weight;
+            result.nextHop = i;
+        }
+    }
+    return result;
+}
+
+// planarNeighbors: precomputed planar subset of neighbors, nullptr to planarize here
+static PerimeterResult traverseFace(const Params& params, const PerimeterInput& input, NeighborSpan neighbors, bool clockwise,
+                                    bool checkGreedy = true, const std::vector<int> *planarNeighbors = nullptr)
+{
+    PerimeterResult result;
+    double selfDistance = input.destination.distance(input.self);
+    double perimeterStartDistance = input.destination.distance(input.perimeterStartPosition);
+    if (checkGreedy && selfDistance < perimeterStartDistance) {
+        result.outcome = PerimeterResult::SWITCH_TO_GREEDY;
+        return result;
+    }
+    uint64_t firstSender = input.faceFirstSender;
+    uint64_t firstReceiver = input.faceFirstReceiver;
+    // a sender at our position gives no direction to start from, so the destination is used instead
+    Vec3 startDirection = (input.senderPosition ? *input.senderPosition : input.destination) - input.self;
+    if (startDirection == Vec3())
+        startDirection = input.destination - input.self;
+    double startAngle = startDirection == Vec3() ? 0 : getVectorAngle(startDirection);
+    std::vector<int> orderedNeighbors = planarNeighbors ? *planarNeighbors : getPlanarNeighbors(params, input.self, neighbors);
+    sortByAngle(orderedNeighbors, input.self, neighbors, startAngle, clockwise);
+    for (int neighbor : orderedNeighbors) {
+        Vec3 intersection = computeIntersectionInsideLineSegments(input.perimeterStartPosition, input.destination, input.self, neighbors[neighbor].position);
+        if (std::isnan(intersection.x)) {
+            result.nextHop = neighbor;
+            break;
+        }
+        // the edge crosses Lp-D: continue on the next face, starting here
+        result.faceChanged = true;
+        result.forwardPosition = intersection;
+        firstSender = input.selfId;
+        firstReceiver = 0;
+    }
+    if (result.nextHop == NO_NEIGHBOR)
+        result.outcome = PerimeterResult::NO_NEIGHBOR_FOUND;
+    else if (firstSender == input.selfId && firstReceiver == neighbors[result.nextHop].id)
+        result.outcome = PerimeterResult::END_OF_PERIMETER;
+    else {
+        result.outcome = PerimeterResult::NEXT_HOP;
+        result.firstReceiverSet = firstReceiver == 0;
+    }
+    return result;
+}
+
+PerimeterResult findPerimeterNextHop(const Params& params, const PerimeterInput& input, NeighborSpan neighbors)
+{
+    return traverseFace(params, input, neighbors, false);
+}
+
+PerimeterResult findBoundedPerimeterNextHop(const Params& params, const PerimeterInput& input, FaceBound& bound, double growthFactor, NeighborSpan neighbors)
+{
+    bound.reversals = 0;
+    bound.expansions = 0;
+    PerimeterInput step = input;
+    bool restarted = false;
+    // every other iteration enlarges the circle, so this only ends early for absurd growth factors
+    for (int i = 0; i < 128; i++) {
+        PerimeterResult result = traverseFace(params, step, neighbors, bound.reverse);
+        if (result.outcome != PerimeterResult::NEXT_HOP || neighbors[result.nextHop].position.distance(input.destination) <= bound.radius) {
+            if (restarted && result.outcome == PerimeterResult::NEXT_HOP) {
+                // the traversal in the new direction starts here
+                result.faceChanged = true;
+                result.forwardPosition = input.self;
+                result.firstReceiverSet = true;
+            }
+            return result;
+        }
+        if (bound.boundaryHits == 0) {
+            // first hit: explore the face in the other direction, which starts by going back to the sender
+            bound.boundaryHits = 1;
+            bound.reverse = !bound.reverse;
+            bound.reversals++;
+            step.faceFirstSender = input.selfId;
+            step.faceFirstReceiver = 0;
+            restarted = true;
+            bool isEntryNode = input.self == input.perimeterStartPosition;
+            if (!isEntryNode && input.senderId != 0) {
+                for (size_t j = 0; j < neighbors.size; j++) {
+                    if (neighbors[j].id == input.senderId) {
+                        PerimeterResult back;
+                        back.outcome = PerimeterResult::NEXT_HOP;
+                        back.nextHop = j;
+                        back.faceChanged = true;
+                        back.forwardPosition = input.self;
+                        back.firstReceiverSet = true;
+                        return back;
+                    }
+                }
+            }
+            // at the entry node (or with the sender gone) the other direction starts right here
+        }
+        else {
+            // hit in both directions: the face does not lead closer within the circle
+            bound.boundaryHits = 0;
+            bound.radius *= growthFactor;
+            bound.expansions++;
+        }
+    }
+    return PerimeterResult();
+}
+
+PerimeterResult findProjectedPerimeterNextHop(const Params& params, const PerimeterInput& input, int& plane, NeighborSpan neighbors)
+{
+    PerimeterResult result;
+    if (input.destination.distance(input.self) < input.destination.distance(input.perimeterStartPosition)) {
+        result.outcome = PerimeterResult::SWITCH_TO_GREEDY;
+        return result;
+    }
+    std::vector<Neighbor> projected(neighbors.begin(), neighbors.end());
+    PerimeterInput step = input;
+    Vec3 senderPosition;
+    bool planeChanged = false;
+    for (; plane < NUM_PROJECTION_PLANES; plane++) {
+        for (size_t i = 0; i < neighbors.size; i++)
+            projected[i].position = projectToPlane(neighbors[i].position, plane);
+        step.self = projectToPlane(input.self, plane);
+        step.destination = projectToPlane(input.destination, plane);
+        step.perimeterStartPosition = projectToPlane(input.perimeterStartPosition, plane);
+        if (input.senderPosition) {
+            senderPosition = projectToPlane(*input.senderPosition, plane);
+            step.senderPosition = &senderPosition;
+        }
+        // progress is judged in 3D above, the projected distances only steer the traversal
+        std::vector<int> planarNeighbors = getProjectedPlanarNeighbors(params, input.self, neighbors, projected, step.self);
+        result = traverseFace(params, step, projected, false, false, &planarNeighbors);
+        if (result.outcome == PerimeterResult::NEXT_HOP) {
+            if (planeChanged) {
+                // the traversal in the new plane starts here
+                result.faceChanged = true;
+                result.forwardPosition = input.self;
+                result.firstReceiverSet = true;
+            }
+            else if (result.faceChanged)
+                result.forwardPosition = input.self;  // the projected intersection has no meaning in 3D
+            return result;
+        }
+        step.faceFirstSender = input.selfId;
+        step.faceFirstReceiver = 0;
+        planeChanged = true;
+    }
+    return result;
+}
+
+OffloadDecision makeOffloadDecision(const Params& params, const Vec3& self, const Vec3& destination, NeighborSpan candidates, int taskBits,
+                                    double localCpuHz, double localBacklogCycles, double slack)
+{
+    OffloadDecision decision;
+    PathDelayModel path;
+    if (params.offloadPipelineDelay) {
+        path = estimatePathDelayModel(params, self, candidates);
+        decision.localPipeline = estimateLocalPipelineDelay(params, self, destination, taskBits, localCpuHz, localBacklogCycles, path);
+        decision.localTime = decision.localPipeline.total();
+    }
+    else
+        decision.localTime = estimateLocalTaskDelay(params, taskBits, localCpuHz, localBacklogCycles);
+    for (size_t i = 0; i < candidates.size; i++) {
+        PipelineDelay pipeline;
+        double totalDelay;
+        if (params.offloadPipelineDelay) {
+            pipeline = estimateOffloadPipelineDelay(params, self, destination, candidates[i], taskBits, path);
+            totalDelay = pipeline.total();
+        }
+        else
+            totalDelay = estimateOffloadTotalDelay(params, self, candidates[i], taskBits);
+        // Deadline-aware: a target that cannot finish in time is never selected
+        if (totalDelay > slack)
+            continue;
+        if (totalDelay < decision.bestOffloadTime) {
+            decision.bestOffloadTime = totalDelay;
+            decision.bestOffloadPipeline = pipeline;
+            decision.target = i;
+        }
+    }
+    decision.shouldOffload = decision.bestOffloadTime < decision.localTime && decision.target != NO_NEIGHBOR;
+    return decision;
+}
+
+} // namespace gpsrcore
+} // namespace researchproject
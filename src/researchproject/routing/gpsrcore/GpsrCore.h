@@ -0,0 +1,295 @@
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+//
+
+#ifndef __RESEARCHPROJECT_GPSRCORE_H
+#define __RESEARCHPROJECT_GPSRCORE_H
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <vector>
+
+namespace researchproject {
+namespace gpsrcore {
+
+/**
+ * Framework-independent GPSR routing core.
+ *
+ * Geometry, next hop selection (greedy with delay tiebreaker, perimeter) and
+ * the offload estimators of QueueGpsr, operating on plain data: positions,
+ * a contiguous neighbor array and information ages in seconds. There are no
+ * dependencies on OMNeT++/INET, the simulation clock or logging, so the same
+ * code runs inside QueueGpsr, in offline tools and in unit tests.
+ *
+ * Neighbors are referred to by their index in the array passed in; node ids
+ * are opaque integers chosen by the caller (0 = unspecified).
+ */
+
+struct Vec3
+{
+    double x = 0, y = 0, z = 0;
+
+    Vec3() {}
+    Vec3(double x, double y, double z) : x(x), y(y), z(z) {}
+
+    static Vec3 nil() { double nan = std::numeric_limits<double>::quiet_NaN(); return Vec3(nan, nan, nan); }
+    bool isNil() const { return std::isnan(x) && std::isnan(y) && std::isnan(z); }
+
+    Vec3 operator+(const Vec3& o) const { return Vec3(x + o.x, y + o.y, z + o.z); }
+    Vec3 operator-(const Vec3& o) const { return Vec3(x - o.x, y - o.y, z - o.z); }
+    Vec3 operator/(double f) const { return Vec3(x / f, y / f, z / f); }
+    bool operator==(const Vec3& o) const { return x == o.x && y == o.y && z == o.z; }
+    double length() const { return std::sqrt(x * x + y * y + z * z); }
+    double distance(const Vec3& o) const { return (*this - o).length(); }
+};
+
+enum class Planarization { NONE, GG, RNG };
+
+struct Neighbor
+{
+    uint64_t id = 0;                        // caller-defined node id
+    Vec3 position;
+    double backlogBytes = 0;                // advertised TX backlog
+    double sojournTime = -1;                // advertised MAC queue sojourn time (s), negative = not advertised
+    double linkDelayMean = -1;              // one-hop delay to the neighbor as measured and fed back by it (s), negative = unknown
+    double linkDelayVariance = 0;           // (s^2); age: queueInfoAge (same beacon)
+    double txBitrate = 0;                   // advertised bitrate (bps), 0 = unknown
+    double queueInfoAge = -1;               // age of backlog/bitrate info (s), negative = unknown
+    double cpuOffloadHz = 0;
+    double cpuOffloadBacklogCycles = 0;
+    double cpuInfoAge = -1;                 // age of CPU info (s), negative = unknown
+};
+
+struct NeighborSpan
+{
+    const Neighbor *data = nullptr;
+    size_t size = 0;
+
+    NeighborSpan() {}
+    NeighborSpan(const Neighbor *data, size_t size) : data(data), size(size) {}
+    NeighborSpan(const std::vector<Neighbor>& neighbors) : data(neighbors.data()), size(neighbors.size()) {}
+    const Neighbor& operator[](size_t i) const { return data[i]; }
+    const Neighbor *begin() const { return data; }
+    const Neighbor *end() const { return data + size; }
+};
+
+struct Params
+{
+    Planarization planarization = Planarization::GG;
+    bool enableDelayTiebreaker = false;
+    bool enableQueueDelay = false;
+    double distanceEqualityThreshold = 1;   // m
+    double delayEstimationFactor = 0.001;   // s/m
+    double maxInfoAge = 0;                  // beacon-derived info older than this is ignored (s)
+    double taskCyclesPerBit = 0;
+    bool offloadPipelineDelay = false;      // offload decisions include forwarding the result to the destination
+    double reductionFactor = 1;             // result size / task input size
+    bool measuredLinkDelay = false;         // use measured link delays instead of the distance model where known
+    double linkDelayDeviationWeight = 0;    // measured link delay = mean + weight * standard deviation
+    double localQueueDelay = 0;             // own TX queueing delay (s), which measured link delays include (measuredLinkDelay only)
+};
+
+const int NO_NEIGHBOR = -1;
+
+//
+// Geometry
+//
+
+// Angle of the vector in [0, 2pi), measured counter-clockwise with the y axis pointing down (as in INET)
+double getVectorAngle(const Vec3& vector);
+
+// Intersection of two line segments strictly inside both, or Vec3::nil()
+Vec3 computeIntersectionInsideLineSegments(const Vec3& begin1, const Vec3& end1, const Vec3& begin2, const Vec3& end2);
+
+// Indices of the neighbors kept by Gabriel graph / relative neighborhood graph planarization
+std::vector<int> getPlanarNeighbors(const Params& params, const Vec3& self, NeighborSpan neighbors);
+
+// Planar neighbors ordered counter-clockwise from startAngle; the neighbor at startAngle comes last,
+// neighbors at self's position (which have no angle) are left out
+std::vector<int> getPlanarNeighborsCounterClockwise(const Params& params, const Vec3& self, NeighborSpan neighbors, double startAngle);
+
+// Planar neighbors ordered clockwise from startAngle; as above
+std::vector<int> getPlanarNeighborsClockwise(const Params& params, const Vec3& self, NeighborSpan neighbors, double startAngle);
+
+// Projection onto coordinate plane 0 (xy), 1 (xz) or 2 (yz); the result lies in z = 0
+const int NUM_PROJECTION_PLANES = 3;
+Vec3 projectToPlane(const Vec3& position, int plane);
+
+//
+// Estimators
+//
+
+// Queueing delay at a neighbor when enabled and fresh: advertised sojourn time, otherwise backlog / bitrate
+double estimateNeighborQueueDelay(const Params& params, const Neighbor& neighbor);
+
+// Delay of the link to a neighbor: measured (when enabled, known and fresh), otherwise distance * delayEstimationFactor;
+// with measured link delays enabled, the distance model gets localQueueDelay added, which every measurement includes
+bool hasMeasuredLinkDelay(const Params& params, const Neighbor& neighbor);
+double getModeledLinkDelayOffset(const Params& params);
+double estimateLinkDelay(const Params& params, const Vec3& self, const Neighbor& neighbor);
+
+// One-hop delay: estimateLinkDelay() plus estimateNeighborQueueDelay()
+double estimateNeighborDelay(const Params& params, const Vec3& self, const Neighbor& neighbor);
+double estimateLocalProcessingTime(const Params& params, int taskBits, double cpuHz);
+double estimateLocalTaskDelay(const Params& params, int taskBits, double cpuHz, double backlogCycles);
+double estimateRemoteProcessingTime(const Params& params, const Neighbor& neighbor, int taskBits);
+double estimateOffloadTotalDelay(const Params& params, const Vec3& self, const Neighbor& neighbor, int taskBits);
+
+// Multi-hop path delay from what is known locally: the path to a point is expected to take
+// ceil(distance / hopProgress) hops, each with the mean advertised queueing delay and the
+// transmission time of the payload at the mean advertised bitrate, plus the distance term
+struct PathDelayModel
+{
+    double hopProgress = 0;                 // expected progress per hop (m): the farthest neighbor
+    double queueDelay = 0;                  // mean fresh backlog / bitrate of the neighbors (s)
+    double bitrate = 0;                     // mean advertised bitrate (bps), 0 = unknown
+};
+PathDelayModel estimatePathDelayModel(const Params& params, const Vec3& self, NeighborSpan neighbors);
+// 0 for distance <= 0 or NaN (destination at the node, or its position is unknown)
+double estimatePathDelay(const Params& params, const PathDelayModel& path, double distance, int bits);
+
+// Delay of the whole offload pipeline of one task, from its creation to the delivery of the result
+struct PipelineDelay
+{
+    double transfer = 0;                    // task input to the processing node
+    double processing = 0;                  // CPU queueing and service there
+    double delivery = 0;                    // reduced result onward to the destination
+    double total() const { return transfer + processing + delivery; }
+};
+PipelineDelay estimateLocalPipelineDelay(const Params& params, const Vec3& self, const Vec3& destination, int taskBits,
+                                         double cpuHz, double backlogCycles, const PathDelayModel& path);
+// The input is transmitted to the neighbor in one hop (including its transmission time at the advertised bitrate)
+PipelineDelay estimateOffloadPipelineDelay(const Params& params, const Vec3& self, const Vec3& destination, const Neighbor& neighbor,
+                                           int taskBits, const PathDelayModel& path);
+
+// Estimated one-hop delay per meter of progress towards the destination, +inf without progress
+double estimateProgressCost(const Params& params, const Vec3& self, const Vec3& destination, const Neighbor& neighbor);
+
+//
+// Decisions
+//
+
+struct TieEvent
+{
+    int best;
+    double bestDistance;
+    double bestDelay;
+    int challenger;
+    double challengerDistance;
+    double challengerDelay;
+    bool challengerWins;
+};
+
+struct GreedyResult
+{
+    int nextHop = NO_NEIGHBOR;              // NO_NEIGHBOR: local minimum, switch to perimeter routing
+    double distance = 0;                    // distance of the next hop (or self) to the destination
+    double delay = std::numeric_limits<double>::infinity();  // estimated delay of the next hop (tiebreaker only)
+    long greedySelections = 0;              // strictly closer neighbors taken (tiebreaker only)
+    long tiebreakerActivations = 0;         // ties won by the lower delay neighbor
+};
+
+// Greedy forwarding with the delay tiebreaker among neighbors within distanceEqualityThreshold
+GreedyResult findGreedyNextHop(const Params& params, const Vec3& self, const Vec3& destination, NeighborSpan neighbors,
+                               const std::function<void(const TieEvent&)>& onTie = nullptr);
+
+// Latency-sensitive forwarding: the neighbor with the lowest estimated delay per meter of progress
+// (estimateProgressCost), NO_NEIGHBOR at a local minimum
+int findLowestDelayNextHop(const Params& params, const Vec3& self, const Vec3& destination, NeighborSpan neighbors);
+
+// Load spreading: neighbors closer to the destination than self whose distance is within
+// distanceEqualityThreshold of the closest neighbor (the closest one first); empty at a local minimum
+std::vector<int> findGreedyCandidateSet(const Params& params, const Vec3& self, const Vec3& destination, NeighborSpan neighbors);
+
+// Traffic shares of the candidates, proportional to the inverse estimated delay (they sum to 1)
+std::vector<double> getLoadSpreadingWeights(const Params& params, const Vec3& self, NeighborSpan neighbors, const std::vector<int>& candidates);
+
+// Weighted random choice with random uniform in [0, 1); returns an index into weights
+int selectWeightedRandom(const std::vector<double>& weights, double random);
+
+// Deficit round-robin: every call credits each candidate its weight and serves the one with the largest
+// deficit, which pays one unit; deficits (parallel to weights) carry over between calls
+int selectDeficitRoundRobin(const std::vector<double>& weights, std::vector<double>& deficits);
+
+struct BackpressureResult
+{
+    int nextHop = NO_NEIGHBOR;              // NO_NEIGHBOR: no positive weight, fall back to greedy
+    double weight = 0;                      // weight of the next hop
+    int eligible = 0;                       // neighbors making progress with fresh queue information
+};
+
+// Backpressure forwarding: maximize (selfBacklog - neighborBacklog) * linkBitrate * progress / selfDistance
+// over neighbors closer to the destination whose advertised backlog is fresh (backlogs in bytes)
+BackpressureResult findBackpressureNextHop(const Params& params, const Vec3& self, const Vec3& destination, NeighborSpan neighbors,
+                                           double selfBacklogBytes, double linkBitrate);
+
+struct PerimeterInput
+{
+    uint64_t selfId = 0;
+    Vec3 self;
+    Vec3 destination;
+    Vec3 perimeterStartPosition;            // Lp
+    uint64_t faceFirstSender = 0;           // e0
+    uint64_t faceFirstReceiver = 0;         // e0
+    const Vec3 *senderPosition = nullptr;   // previous hop, nullptr at the perimeter entry node
+    uint64_t senderId = 0;                  // previous hop (bounded face routing returns to it)
+};
+
+struct PerimeterResult
+{
+    enum Outcome { NEXT_HOP, SWITCH_TO_GREEDY, NO_NEIGHBOR_FOUND, END_OF_PERIMETER };
+    Outcome outcome = NO_NEIGHBOR_FOUND;
+    int nextHop = NO_NEIGHBOR;
+    bool faceChanged = false;               // a new face starts here: first sender = self, first receiver reset
+    Vec3 forwardPosition;                   // Lf of the new face (if faceChanged)
+    bool firstReceiverSet = false;          // first receiver of the face becomes nextHop
+};
+
+// One step of perimeter (face) routing on the planarized neighbor graph (right-hand rule)
+PerimeterResult findPerimeterNextHop(const Params& params, const PerimeterInput& input, NeighborSpan neighbors);
+
+// Traversal state of bounded face routing, carried by the packet
+struct FaceBound
+{
+    double radius = std::numeric_limits<double>::infinity();  // the traversal stays within this distance of the destination
+    bool reverse = false;                   // left-hand rule (clockwise) instead of the right-hand rule
+    int boundaryHits = 0;                   // hits of the current circle (0 or 1)
+    int reversals = 0;                      // direction changes in this step (statistics)
+    int expansions = 0;                     // circle enlargements in this step (statistics)
+};
+
+// One step of bounded face routing (GOAFR-style): like findPerimeterNextHop, but an edge leaving the
+// circle of bound.radius around the destination turns the traversal back (the packet returns to its
+// sender and explores the face in the other direction); when the circle is hit in both directions it
+// is enlarged by growthFactor. Greedy resumes as soon as a node is closer than Lp, as in GPSR.
+PerimeterResult findBoundedPerimeterNextHop(const Params& params, const PerimeterInput& input, FaceBound& bound, double growthFactor, NeighborSpan neighbors);
+
+// One step of projection-based 3D recovery: planarization and face routing operate on the projection of
+// the neighborhood onto coordinate plane `plane`, so nodes at different altitudes no longer break the
+// angle ordering; when the traversal fails in one plane the next plane is tried from here (plane is
+// advanced, NUM_PROJECTION_PLANES when all failed). Greedy resumes when self is closer to the
+// destination than Lp in 3D.
+PerimeterResult findProjectedPerimeterNextHop(const Params& params, const PerimeterInput& input, int& plane, NeighborSpan neighbors);
+
+struct OffloadDecision
+{
+    int target = NO_NEIGHBOR;               // best neighbor meeting the deadline slack
+    double bestOffloadTime = std::numeric_limits<double>::infinity();
+    double localTime = 0;
+    bool shouldOffload = false;
+    PipelineDelay bestOffloadPipeline;      // components of bestOffloadTime and localTime (offloadPipelineDelay only)
+    PipelineDelay localPipeline;
+};
+
+// Offload when the best remote completion estimate within the slack beats local processing; with
+// offloadPipelineDelay both sides are full pipeline estimates including delivery to destination
+OffloadDecision makeOffloadDecision(const Params& params, const Vec3& self, const Vec3& destination, NeighborSpan candidates, int taskBits,
+                                    double localCpuHz, double localBacklogCycles, double slack);
+
+} // namespace gpsrcore
+} // namespace researchproject
+
+#endif
@@ -0,0 +1,174 @@
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+//
+
+#ifndef __RESEARCHPROJECT_DECISIONTRACE_H
+#define __RESEARCHPROJECT_DECISIONTRACE_H
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace researchproject {
+
+/**
+ * Binary trace of QueueGpsr routing and offload decision inputs.
+ *
+ * The file starts with a DecisionTraceHeader holding the estimator parameters
+ * of the recording node, followed by records: a DecisionRecord and then
+ * numNeighbors DecisionTraceNeighbor entries (the neighbor table as seen by
+ * the decision). All fields are fixed-width and written in host byte order.
+ *
+ * This header deliberately depends on the C++ standard library only, so that
+ * offline tools (tools/decisionreplay) can read traces without OMNeT++/INET.
+ */
+
+enum DecisionKind : uint8_t {
+    DECISION_FORWARD = 0,   // next hop selection
+    DECISION_OFFLOAD = 1,   // offload target selection at the task source
+};
+
+enum DecisionTraceFlags : uint32_t {
+    TRACE_DELAY_TIEBREAKER = 1 << 0,
+    TRACE_QUEUE_DELAY = 1 << 1,
+    TRACE_OFFLOAD_PIPELINE_DELAY = 1 << 2,
+    TRACE_MEASURED_LINK_DELAY = 1 << 3,
+};
+
+struct DecisionTraceHeader {
+    char magic[8];                      // "QGDTRACE"
+    uint32_t version;
+    uint32_t flags;                     // DecisionTraceFlags
+    double maxInfoAge;                  // beacon-derived info older than this is ignored (s)
+    double delayEstimationFactor;       // s/m
+    double distanceEqualityThreshold;   // m
+    double taskCyclesPerBit;
+    double reductionFactor;             // result size / task input size (offload pipeline estimate)
+    double linkDelayDeviationWeight;    // measured link delay = mean + weight * standard deviation
+};
+
+struct DecisionRecord {
+    uint8_t kind;                       // DecisionKind
+    uint8_t routingModeBefore;          // GpsrForwardingMode when the decision started (forward only)
+    uint8_t routingModeAfter;           // GpsrForwardingMode after the decision (greedy -> perimeter fallback)
+    uint8_t reserved = 0;
+    uint32_t numNeighbors;
+    uint32_t node;                      // IPv4 address of the deciding node
+    uint32_t destination;               // IPv4 address of the datagram destination
+    uint32_t chosen;                    // next hop / offload target (offload: node itself = process locally, 0 = none)
+    int32_t taskBits;                   // offload only
+    double time;
+    double selfX, selfY, selfZ;
+    double destX, destY, destZ;
+    double deadline;                    // absolute task deadline (0 = none, offload only)
+    double localCpuHz;                  // own cpuOffloadHz
+    double localBacklogCycles;          // own CPU backlog
+    double localQueueDelay;             // own TX queueing delay added to modeled links (measured link delays only)
+};
+
+struct DecisionTraceNeighbor {
+    uint32_t address;
+    uint32_t backlogBytes;              // advertised TX backlog
+    double x, y, z;
+    double queueInfoAge;                // age of backlog/bitrate info (s), negative = unknown
+    double txBitrate;                   // advertised bitrate (bps), 0 = unknown
+    double cpuInfoAge;                  // age of CPU info (s), negative = unknown
+    double cpuOffloadHz;
+    double cpuOffloadBacklogCycles;
+    double sojournTime;                 // advertised MAC queue sojourn time (s), negative = not advertised
+    double linkDelayMean;               // measured link delay fed back by the neighbor (s), negative = unknown
+    double linkDelayVariance;
+};
+
+static_assert(sizeof(DecisionTraceHeader) == 64, "unexpected DecisionTraceHeader layout");
+static_assert(sizeof(DecisionRecord) == 112, "unexpected DecisionRecord layout");
+static_assert(sizeof(DecisionTraceNeighbor) == 96, "unexpected DecisionTraceNeighbor layout");
+
+constexpr uint32_t DECISION_TRACE_VERSION = 5;
+constexpr char DECISION_TRACE_MAGIC[8] = { 'Q', 'G', 'D', 'T', 'R', 'A', 'C', 'E' };
+
+class DecisionTraceWriter
+{
+  private:
+    std::ofstream out;
+    std::vector<char> buffer;  // only allocated for nodes that actually record a trace
+
+  public:
+    bool open(const std::string& fileName, DecisionTraceHeader header)
+    {
+        // the stream buffer has to be installed before the file is opened to take effect
+        buffer.resize(1 << 20);
+        out.rdbuf()->pubsetbuf(buffer.data(), buffer.size());
+        out.open(fileName, std::ios::binary | std::ios::trunc);
+        if (!out)
+            return false;
+        std::memcpy(header.magic, DECISION_TRACE_MAGIC, sizeof(header.magic));
+        header.version = DECISION_TRACE_VERSION;
+        out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        return bool(out);
+    }
+
+    bool isOpen() const { return out.is_open(); }
+
+    void write(DecisionRecord record, const std::vector<DecisionTraceNeighbor>& neighbors)
+    {
+        record.numNeighbors = neighbors.size();
+        out.write(reinterpret_cast<const char *>(&record), sizeof(record));
+        out.write(reinterpret_cast<const char *>(neighbors.data()), neighbors.size() * sizeof(DecisionTraceNeighbor));
+    }
+
+    void close() { out.close(); }
+};
+
+/**
+ * In-memory view of a trace file: the whole file is loaded once and records
+ * are indexed by offset, so that they can be evaluated concurrently.
+ */
+class DecisionTraceReader
+{
+  private:
+    std::vector<char> data;
+    std::vector<size_t> offsets;
+    DecisionTraceHeader header;
+
+  public:
+    // returns an error message, or an empty string on success
+    std::string load(const std::string& fileName)
+    {
+        std::ifstream in(fileName, std::ios::binary | std::ios::ate);
+        if (!in)
+            return "cannot open " + fileName;
+        data.resize(in.tellg());
+        in.seekg(0);
+        in.read(data.data(), data.size());
+        if (data.size() < sizeof(header))
+            return fileName + ": truncated header";
+        std::memcpy(&header, data.data(), sizeof(header));
+        if (std::memcmp(header.magic, DECISION_TRACE_MAGIC, sizeof(header.magic)) != 0 || header.version != DECISION_TRACE_VERSION)
+            return fileName + ": not a decision trace (or unsupported version)";
+        size_t offset = sizeof(header);
+        while (offset + sizeof(DecisionRecord) <= data.size()) {
+            const DecisionRecord *record = reinterpret_cast<const DecisionRecord *>(data.data() + offset);
+            size_t size = sizeof(DecisionRecord) + record->numNeighbors * sizeof(DecisionTraceNeighbor);
+            if (offset + size > data.size())
+                break;  // record cut off by an aborted run
+            offsets.push_back(offset);
+            offset += size;
+        }
+        return "";
+    }
+
+    const DecisionTraceHeader& getHeader() const { return header; }
+    size_t getNumRecords() const { return offsets.size(); }
+    const DecisionRecord& getRecord(size_t i) const { return *reinterpret_cast<const DecisionRecord *>(data.data() + offsets[i]); }
+    const DecisionTraceNeighbor *getNeighbors(size_t i) const
+    {
+        return reinterpret_cast<const DecisionTraceNeighbor *>(data.data() + offsets[i] + sizeof(DecisionRecord));
+    }
+};
+
+} // namespace researchproject
+
+#endif
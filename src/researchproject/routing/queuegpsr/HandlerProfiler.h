@@ -0,0 +1,115 @@
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+//
+
+#ifndef __RESEARCHPROJECT_HANDLERPROFILER_H
+#define __RESEARCHPROJECT_HANDLERPROFILER_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+namespace researchproject {
+
+/**
+ * Call count and wall-clock time histogram of one profiled handler.
+ *
+ * Durations are collected in log2 buckets of nanoseconds: bucket b holds
+ * durations in [2^b, 2^(b+1)) ns (bucket 0 also holds 0 ns). Quantiles are
+ * reported as the upper edge of their bucket, i.e. within a factor of two.
+ */
+struct HandlerProfile
+{
+    static const int NUM_BUCKETS = 48;
+
+    uint64_t calls = 0;
+    uint64_t totalNs = 0;
+    uint64_t maxNs = 0;
+    uint64_t buckets[NUM_BUCKETS] = {};
+
+    static int getBucket(uint64_t ns) {
+        int bucket = 63 - __builtin_clzll(ns | 1);
+        return std::min(bucket, NUM_BUCKETS - 1);
+    }
+
+    void record(uint64_t ns) {
+        calls++;
+        totalNs += ns;
+        maxNs = std::max(maxNs, ns);
+        buckets[getBucket(ns)]++;
+    }
+
+    void merge(const HandlerProfile& other) {
+        calls += other.calls;
+        totalNs += other.totalNs;
+        maxNs = std::max(maxNs, other.maxNs);
+        for (int i = 0; i < NUM_BUCKETS; i++)
+            buckets[i] += other.buckets[i];
+    }
+
+    double getQuantileNs(double quantile) const {
+        uint64_t rank = (uint64_t)(quantile * calls);
+        uint64_t cumulative = 0;
+        for (int i = 0; i < NUM_BUCKETS; i++) {
+            cumulative += buckets[i];
+            if (cumulative > rank)
+                return std::min((double)(2ULL << i), (double)maxNs);
+        }
+        return maxNs;
+    }
+};
+
+/**
+ * Per-handler profiles of one module, indexed by a handler enum of the user.
+ *
+ * Handlers are measured by a Scope on the stack with std::chrono::steady_clock.
+ * While the profiler is disabled a Scope does not read the clock, so
+ * profiling costs one branch per profiled call.
+ */
+class HandlerProfiler
+{
+  public:
+    class Scope
+    {
+      private:
+        HandlerProfile *profile;
+        std::chrono::steady_clock::time_point start;
+
+      public:
+        Scope(HandlerProfiler& profiler, int handler) : profile(profiler.enabled ? &profiler.profiles[handler] : nullptr) {
+            if (profile)
+                start = std::chrono::steady_clock::now();
+        }
+        ~Scope() {
+            if (profile)
+                profile->record(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+        }
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+    };
+
+  private:
+    bool enabled = false;
+    std::vector<HandlerProfile> profiles;
+
+  public:
+    void configure(bool enabled, int numHandlers) {
+        this->enabled = enabled;
+        profiles.assign(numHandlers, HandlerProfile());
+    }
+    bool isEnabled() const { return enabled; }
+    int getNumHandlers() const { return profiles.size(); }
+    const HandlerProfile& getProfile(int handler) const { return profiles[handler]; }
+
+    void merge(const HandlerProfiler& other) {
+        if (profiles.size() < other.profiles.size())
+            profiles.resize(other.profiles.size());
+        for (size_t i = 0; i < other.profiles.size(); i++)
+            profiles[i].merge(other.profiles[i]);
+    }
+};
+
+} // namespace researchproject
+
+#endif
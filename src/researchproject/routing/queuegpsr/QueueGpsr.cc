@@ -8,12 +8,16 @@
 #include "QueueGpsr.h"
 
 #include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <functional>
 #include <map>
+#include <set>
 #include <sstream>
 
 #include "inet/queueing/contract/IPacketQueue.h"
 #include "inet/queueing/contract/IPacketCollection.h"
-#include "inet/networklayer/common/L3AddressResolver.h"
 
 #include "inet/common/INETUtils.h"
 #include "inet/common/IProtocolRegistrationListener.h"
@@ -28,7 +32,6 @@
 #include "inet/networklayer/common/L3Tools.h"
 #include "inet/networklayer/common/NextHopAddressTag_m.h"
 #include "inet/networklayer/contract/IInterfaceTable.h"
-#include "inet/networklayer/common/L3AddressResolver.h"
 
 #ifdef INET_WITH_IPv4
 #include "inet/networklayer/ipv4/Ipv4Header_m.h"
@@ -47,9 +50,36 @@ namespace researchproject {
 
 Define_Module(QueueGpsr);
 
-static inline double determinant(double a1, double a2, double b1, double b2)
+const char *QueueGpsr::profiledHandlerNames[QueueGpsr::NUM_PROFILED_HANDLERS] = {
+    "datagramPreRoutingHook",
+    "datagramLocalInHook",
+    "datagramLocalOutHook",
+    "processBeacon",
+    "processOracleDiscovery",
+    "findGreedyRoutingNextHop",
+    "findPerimeterRoutingNextHop",
+    "getLocalTxBacklogBytes",
+    "completeTaskProcessing",
+};
+
+static inline gpsrcore::Vec3 toVec3(const Coord& coord)
 {
-    return a1 * b2 - a2 * b1;
+    return gpsrcore::Vec3(coord.x, coord.y, coord.z);
+}
+
+static inline Coord toCoord(const gpsrcore::Vec3& vector)
+{
+    return Coord(vector.x, vector.y, vector.z);
+}
+
+// Opaque node id for the routing core (0 = unspecified)
+static uint64_t getCoreNodeId(const L3Address& address)
+{
+    if (address.isUnspecified())
+        return 0;
+    if (address.getType() == L3Address::IPv4)
+        return address.toIpv4().getInt();
+    return std::hash<std::string>()(address.str()) | (1ull << 63);
 }
 
 QueueGpsr::QueueGpsr()
@@ -63,6 +93,12 @@ QueueGpsr::~QueueGpsr()
     cancelAndDelete(queueMonitorTimer);
     cancelAndDelete(neighborTableDebugTimer);
     cancelAndDelete(preloadDurabilityTimer);
+    cancelAndDelete(taskAssemblyTimer);
+    cancelAndDelete(snapshotTimer);
+    cancelAndDelete(storeCarryForwardTimer);
+    cancelAndDelete(locationQueryTimer);
+    for (auto& entry : pendingProcessingTasks)
+        cancelAndDelete(entry.first);
 }
 
 //
@@ -118,6 +154,7 @@ void QueueGpsr::initialize(int stage)
         taskInputBits = par("taskInputBits");
         taskCyclesPerBit = par("taskCyclesPerBit");
         reductionFactor = par("reductionFactor");
+        enableOffloadPipelineEstimate = par("enableOffloadPipelineEstimate");
         
         if (enableOffloadDecisions) {
             EV_INFO << "Offload decisions enabled: taskInputBits=" << taskInputBits 
@@ -125,6 +162,38 @@ void QueueGpsr::initialize(int stage)
                     << ", reductionFactor=" << reductionFactor
                     << " (total cycles per task: " << (taskInputBits * taskCyclesPerBit) << ")" << endl;
         }
+
+        // Deadline-aware scheduling
+        taskDeadline = par("taskDeadline");
+        const char *cpuSchedulingPolicyString = par("cpuSchedulingPolicy");
+        if (!strcmp(cpuSchedulingPolicyString, "FIFO"))
+            cpuSchedulingPolicy = CPU_SCHEDULING_FIFO;
+        else if (!strcmp(cpuSchedulingPolicyString, "EDF"))
+            cpuSchedulingPolicy = CPU_SCHEDULING_EDF;
+        else
+            throw cRuntimeError("Unknown CPU scheduling policy");
+        taskDeadlineMissedSignal = registerSignal("taskDeadlineMissed");
+        taskQueueingTimeSignal = registerSignal("taskQueueingTime");
+
+        // Result cache
+        enableResultCache = par("enableResultCache");
+        resultCacheCapacityBytes = par("resultCacheCapacity");
+        taskContentPoolSize = par("taskContentPoolSize");
+
+        // Streaming processing
+        taskChunks = par("taskChunks");
+        if (taskChunks < 1)
+            throw cRuntimeError("taskChunks must be at least 1");
+        enableStreamingProcessing = par("enableStreamingProcessing");
+        taskAssemblyTimeout = par("taskAssemblyTimeout");
+        taskCompletionLatencySignal = registerSignal("taskCompletionLatency");
+        taskDelayEstimateSignal = registerSignal("taskDelayEstimate");
+        linkDelaySignal = registerSignal("linkDelay");
+        taskDelayEstimationErrorSignal = registerSignal("taskDelayEstimationError");
+        // Warm-start snapshots
+        snapshotDir = par("snapshotDir").stdstringValue();
+        snapshotSaveTime = par("snapshotSaveTime");
+        restoreSnapshot = par("restoreSnapshot");
         
         // context
         host = getContainingNode(this);
@@ -133,24 +202,173 @@ void QueueGpsr::initialize(int stage)
         mobility = check_and_cast<IMobility *>(host->getSubmodule("mobility"));
         routingTable.reference(this, "routingTableModule", true);
         networkProtocol.reference(this, "networkProtocolModule", true);
+        neighborStateService.reference(this, "neighborStateServiceModule", true);
         // internal
         beaconTimer = new cMessage("BeaconTimer");
         purgeNeighborsTimer = new cMessage("PurgeNeighborsTimer");
         queueMonitorTimer = new cMessage("QueueMonitorTimer");  // STEP 2 AUDIT timer
         neighborTableDebugTimer = new cMessage("NeighborTableDebugTimer");  // STEP 4 AUDIT timer
         preloadDurabilityTimer = new cMessage("PreloadDurabilityTimer");  // PRELOAD DURABILITY timer
+        taskAssemblyTimer = new cMessage("TaskAssemblyTimer");
+        snapshotTimer = new cMessage("SnapshotTimer");
+        storeCarryForwardTimer = new cMessage("StoreCarryForwardTimer");
+        locationQueryTimer = new cMessage("LocationQueryTimer");
         // packet size
         positionByteLength = par("positionByteLength");
+        const char *locationServiceString = par("locationService");
+        if (!strcmp(locationServiceString, "global"))
+            useGlobalLocationService = true;
+        else if (!strcmp(locationServiceString, "local"))
+            useGlobalLocationService = false;
+        else if (!strcmp(locationServiceString, "homeRegion")) {
+            useGlobalLocationService = false;
+            useHomeRegionLocationService = true;
+        }
+        else
+            throw cRuntimeError("Unknown location service");
         // KLUDGE implement position registry protocol
-        globalPositionTable.clear();
+        if (useGlobalLocationService) {
+            globalPositionTable.clear();
+            globalLocationMotion.clear();
+        }
+        // home-region location service
+        homeRegionSize = par("homeRegionSize");
+        if (useHomeRegionLocationService && homeRegionSize <= 0)
+            throw cRuntimeError("homeRegionSize must be positive");
+        numHomeRegionColumns = std::max(1, (int)std::ceil((double)par("locationAreaWidth") / homeRegionSize));
+        numHomeRegionRows = std::max(1, (int)std::ceil((double)par("locationAreaHeight") / homeRegionSize));
+        locationUpdateInterval = par("locationUpdateInterval");
+        locationUpdateDistance = par("locationUpdateDistance");
+        locationRegistryTimeout = par("locationRegistryTimeout");
+        locationCacheTimeout = par("locationCacheTimeout");
+        locationQueryBatchDelay = par("locationQueryBatchDelay");
+        locationQueryTimeout = par("locationQueryTimeout");
+        locationMaxHops = par("locationMaxHops");
+        if (locationMaxHops < 1)
+            throw cRuntimeError("locationMaxHops must be at least 1");
+        locationLookupLatencySignal = registerSignal("locationLookupLatency");
+        // next hop stability
+        enableStickyNextHop = par("enableStickyNextHop");
+        stickyCostMargin = par("stickyCostMargin");
+        reorderDepthSignal = registerSignal("reorderDepth");
+        // forwarding mode of locally originated packets
+        const char *forwardingModeString = par("forwardingMode");
+        if (!strcmp(forwardingModeString, "greedy"))
+            forwardingMode = GPSR_GREEDY_ROUTING;
+        else if (!strcmp(forwardingModeString, "backpressure"))
+            forwardingMode = GPSR_BACKPRESSURE_ROUTING;
+        else
+            throw cRuntimeError("Unknown forwarding mode");
+        // recovery strategy
+        const char *recoveryStrategyString = par("recoveryStrategy");
+        if (!strcmp(recoveryStrategyString, "face"))
+            recoveryStrategy = RECOVERY_FACE;
+        else if (!strcmp(recoveryStrategyString, "boundedFace"))
+            recoveryStrategy = RECOVERY_BOUNDED_FACE;
+        else if (!strcmp(recoveryStrategyString, "projectedFace"))
+            recoveryStrategy = RECOVERY_PROJECTED_FACE;
+        else
+            throw cRuntimeError("Unknown recovery strategy");
+        recoveryInitialRadiusFactor = par("recoveryInitialRadiusFactor");
+        recoveryRadiusGrowthFactor = par("recoveryRadiusGrowthFactor");
+        if (recoveryStrategy == RECOVERY_BOUNDED_FACE && (recoveryInitialRadiusFactor < 1 || recoveryRadiusGrowthFactor <= 1))
+            throw cRuntimeError("boundedFace recovery needs recoveryInitialRadiusFactor >= 1 and recoveryRadiusGrowthFactor > 1");
+        perimeterDurationSignal = registerSignal("perimeterDuration");
+        perimeterHopsSignal = registerSignal("perimeterHops");
+        hopCountSignal = registerSignal("hopCount");
+        pathStretchSignal = registerSignal("pathStretch");
+        // multipath load spreading
+        const char *multipathModeString = par("multipathMode");
+        if (!strcmp(multipathModeString, "none"))
+            multipathMode = MULTIPATH_NONE;
+        else if (!strcmp(multipathModeString, "weighted"))
+            multipathMode = MULTIPATH_WEIGHTED;
+        else if (!strcmp(multipathModeString, "drr"))
+            multipathMode = MULTIPATH_DRR;
+        else
+            throw cRuntimeError("Unknown multipath mode");
+        const char *multipathGranularityString = par("multipathGranularity");
+        if (!strcmp(multipathGranularityString, "packet"))
+            multipathPerFlow = false;
+        else if (!strcmp(multipathGranularityString, "flow"))
+            multipathPerFlow = true;
+        else
+            throw cRuntimeError("Unknown multipath granularity");
+        // traffic classes
+        enableTrafficClasses = par("enableTrafficClasses");
+        classForwardingPolicies[TRAFFIC_CLASS_TASK] = parseClassForwardingPolicy("taskClassPolicy");
+        classForwardingPolicies[TRAFFIC_CLASS_RESULT] = parseClassForwardingPolicy("resultClassPolicy");
+        classForwardingPolicies[TRAFFIC_CLASS_BULK] = parseClassForwardingPolicy("bulkClassPolicy");
+        classUserPriorities[TRAFFIC_CLASS_TASK] = par("taskUserPriority");
+        classUserPriorities[TRAFFIC_CLASS_RESULT] = par("resultUserPriority");
+        classUserPriorities[TRAFFIC_CLASS_BULK] = par("bulkUserPriority");
+        for (int userPriority : classUserPriorities)
+            if (userPriority < -1 || userPriority > 7)
+                throw cRuntimeError("User priorities must be in 0..7 (or -1 for none)");
+        classDelaySignals[TRAFFIC_CLASS_TASK] = registerSignal("taskDelay");
+        classDelaySignals[TRAFFIC_CLASS_RESULT] = registerSignal("resultDelay");
+        classDelaySignals[TRAFFIC_CLASS_BULK] = registerSignal("bulkDelay");
+        // store-carry-forward
+        enableStoreCarryForward = par("enableStoreCarryForward");
+        storeCarryForwardCapacity = par("storeCarryForwardCapacity");
+        storeCarryForwardTimeout = par("storeCarryForwardTimeout");
+        storeCarryForwardCheckInterval = par("storeCarryForwardCheckInterval");
+        if (enableStoreCarryForward && storeCarryForwardCapacity <= 0)
+            throw cRuntimeError("storeCarryForwardCapacity must be positive");
+        carryBufferingDelaySignal = registerSignal("carryBufferingDelay");
+        // handler profiling
+        profiler.configure(par("enableProfiling"), NUM_PROFILED_HANDLERS);
+        if (profiler.isEnabled() && numProfiledModules++ == 0)
+            networkProfiler.configure(true, NUM_PROFILED_HANDLERS);
+        // velocity-aware position extrapolation
+        enablePositionExtrapolation = par("enablePositionExtrapolation");
+        maxExtrapolationTime = par("maxExtrapolationTime");
+        maxNeighborRange = par("maxNeighborRange");
+        // oracle neighbor discovery
+        const char *neighborDiscoveryString = par("neighborDiscovery");
+        if (!strcmp(neighborDiscoveryString, "beacon"))
+            useOracleDiscovery = false;
+        else if (!strcmp(neighborDiscoveryString, "oracle"))
+            useOracleDiscovery = true;
+        else
+            throw cRuntimeError("Unknown neighbor discovery mode");
+        if (useOracleDiscovery) {
+            oracleDiscoveryInterval = par("oracleDiscoveryInterval");
+            oracleDiscoveryRange = par("oracleDiscoveryRange");
+            // cells as large as the range: a query visits the 27 cells around the node
+            oracleIndex.clear();
+            if (!oracleIndex.setCellSize(oracleDiscoveryRange))
+                throw cRuntimeError("oracleDiscoveryRange must be positive");
+        }
         // read Phase 3 gating parameter
         enableQueueDelay = par("enableQueueDelay");
+        if (forwardingMode == GPSR_BACKPRESSURE_ROUTING && !enableQueueDelay)
+            throw cRuntimeError("Backpressure forwarding needs the TX backlog advertised in beacons (enableQueueDelay = true)");
+        enableLinkDelayMeasurement = par("enableLinkDelayMeasurement");
+        linkDelaySmoothing = par("linkDelaySmoothing");
+        linkDelayDeviationWeight = par("linkDelayDeviationWeight");
+        linkDelayMaxAge = par("linkDelayMaxAge");
+        if (linkDelaySmoothing <= 0 || linkDelaySmoothing > 1)
+            throw cRuntimeError("linkDelaySmoothing must be in (0, 1]");
+        const char *queueDelayMetricString = par("queueDelayMetric");
+        if (!strcmp(queueDelayMetricString, "backlog"))
+            useSojournTime = false;
+        else if (!strcmp(queueDelayMetricString, "sojourn"))
+            useSojournTime = true;
+        else
+            throw cRuntimeError("Unknown queue delay metric");
+        if (par("recordDecisionTrace"))
+            openDecisionTrace();
     }
     else if (stage == INITSTAGE_ROUTING_PROTOCOLS) {
         registerProtocol(Protocol::manet, gate("ipOut"), gate("ipIn"));
         host->subscribe(linkBrokenSignal, this);
         networkProtocol->registerHook(0, this);
-        WATCH(neighborPositionTable);
+        if (useSojournTime) {
+            sojournQueue = findSojournQueue();
+            if (sojournQueue == nullptr)
+                throw cRuntimeError("queueDelayMetric = \"sojourn\" needs a SojournFairQueue in the MAC of wlan[0]");
+        }
         
         // STEP 1 AUDIT: Module wiring proof with full details (using stdout for visibility)
         std::cout << "━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━\n";
@@ -231,6 +449,14 @@ void QueueGpsr::processSelfMessage(cMessage *message)
         processNeighborTableDebug();  // STEP 4 AUDIT
     else if (message == preloadDurabilityTimer)
         processPreloadDurabilityTimer();  // PRELOAD DURABILITY
+    else if (message == taskAssemblyTimer)
+        processTaskAssemblyTimer();
+    else if (message == snapshotTimer)
+        saveSnapshot();
+    else if (message == storeCarryForwardTimer)
+        processStoreCarryForwardTimer();
+    else if (message == locationQueryTimer)
+        processLocationQueryTimer();
     else if (pendingProcessingTasks.find(message) != pendingProcessingTasks.end())
         completeTaskProcessing(message);  // Phase 5: processing completion
     else
@@ -252,7 +478,10 @@ void QueueGpsr::processMessage(cMessage *message)
 void QueueGpsr::scheduleBeaconTimer()
 {
     EV_DEBUG << "Scheduling beacon timer" << endl;
-    scheduleAfter(beaconInterval + uniform(-1, 1) * maxJitter, beaconTimer);
+    if (useOracleDiscovery)
+        scheduleAfter(oracleDiscoveryInterval, beaconTimer);  // no channel contention to avoid: no jitter
+    else
+        scheduleAfter(beaconInterval + uniform(-1, 1) * maxJitter, beaconTimer);
 }
 
 void QueueGpsr::processBeaconTimer()
@@ -269,8 +498,16 @@ void QueueGpsr::processBeaconTimer()
     
     const L3Address selfAddress = getSelfAddress();
     if (!selfAddress.isUnspecified()) {
-        sendBeacon(createBeacon());
+        if (useOracleDiscovery) {
+            processOracleDiscovery();
+            if (!carriedDatagrams.empty())
+                processCarriedDatagrams(true);
+        }
+        else
+            sendBeacon(createBeacon());
         storeSelfPositionInGlobalRegistry();
+        if (useHomeRegionLocationService)
+            sendLocationUpdateIfDue();
     }
     scheduleBeaconTimer();
     schedulePurgeNeighborsTimer();
@@ -370,6 +607,8 @@ void QueueGpsr::processPreloadDurabilityTimer()
         } else {
             std::cout << " ⚪ EMPTY";
         }
+        if (sojournQueue != nullptr)
+            std::cout << " | sojourn=" << sojournQueue->getSojournTime() << "s";
         std::cout << "\n" << std::flush;
     }
     
@@ -399,8 +638,8 @@ void QueueGpsr::processNeighborTableDebug()
     L3Address destAddr = L3Address(Ipv4Address("10.0.0.4"));
     Coord destPos;
     bool hasDestPos = false;
-    if (globalPositionTable.hasPosition(destAddr)) {
-        destPos = globalPositionTable.getPosition(destAddr);
+    if (getLocationTable().hasPosition(destAddr)) {
+        destPos = getLocationTable().getPosition(destAddr);
         hasDestPos = true;
     }
     double myDistToDest = hasDestPos ? myPos.distance(destPos) : -1.0;
@@ -414,15 +653,15 @@ void QueueGpsr::processNeighborTableDebug()
     
     // Dump position table with detailed analysis
     std::cout << "  ┌─ Neighbor Position Table (with GPSR Analysis) ────────────┐\n";
-    std::vector<L3Address> neighborAddrs = neighborPositionTable.getAddresses();
+    std::vector<L3Address> neighborAddrs = neighborStateService->getNeighborAddresses();
     std::cout << "  │ Total neighbors: " << neighborAddrs.size() << "\n";
     if (neighborAddrs.empty()) {
         std::cout << "  │ ⚠️  WARNING: No neighbors discovered! Check beacon interval.\n";
     } else {
         int forwardCandidates = 0;
         for (const L3Address& addr : neighborAddrs) {
-            if (neighborPositionTable.hasPosition(addr)) {
-                Coord neighborPos = neighborPositionTable.getPosition(addr);
+            if (const NeighborStateService::NeighborState *state = neighborStateService->findNeighbor(addr)) {
+                Coord neighborPos = state->position;
                 double neighborDistToDest = hasDestPos ? neighborPos.distance(destPos) : -1.0;
                 bool isForwardCandidate = hasDestPos && (neighborDistToDest < myDistToDest);
                 
@@ -441,25 +680,19 @@ void QueueGpsr::processNeighborTableDebug()
                 }
                 
                 // Check queue backlog for this neighbor
-                auto backlogIt = neighborTxBacklogBytes.find(addr);
-                if (backlogIt != neighborTxBacklogBytes.end()) {
-                    const NeighborQueueInfo& info = backlogIt->second;
-                    uint32_t backlog = info.bytes;
-                    simtime_t age = simTime() - info.lastUpdate;
-                    std::cout << "  │     Queue Backlog: " << backlog << " bytes (age: " << age << "s)";
-                    if (backlog > 10000) {
-                        std::cout << " 🔴 HEAVILY CONGESTED";
-                    } else if (backlog > 1000) {
-                        std::cout << " 🟡 MODERATE";
-                    } else if (backlog > 0) {
-                        std::cout << " 🟢 LIGHT";
-                    } else {
-                        std::cout << " ⚪ IDLE";
-                    }
-                    std::cout << "\n";
+                uint32_t backlog = state->backlogBytes;
+                simtime_t age = simTime() - state->lastUpdate;
+                std::cout << "  │     Queue Backlog: " << backlog << " bytes (age: " << age << "s)";
+                if (backlog > 10000) {
+                    std::cout << " 🔴 HEAVILY CONGESTED";
+                } else if (backlog > 1000) {
+                    std::cout << " 🟡 MODERATE";
+                } else if (backlog > 0) {
+                    std::cout << " 🟢 LIGHT";
                 } else {
-                    std::cout << "  │     Queue Backlog: NO DATA (no beacon received yet)\n";
+                    std::cout << " ⚪ IDLE";
                 }
+                std::cout << "\n";
             }
         }
         std::cout << "  │\n";
@@ -495,8 +728,12 @@ void QueueGpsr::sendUdpPacket(Packet *packet)
 void QueueGpsr::processUdpPacket(Packet *packet)
 {
     packet->popAtFront<UdpHeader>();
-    processBeacon(packet);
-    schedulePurgeNeighborsTimer();
+    if (dynamicPtrCast<const LocationMessage>(packet->peekAtFront<Chunk>()))
+        processLocationMessage(packet);
+    else {
+        processBeacon(packet);
+        schedulePurgeNeighborsTimer();
+    }
 }
 
 //
@@ -508,19 +745,41 @@ const Ptr<GpsrBeacon> QueueGpsr::createBeacon()
     const auto& beacon = makeShared<GpsrBeacon>();
     beacon->setAddress(getSelfAddress());
     beacon->setPosition(mobility->getCurrentPosition());
+    beacon->setVelocity(mobility->getCurrentVelocity());
     
-    // Calculate chunk length: address + position + txBacklogBytes (uint32_t=4) + cpuOffloadHz (double=8) + cpuOffloadBacklogCycles (double=8)
-    B beaconLength = B(getSelfAddress().getAddressType()->getAddressByteLength() + positionByteLength + sizeof(uint32_t) + 2 * sizeof(double));
+    // Calculate chunk length: address + position + velocity (encoded like the position) + txBacklogBytes (uint32_t=4) + cpuOffloadHz, cpuOffloadBacklogCycles, txBitrate, txSojournTime (double=8 each)
+    B beaconLength = B(getSelfAddress().getAddressType()->getAddressByteLength() + 2 * positionByteLength + sizeof(uint32_t) + 4 * sizeof(double));
     beacon->setChunkLength(beaconLength);
+
+    // Advertise our own transmitter bitrate so that neighbors can compute Q/R without
+    // reaching into this host's modules
+    beacon->setTxBitrate(getLocalTxBitrate());
     
-    // Phase 4: include CPU offload capacity in beacon
-    beacon->setCpuOffloadHz(cpuOffloadHz);
+    // Phase 4: include CPU offload capacity in beacon (effective capacity accounts for result cache hits)
+    beacon->setCpuOffloadHz(getAdvertisedCpuOffloadHz());
     beacon->setCpuOffloadBacklogCycles(cpuOffloadBacklogCycles);
     
     // include local TX backlog bytes in beacon (Phase 3, optional)
+    if (enableQueueDelay)
+        beacon->setTxBacklogBytes((uint32_t)getLocalTxBacklogBytes());
+    else
+        beacon->setTxBacklogBytes(0);  // Explicit zero when queue-aware disabled
+    // the sojourn time of the MAC queue replaces backlog / bitrate at the neighbors
+    if (enableQueueDelay && sojournQueue != nullptr)
+        beacon->setTxSojournTime(sojournQueue->getSojournTime().dbl());
+    if (enableLinkDelayMeasurement) {
+        setLinkDelayFeedback(beacon.get());
+        int addressBytes = getSelfAddress().getAddressType()->getAddressByteLength();
+        beacon->addChunkLength(B(beacon->getLinkDelaySendersArraySize() * (addressBytes + 2 * sizeof(double))));
+    }
+    return beacon;
+}
+
+void QueueGpsr::sendBeacon(const Ptr<GpsrBeacon>& beacon)
+{
+    EV_INFO << "Sending beacon: address = " << beacon->getAddress() << ", position = " << beacon->getPosition() << endl;
     if (enableQueueDelay) {
-        uint32_t localBacklog = (uint32_t)getLocalTxBacklogBytes();
-        beacon->setTxBacklogBytes(localBacklog);
+        uint32_t localBacklog = beacon->getTxBacklogBytes();
         
         // STEP 3 AUDIT: Log beacon transmission with nonzero backlog (host[7] and host[1])
         if (localBacklog > 0 && (strcmp(getContainingNode(this)->getFullName(), "host[7]") == 0 || 
@@ -535,17 +794,12 @@ const Ptr<GpsrBeacon> QueueGpsr::createBeacon()
         
         // DIAGNOSTIC: Log ALL beacon transmissions to track beacon frequency and queue measurement
         std::cout << "🟦 Beacon TX [" << getContainingNode(this)->getFullName() << "]: t=" << simTime() 
-                  << "s | Q=" << localBacklog << " bytes | CPU=" << (cpuOffloadHz / 1e9) << " GHz | nextBeacon≈t=" 
+                  << "s | Q=" << localBacklog << " bytes";
+        if (beacon->getTxSojournTime() >= 0)
+            std::cout << " | sojourn=" << beacon->getTxSojournTime() << "s";
+        std::cout << " | CPU=" << (cpuOffloadHz / 1e9) << " GHz | nextBeacon≈t=" 
                   << (simTime() + beaconInterval).dbl() << "s" << std::endl;
-    } else {
-        beacon->setTxBacklogBytes(0);  // Explicit zero when queue-aware disabled
     }
-    return beacon;
-}
-
-void QueueGpsr::sendBeacon(const Ptr<GpsrBeacon>& beacon)
-{
-    EV_INFO << "Sending beacon: address = " << beacon->getAddress() << ", position = " << beacon->getPosition() << endl;
     Packet *udpPacket = new Packet("GPSRBeacon");
     udpPacket->insertAtBack(beacon);
     auto udpHeader = makeShared<UdpHeader>();
@@ -569,12 +823,12 @@ void QueueGpsr::sendBeacon(const Ptr<GpsrBeacon>& beacon)
 
 void QueueGpsr::processBeacon(Packet *packet)
 {
+    HandlerProfiler::Scope profileScope(profiler, PROFILE_PROCESS_BEACON);
     const auto& beacon = packet->peekAtFront<GpsrBeacon>();
     EV_INFO << "Processing beacon: address = " << beacon->getAddress() << ", position = " << beacon->getPosition() << endl;
-    neighborPositionTable.setPosition(beacon->getAddress(), beacon->getPosition());
-    
-    // CRITICAL FIX: Also register neighbor position in global table so routing can find destination positions
-    storePositionInGlobalRegistry(beacon->getAddress(), beacon->getPosition());
+    storeNeighborState(*beacon, simTime());
+    if (!carriedDatagrams.empty())
+        processCarriedDatagrams(true);
     
     // DEBUG: Log ALL beacon receptions for validation
     std::cout << "[BEACON-RX] " << getContainingNode(this)->getFullName() 
@@ -585,42 +839,18 @@ void QueueGpsr::processBeacon(Packet *packet)
     if (strcmp(getContainingNode(this)->getFullName(), "host[1]") == 0 && simTime() >= 4.0 && simTime() <= 8.0) {
         // Check if we now know about destination
         L3Address destAddr = L3Address(Ipv4Address("10.0.0.4"));
-        if (globalPositionTable.hasPosition(destAddr)) {
-            std::cout << "  ✓ host[1] NOW knows dest position: " << globalPositionTable.getPosition(destAddr) << std::endl;
+        if (getLocationTable().hasPosition(destAddr)) {
+            std::cout << "  ✓ host[1] NOW knows dest position: " << getLocationTable().getPosition(destAddr) << std::endl;
         } else {
             std::cout << "  ✗ host[1] still doesn't know dest position" << std::endl;
         }
     }
     
-    // store neighbor TX backlog if present (Phase 3) WITH TIMESTAMP for aging
-    uint32_t nb = 0;
-    try {
-        // generated accessor exists after msg change
-        nb = beacon->getTxBacklogBytes();
-        NeighborQueueInfo info;
-        info.bytes = nb;
-        info.lastUpdate = simTime();
-        neighborTxBacklogBytes[beacon->getAddress()] = info;
-    }
-    catch (...) {
-        // older beacons may not contain the field; ignore
-    }
+    uint32_t nb = beacon->getTxBacklogBytes();
     
-    // Phase 4: store neighbor CPU offload capacity
-    try {
-        NeighborCpuInfo cpuInfo;
-        cpuInfo.cpuOffloadHz = beacon->getCpuOffloadHz();
-        cpuInfo.cpuOffloadBacklogCycles = beacon->getCpuOffloadBacklogCycles();
-        cpuInfo.lastUpdate = simTime();
-        neighborCpuCapacity[beacon->getAddress()] = cpuInfo;
-        
-        // VALIDATION LOG: CPU capacity beacon reception
-        EV_INFO << "Neighbor CPU capacity updated: " << beacon->getAddress() 
-                << " cpuOffloadHz=" << cpuInfo.cpuOffloadHz << " Hz" << endl;
-    }
-    catch (...) {
-        // older beacons may not contain CPU fields; ignore
-    }
+    // VALIDATION LOG: CPU capacity beacon reception
+    EV_INFO << "Neighbor CPU capacity updated: " << beacon->getAddress() 
+            << " cpuOffloadHz=" << beacon->getCpuOffloadHz() << " Hz" << endl;
     
     // STEP 3 AUDIT: Show beacon reception and neighbor table update (host[0] for micro diamond test)
     // LOG ALL BEACONS to debug why Relay A isn't visible
@@ -631,13 +861,13 @@ void QueueGpsr::processBeacon(Packet *packet)
             std::cout << "  Time: " << simTime() << " s\n";
             std::cout << "  Sender: " << beacon->getAddress() << "\n";
             std::cout << "  txBacklogBytes in beacon: " << nb << " bytes\n";
-            std::cout << "  Stored in neighborTxBacklogBytes[" << beacon->getAddress() << "] = {" << nb << " bytes, t=" << simTime() << "}\n";
-            std::cout << "  Neighbor table size: " << neighborTxBacklogBytes.size() << " entries\n";
+            std::cout << "  Stored in neighborStateService[" << beacon->getAddress() << "] = {" << nb << " bytes, t=" << simTime() << "}\n";
+            std::cout << "  Neighbor table size: " << neighborStateService->getNumNeighbors() << " entries\n";
             std::cout << "━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━\n" << std::flush;
         } else {
             double cpuGHz = 0;
-            if (neighborCpuCapacity.find(beacon->getAddress()) != neighborCpuCapacity.end()) {
-                cpuGHz = neighborCpuCapacity[beacon->getAddress()].cpuOffloadHz / 1e9;
+            if (const NeighborStateService::NeighborState *state = neighborStateService->findNeighbor(beacon->getAddress())) {
+                cpuGHz = state->cpuOffloadHz / 1e9;
             }
             std::cout << "🔵 Beacon RX [host[0]]: t=" << simTime() << "s from " << beacon->getAddress() 
                       << " | Q=" << nb << " bytes (IDLE) | CPU=" << cpuGHz << " GHz\n" << std::flush;
@@ -647,6 +877,106 @@ void QueueGpsr::processBeacon(Packet *packet)
     delete packet;
 }
 
+void QueueGpsr::storeNeighborState(const GpsrBeacon& beacon, simtime_t time)
+{
+    const L3Address& address = beacon.getAddress();
+    
+    // CRITICAL FIX: Also register neighbor position in global table so routing can find destination positions
+    storePositionInGlobalRegistry(address, beacon.getPosition(), beacon.getVelocity());
+    
+    // the node's single neighbor table; routing reads it back like the other modules do
+    NeighborStateService::NeighborState state;
+    state.position = beacon.getPosition();
+    state.velocity = beacon.getVelocity();
+    state.txBitrate = beacon.getTxBitrate();
+    state.backlogBytes = beacon.getTxBacklogBytes();
+    state.sojournTime = beacon.getTxSojournTime();
+    const L3Address selfAddress = getSelfAddress();
+    for (size_t i = 0; i < beacon.getLinkDelaySendersArraySize(); i++) {
+        if (beacon.getLinkDelaySenders(i) == selfAddress) {
+            state.linkDelayMean = beacon.getLinkDelayMeans(i);
+            state.linkDelayVariance = beacon.getLinkDelayVariances(i);
+            break;
+        }
+    }
+    state.cpuOffloadHz = beacon.getCpuOffloadHz();
+    state.cpuOffloadBacklogCycles = beacon.getCpuOffloadBacklogCycles();
+    state.lastUpdate = time;
+    neighborStateService->updateNeighbor(address, state);
+}
+
+void QueueGpsr::setLinkDelayFeedback(GpsrBeacon *beacon) const
+{
+    // only senders heard from recently: an old measurement says little about the link now
+    std::vector<std::pair<L3Address, const LinkDelayMeasurement *>> feedback;
+    for (const auto& it : measuredLinkDelays)
+        if (simTime() - it.second.lastSample <= linkDelayMaxAge)
+            feedback.push_back({ it.first, &it.second });
+    beacon->setLinkDelaySendersArraySize(feedback.size());
+    beacon->setLinkDelayMeansArraySize(feedback.size());
+    beacon->setLinkDelayVariancesArraySize(feedback.size());
+    for (size_t i = 0; i < feedback.size(); i++) {
+        beacon->setLinkDelaySenders(i, feedback[i].first);
+        beacon->setLinkDelayMeans(i, feedback[i].second->mean);
+        beacon->setLinkDelayVariances(i, feedback[i].second->variance);
+    }
+}
+
+void QueueGpsr::measureLinkDelay(const GpsrOption *gpsrOption)
+{
+    const L3Address& sender = gpsrOption->getSenderAddress();
+    if (gpsrOption->getHopSendTime() < 0 || sender.isUnspecified() || sender == getSelfAddress())
+        return;
+    simtime_t delay = simTime() - gpsrOption->getHopSendTime();
+    double sample = delay.dbl();
+    emit(linkDelaySignal, delay);
+    linkDelaySamples++;
+    auto it = measuredLinkDelays.find(sender);
+    if (it == measuredLinkDelays.end()) {
+        measuredLinkDelays[sender] = LinkDelayMeasurement { sample, 0, simTime() };
+        return;
+    }
+    // exponentially weighted mean and variance
+    LinkDelayMeasurement& measurement = it->second;
+    double difference = sample - measurement.mean;
+    double increment = linkDelaySmoothing * difference;
+    measurement.mean += increment;
+    measurement.variance = (1 - linkDelaySmoothing) * (measurement.variance + difference * increment);
+    measurement.lastSample = simTime();
+    EV_DETAIL << "Link delay from " << sender << ": sample=" << sample << "s, mean=" << measurement.mean
+              << "s, stddev=" << std::sqrt(measurement.variance) << "s" << endl;
+}
+
+//
+// oracle neighbor discovery
+//
+
+void QueueGpsr::processOracleDiscovery()
+{
+    HandlerProfiler::Scope profileScope(profiler, PROFILE_ORACLE_DISCOVERY);
+    // Publish our own state as our beacon would carry it, then take everything a beacon
+    // from the nodes in range would have delivered, without simulating the airtime
+    const L3Address selfAddress = getSelfAddress();
+    Coord selfPosition = mobility->getCurrentPosition();
+    const auto& beacon = createBeacon();
+    beacon->markImmutable();
+    oracleIndex.update(selfAddress, selfPosition, OracleNodeState { beacon, simTime() });
+    std::set<L3Address> inRange;
+    oracleIndex.forEachWithinRange(selfPosition, oracleDiscoveryRange, [&] (const L3Address& address, const Coord& position, const OracleNodeState& node) {
+        if (address != selfAddress) {
+            storeNeighborState(*node.state, node.publishTime);
+            inRange.insert(address);
+        }
+    });
+    // the index is exact: nodes out of range are gone now rather than after neighborValidityInterval,
+    // together with the beacon state stored for them
+    for (const auto& address : neighborStateService->getNeighborAddresses())
+        if (inRange.find(address) == inRange.end())
+            neighborStateService->removeNeighbor(address);
+    oracleDiscoveryTicks++;
+    EV_DEBUG << "Oracle discovery: " << inRange.size() << " neighbors within " << oracleDiscoveryRange << " m" << endl;
+}
+
 //
 // handling packets
 //
@@ -654,12 +984,27 @@ void QueueGpsr::processBeacon(Packet *packet)
 GpsrOption *QueueGpsr::createGpsrOption(L3Address destination)
 {
     GpsrOption *gpsrOption = new GpsrOption();
-    gpsrOption->setRoutingMode(GPSR_GREEDY_ROUTING);
-    gpsrOption->setDestinationPosition(lookupPositionInGlobalRegistry(destination));
+    gpsrOption->setRoutingMode(forwardingMode);
+    gpsrOption->setSourcePosition(mobility->getCurrentPosition());
+    gpsrOption->setClassStartTime(simTime());
+    setDestinationLocation(gpsrOption, destination);
     gpsrOption->setLength(computeOptionLength(gpsrOption));
     return gpsrOption;
 }
 
+void QueueGpsr::setDestinationLocation(GpsrOption *gpsrOption, const L3Address& destination) const
+{
+    Coord position = lookupPositionInGlobalRegistry(destination);
+    gpsrOption->setDestinationPosition(position);
+    auto motionIt = getLocationMotion().find(destination);
+    if (!position.isUnspecified() && motionIt != getLocationMotion().end()) {
+        // the fix is advanced to the forwarding time at every hop (updateDestinationPosition)
+        gpsrOption->setDestinationVelocity(motionIt->second.velocity);
+        gpsrOption->setDestinationPositionTime(motionIt->second.lastUpdate);
+        gpsrOption->setDestinationFixTime(motionIt->second.lastUpdate);
+    }
+}
+
 int QueueGpsr::computeOptionLength(GpsrOption *option)
 {
     // routingMode
@@ -668,10 +1013,22 @@ int QueueGpsr::computeOptionLength(GpsrOption *option)
     int positionsBytes = 3 * positionByteLength;
     // currentFaceFirstSenderAddress, currentFaceFirstReceiverAddress, senderAddress
     int addressesBytes = 3 * getSelfAddress().getAddressType()->getAddressByteLength();
+    // hopSendTime
+    int timestampBytes = enableLinkDelayMeasurement ? sizeof(int64_t) : 0;
+    // destinationVelocity, destinationPositionTime, destinationFixTime
+    int extrapolationBytes = enablePositionExtrapolation ? positionByteLength + 2 * sizeof(int64_t) : 0;
+    // perimeterStartTime, perimeterHopCount; recoveryRadius and recoveryReverse/BoundaryHits/Plane packed into one byte
+    int recoveryBytes = sizeof(int64_t) + 1 + (recoveryStrategy != RECOVERY_FACE ? sizeof(float) + 1 : 0);
+    // sourcePosition, hopCount, pathLength, flowSequenceNumber
+    int pathBytes = positionByteLength + 1 + sizeof(float) + sizeof(uint32_t);
+    // classStartTime
+    int classBytes = enableTrafficClasses ? sizeof(int64_t) : 0;
+    // taskDelayEstimate
+    int offloadBytes = enableOffloadDecisions ? sizeof(float) : 0;
     // type and length
     int tlBytes = 1 + 1;
 
-    return tlBytes + routingModeBytes + positionsBytes + addressesBytes;
+    return tlBytes + routingModeBytes + positionsBytes + addressesBytes + timestampBytes + extrapolationBytes + recoveryBytes + pathBytes + classBytes + offloadBytes;
 }
 
 //
@@ -696,47 +1053,339 @@ void QueueGpsr::configureInterfaces()
 // KLUDGE implement position registry protocol
 Coord QueueGpsr::lookupPositionInGlobalRegistry(const L3Address& address) const
 {
+    if (useHomeRegionLocationService) {
+        // the local table is a cache of beaconed and looked-up positions, used until the fix gets too old
+        auto it = localLocationMotion.find(address);
+        if (it == localLocationMotion.end() || simTime() - it->second.lastUpdate > locationCacheTimeout)
+            return Coord::NIL;
+    }
     // KLUDGE implement position registry protocol
-    return globalPositionTable.getPosition(address);
+    return getLocationTable().getPosition(address);
 }
 
-void QueueGpsr::storePositionInGlobalRegistry(const L3Address& address, const Coord& position) const
+void QueueGpsr::storePositionInGlobalRegistry(const L3Address& address, const Coord& position, const Coord& velocity) const
 {
     // KLUDGE implement position registry protocol
-    globalPositionTable.setPosition(address, position);
+    getLocationTable().setPosition(address, position);
+    getLocationMotion()[address] = { velocity, simTime() };
+}
+
+PositionTable& QueueGpsr::getLocationTable() const
+{
+    // The simulation-wide registry couples all nodes through shared memory, which
+    // rules out partitioning the network; the local table only holds what this node
+    // learned from received beacons.
+    return useGlobalLocationService ? globalPositionTable : localPositionTable;
+}
+
+std::map<L3Address, QueueGpsr::MotionInfo>& QueueGpsr::getLocationMotion() const
+{
+    return useGlobalLocationService ? globalLocationMotion : localLocationMotion;
 }
 
 void QueueGpsr::storeSelfPositionInGlobalRegistry() const
 {
     auto selfAddress = getSelfAddress();
     if (!selfAddress.isUnspecified())
-        storePositionInGlobalRegistry(selfAddress, mobility->getCurrentPosition());
+        storePositionInGlobalRegistry(selfAddress, mobility->getCurrentPosition(), mobility->getCurrentVelocity());
 }
 
-Coord QueueGpsr::computeIntersectionInsideLineSegments(Coord& begin1, Coord& end1, Coord& begin2, Coord& end2) const
+//
+// home-region location service
+//
+
+int QueueGpsr::getHomeRegionIndex(const L3Address& address) const
 {
-    // NOTE: we must explicitly avoid computing the intersection points inside due to double instability
-    if (begin1 == begin2 || begin1 == end2 || end1 == begin2 || end1 == end2)
-        return Coord::NIL;
-    else {
-        double x1 = begin1.x;
-        double y1 = begin1.y;
-        double x2 = end1.x;
-        double y2 = end1.y;
-        double x3 = begin2.x;
-        double y3 = begin2.y;
-        double x4 = end2.x;
-        double y4 = end2.y;
-        double a = determinant(x1, y1, x2, y2);
-        double b = determinant(x3, y3, x4, y4);
-        double c = determinant(x1 - x2, y1 - y2, x3 - x4, y3 - y4);
-        double x = determinant(a, x1 - x2, b, x3 - x4) / c;
-        double y = determinant(a, y1 - y2, b, y3 - y4) / c;
-        if ((x <= x1 && x <= x2) || (x >= x1 && x >= x2) || (x <= x3 && x <= x4) || (x >= x3 && x >= x4) ||
-            (y <= y1 && y <= y2) || (y >= y1 && y >= y2) || (y <= y3 && y <= y4) || (y >= y3 && y >= y4))
-            return Coord::NIL;
+    // FNV-1a over the textual address: the same region in every run and on every node
+    uint32_t hash = 2166136261u;
+    for (char c : address.str()) {
+        hash ^= (uint8_t)c;
+        hash *= 16777619u;
+    }
+    return hash % (uint32_t)(numHomeRegionColumns * numHomeRegionRows);
+}
+
+Coord QueueGpsr::getHomeRegionCenter(int index) const
+{
+    return Coord((index % numHomeRegionColumns + 0.5) * homeRegionSize, (index / numHomeRegionColumns + 0.5) * homeRegionSize, 0);
+}
+
+bool QueueGpsr::isInHomeRegion(const Coord& position, const Coord& center) const
+{
+    return std::abs(position.x - center.x) <= homeRegionSize / 2 && std::abs(position.y - center.y) <= homeRegionSize / 2;
+}
+
+L3Address QueueGpsr::findLocationNextHop(const Coord& targetPosition) const
+{
+    // plain greedy forwarding; the node without a closer neighbor is the end of the route
+    double bestDistance = mobility->getCurrentPosition().distance(targetPosition);
+    L3Address bestNeighbor;
+    for (const auto& address : getCandidateNeighborAddresses(false)) {
+        double distance = getNeighborPosition(address).distance(targetPosition);
+        if (distance < bestDistance) {
+            bestDistance = distance;
+            bestNeighbor = address;
+        }
+    }
+    return bestNeighbor;
+}
+
+B QueueGpsr::computeLocationMessageLength(const LocationMessage *message) const
+{
+    int addressBytes = getSelfAddress().getAddressType()->getAddressByteLength();
+    // type, hopCount, queryId; source, destination; sourcePosition, targetPosition
+    int headerBytes = 1 + 1 + 4 + 2 * addressBytes + 2 * positionByteLength;
+    // subject, position, velocity (encoded like the position), fix time
+    int entryBytes = addressBytes + 2 * positionByteLength + 8;
+    return B(headerBytes + message->getSubjectsArraySize() * entryBytes);
+}
+
+void QueueGpsr::sendLocationMessage(const Ptr<LocationMessage>& message, const L3Address& nextHop)
+{
+    message->setChunkLength(computeLocationMessageLength(message.get()));
+    const char *name = message->getType() == LOCATION_UPDATE ? "GPSRLocationUpdate" : message->getType() == LOCATION_QUERY ? "GPSRLocationQuery" : "GPSRLocationReply";
+    Packet *udpPacket = new Packet(name);
+    udpPacket->insertAtBack(message);
+    auto udpHeader = makeShared<UdpHeader>();
+    udpHeader->setSourcePort(GPSR_UDP_PORT);
+    udpHeader->setDestinationPort(GPSR_UDP_PORT);
+    udpHeader->setCrcMode(CRC_DISABLED);
+    udpPacket->insertAtFront(udpHeader);
+    auto addresses = udpPacket->addTag<L3AddressReq>();
+    addresses->setSrcAddress(getSelfAddress());
+    addresses->setDestAddress(nextHop);
+    udpPacket->addTag<HopLimitReq>()->setHopLimit(1);
+    udpPacket->addTag<PacketProtocolTag>()->setProtocol(&Protocol::manet);
+    udpPacket->addTag<DispatchProtocolReq>()->setProtocol(addressType->getNetworkProtocol());
+    udpPacket->addTag<NextHopAddressReq>()->setNextHopAddress(nextHop);
+    auto networkInterface = CHK(interfaceTable->findInterfaceByName(outputInterface));
+    udpPacket->addTag<InterfaceReq>()->setInterfaceId(networkInterface->getInterfaceId());
+    udpPacket->addTag<UserPriorityReq>()->setUserPriority(7);
+    locationControlPacketsSent++;
+    locationControlBytesSent += udpPacket->getByteLength();
+    sendUdpPacket(udpPacket);
+}
+
+void QueueGpsr::forwardLocationMessage(const Ptr<const LocationMessage>& message, const L3Address& nextHop)
+{
+    // greedy forwarding on positions that changed since the last beacon can bounce a message between nodes
+    if (message->getHopCount() >= locationMaxHops) {
+        EV_WARN << "Location message exceeded " << locationMaxHops << " hops, dropping: type = " << message->getType() << ", source = " << message->getSource() << endl;
+        locationMessagesLost++;
+        return;
+    }
+    auto copy = staticPtrCast<LocationMessage>(message->dupShared());
+    copy->setHopCount(message->getHopCount() + 1);
+    sendLocationMessage(copy, nextHop);
+}
+
+void QueueGpsr::sendLocationUpdateIfDue()
+{
+    Coord position = mobility->getCurrentPosition();
+    if (lastLocationUpdateTime >= 0 && simTime() - lastLocationUpdateTime < locationUpdateInterval &&
+        position.distance(lastLocationUpdatePosition) < locationUpdateDistance)
+        return;
+    const L3Address selfAddress = getSelfAddress();
+    const auto& update = makeShared<LocationMessage>();
+    update->setType(LOCATION_UPDATE);
+    update->setSource(selfAddress);
+    update->setSourcePosition(position);
+    update->setTargetPosition(getHomeRegionCenter(getHomeRegionIndex(selfAddress)));
+    update->appendSubjects(selfAddress);
+    update->appendPositions(position);
+    update->appendVelocities(mobility->getCurrentVelocity());
+    update->appendFixTimes(simTime());
+    lastLocationUpdateTime = simTime();
+    lastLocationUpdatePosition = position;
+    locationUpdatesSent++;
+    EV_DETAIL << "Sending location update towards home region at " << update->getTargetPosition() << endl;
+    handleLocationMessage(update);
+}
+
+INetfilter::IHook::Result QueueGpsr::lookupDestinationLocation(Packet *datagram, const L3Address& destination)
+{
+    PendingLocationLookup& lookup = pendingLocationLookups[destination];
+    if (lookup.datagrams.empty()) {
+        lookup.requestTime = simTime();
+        locationLookups++;
+        simtime_t flushTime = simTime() + locationQueryBatchDelay;
+        if (!locationQueryTimer->isScheduled() || locationQueryTimer->getArrivalTime() > flushTime)
+            rescheduleAt(flushTime, locationQueryTimer);
+    }
+    EV_INFO << "Destination position unknown, waiting for location lookup: destination = " << destination << endl;
+    lookup.datagrams.push_back(datagram);
+    return QUEUE;
+}
+
+void QueueGpsr::processLocationQueryTimer()
+{
+    simtime_t nextEvent = SimTime::getMaxTime();
+    std::map<int, Ptr<LocationMessage>> queries;  // home region -> batch
+    for (auto it = pendingLocationLookups.begin(); it != pendingLocationLookups.end();) {
+        PendingLocationLookup& lookup = it->second;
+        if (lookup.queryId == 0) {
+            simtime_t flushTime = lookup.requestTime + locationQueryBatchDelay;
+            if (flushTime <= simTime()) {
+                int region = getHomeRegionIndex(it->first);
+                auto& query = queries[region];
+                if (query == nullptr) {
+                    query = makeShared<LocationMessage>();
+                    query->setType(LOCATION_QUERY);
+                    query->setSource(getSelfAddress());
+                    query->setSourcePosition(mobility->getCurrentPosition());
+                    query->setTargetPosition(getHomeRegionCenter(region));
+                    query->setQueryId(++nextLocationQueryId);
+                }
+                query->appendSubjects(it->first);
+                lookup.queryId = query->getQueryId();
+                lookup.querySendTime = simTime();
+                nextEvent = std::min(nextEvent, simTime() + locationQueryTimeout);
+            }
+            else
+                nextEvent = std::min(nextEvent, flushTime);
+            ++it;
+        }
+        else if (lookup.querySendTime + locationQueryTimeout <= simTime()) {
+            EV_WARN << "Location lookup timed out, dropping " << lookup.datagrams.size() << " packets: destination = " << it->first << endl;
+            for (Packet *datagram : lookup.datagrams)
+                networkProtocol->dropQueuedDatagram(datagram);
+            locationLookupsFailed++;
+            it = pendingLocationLookups.erase(it);
+        }
+        else {
+            nextEvent = std::min(nextEvent, lookup.querySendTime + locationQueryTimeout);
+            ++it;
+        }
+    }
+    if (nextEvent != SimTime::getMaxTime())
+        scheduleAt(nextEvent, locationQueryTimer);
+    // sent after the loop: a query answered locally resolves lookups right away
+    for (auto& entry : queries) {
+        locationQueriesSent++;
+        locationQuerySubjects += entry.second->getSubjectsArraySize();
+        EV_DETAIL << "Sending location query for " << entry.second->getSubjectsArraySize() << " destinations towards home region at " << entry.second->getTargetPosition() << endl;
+        handleLocationMessage(entry.second);
+    }
+}
+
+void QueueGpsr::processLocationMessage(Packet *packet)
+{
+    const auto& message = packet->peekAtFront<LocationMessage>();
+    EV_INFO << "Processing location message: type = " << message->getType() << ", source = " << message->getSource() << ", hops = " << message->getHopCount() << endl;
+    handleLocationMessage(message);
+    delete packet;
+}
+
+void QueueGpsr::handleLocationMessage(const Ptr<const LocationMessage>& message)
+{
+    switch (message->getType()) {
+        case LOCATION_UPDATE: processLocationUpdate(message); break;
+        case LOCATION_QUERY: processLocationQuery(message); break;
+        case LOCATION_REPLY: processLocationReply(message); break;
+        default: throw cRuntimeError("Unknown location message type: %d", (int)message->getType());
+    }
+}
+
+void QueueGpsr::processLocationUpdate(const Ptr<const LocationMessage>& message)
+{
+    // Region members on the way store the position; the update continues to the node closest to
+    // the region center, which queries entering the region from any side eventually reach
+    L3Address nextHop = findLocationNextHop(message->getTargetPosition());
+    if (nextHop.isUnspecified() || isInHomeRegion(mobility->getCurrentPosition(), message->getTargetPosition())) {
+        for (size_t i = 0; i < message->getSubjectsArraySize(); i++) {
+            LocationRecord& record = homeRegionRegistry[message->getSubjects(i)];
+            if (record.fixTime <= message->getFixTimes(i))
+                record = { message->getPositions(i), message->getVelocities(i), message->getFixTimes(i) };
+        }
+    }
+    if (!nextHop.isUnspecified())
+        forwardLocationMessage(message, nextHop);
+}
+
+void QueueGpsr::processLocationQuery(const Ptr<const LocationMessage>& message)
+{
+    L3Address nextHop = findLocationNextHop(message->getTargetPosition());
+    const auto& reply = makeShared<LocationMessage>();
+    reply->setType(LOCATION_REPLY);
+    reply->setSource(getSelfAddress());
+    reply->setDestination(message->getSource());
+    reply->setSourcePosition(mobility->getCurrentPosition());
+    reply->setTargetPosition(message->getSourcePosition());
+    reply->setQueryId(message->getQueryId());
+    Ptr<LocationMessage> remaining;
+    for (size_t i = 0; i < message->getSubjectsArraySize(); i++) {
+        const L3Address& subject = message->getSubjects(i);
+        auto it = homeRegionRegistry.find(subject);
+        bool known = it != homeRegionRegistry.end() && simTime() - it->second.fixTime <= locationRegistryTimeout;
+        if (known || nextHop.isUnspecified()) {
+            // the end of the route answers unknown subjects negatively so that the querier gives up early
+            reply->appendSubjects(subject);
+            reply->appendPositions(known ? it->second.position : Coord::NIL);
+            reply->appendVelocities(known ? it->second.velocity : Coord::ZERO);
+            reply->appendFixTimes(known ? it->second.fixTime : SIMTIME_ZERO);
+        }
+        else {
+            if (remaining == nullptr) {
+                remaining = staticPtrCast<LocationMessage>(message->dupShared());
+                remaining->setSubjectsArraySize(0);
+            }
+            remaining->appendSubjects(subject);
+        }
+    }
+    if (reply->getSubjectsArraySize() > 0) {
+        locationRepliesSent++;
+        handleLocationMessage(reply);
+    }
+    if (remaining != nullptr)
+        forwardLocationMessage(remaining, nextHop);
+}
+
+void QueueGpsr::processLocationReply(const Ptr<const LocationMessage>& message)
+{
+    if (message->getDestination() != getSelfAddress()) {
+        const L3Address& querier = message->getDestination();
+        L3Address nextHop = neighborStateService->hasNeighbor(querier) ? querier : findLocationNextHop(message->getTargetPosition());
+        if (nextHop.isUnspecified()) {
+            EV_WARN << "No next hop towards querier, dropping location reply: querier = " << querier << endl;
+            locationMessagesLost++;
+        }
         else
-            return Coord(x, y, 0);
+            forwardLocationMessage(message, nextHop);
+        return;
+    }
+    for (size_t i = 0; i < message->getSubjectsArraySize(); i++) {
+        const L3Address& subject = message->getSubjects(i);
+        const Coord& position = message->getPositions(i);
+        auto motionIt = getLocationMotion().find(subject);
+        if (!position.isUnspecified() && (motionIt == getLocationMotion().end() || motionIt->second.lastUpdate <= message->getFixTimes(i))) {
+            getLocationTable().setPosition(subject, position);
+            getLocationMotion()[subject] = { message->getVelocities(i), message->getFixTimes(i) };
+        }
+        auto it = pendingLocationLookups.find(subject);
+        if (it == pendingLocationLookups.end() || it->second.queryId != message->getQueryId())
+            continue;
+        std::vector<Packet *> datagrams = it->second.datagrams;
+        simtime_t requestTime = it->second.requestTime;
+        pendingLocationLookups.erase(it);
+        if (position.isUnspecified()) {
+            EV_WARN << "Destination unknown to its home region, dropping " << datagrams.size() << " packets: destination = " << subject << endl;
+            for (Packet *datagram : datagrams)
+                networkProtocol->dropQueuedDatagram(datagram);
+            locationLookupsFailed++;
+            continue;
+        }
+        EV_INFO << "Destination located: destination = " << subject << ", position = " << position << ", latency = " << simTime() - requestTime << " s" << endl;
+        locationLookupsResolved++;
+        emit(locationLookupLatencySignal, simTime() - requestTime);
+        for (Packet *datagram : datagrams) {
+            // KLUDGE this allows overwriting the GPSR option inside
+            auto gpsrOption = const_cast<GpsrOption *>(getGpsrOptionFromNetworkDatagram(getNetworkProtocolHeader(datagram)));
+            gpsrOption->setDestinationPosition(position);
+            gpsrOption->setDestinationVelocity(message->getVelocities(i));
+            gpsrOption->setDestinationPositionTime(message->getFixTimes(i));
+            gpsrOption->setDestinationFixTime(message->getFixTimes(i));
+            resumeQueuedDatagram(datagram);
+        }
     }
 }
 
@@ -790,8 +1439,25 @@ void QueueGpsr::auditMacQueues() const
 }
 
 
+SojournFairQueue *QueueGpsr::findSojournQueue() const
+{
+    // the queue may sit anywhere in the MAC tree, like the queues found by getLocalTxBacklogBytes()
+    cModule *wlanModule = host->getSubmodule("wlan", 0);
+    cModule *macModule = wlanModule != nullptr ? wlanModule->getSubmodule("mac") : nullptr;
+    std::function<SojournFairQueue *(cModule *)> find = [&] (cModule *module) -> SojournFairQueue * {
+        if (auto queue = dynamic_cast<SojournFairQueue *>(module))
+            return queue;
+        for (cModule::SubmoduleIterator it(module); !it.end(); ++it)
+            if (auto queue = find(*it))
+                return queue;
+        return nullptr;
+    };
+    return macModule != nullptr ? find(macModule) : nullptr;
+}
+
 unsigned long QueueGpsr::getLocalTxBacklogBytes() const
 {
+    HandlerProfiler::Scope profileScope(profiler, PROFILE_LOCAL_TX_BACKLOG);
     // Read actual MAC TX queue backlog (all sub-queues)
     // Path: wlan[0].mac.tx.queue (PriorityQueue with multiple sub-queues)
     
@@ -876,27 +1542,76 @@ unsigned long QueueGpsr::getLocalTxBacklogBytes() const
     }
 }
 
-Coord QueueGpsr::getNeighborPosition(const L3Address& address) const
+double QueueGpsr::getLocalTxBitrate() const
 {
-    return neighborPositionTable.getPosition(address);
+    // Own transmitter bitrate (wlan[0].radio.transmitter.bitrate), advertised in beacons
+    cModule *wlan = host->getSubmodule("wlan", 0);
+    cModule *radio = wlan ? wlan->getSubmodule("radio") : nullptr;
+    cModule *transmitter = radio ? radio->getSubmodule("transmitter") : nullptr;
+    if (transmitter && transmitter->hasPar("bitrate")) {
+        double bitrate = transmitter->par("bitrate").doubleValue();
+        if (bitrate > 0.0)  // unspecified/auto bitrate is advertised as unknown
+            return bitrate;
+    }
+    return 0.0;
 }
 
-//
-// angle
-//
+double QueueGpsr::getLocalQueueDelay() const
+{
+    // Own MAC queue as the neighbors see it in our beacons: sojourn time, otherwise backlog / bitrate
+    if (sojournQueue != nullptr)
+        return sojournQueue->getSojournTime().dbl();
+    double bitrate = getLocalTxBitrate();
+    return bitrate > 0 ? getLocalTxBacklogBytes() * 8.0 / bitrate : 0;
+}
+
+Coord QueueGpsr::getNeighborPosition(const L3Address& address) const
+{
+    const NeighborStateService::NeighborState *state = neighborStateService->findNeighbor(address);
+    if (state == nullptr)
+        return Coord::NIL;
+    // Linear dead reckoning from the last known position; the horizon is capped because
+    // old velocity information says little about where a node has turned since
+    if (!enablePositionExtrapolation || state->position.isUnspecified())
+        return state->position;
+    return neighborStateService->getExtrapolatedPosition(address, std::min(simTime(), state->lastUpdate + maxExtrapolationTime));
+}
 
-double QueueGpsr::getVectorAngle(Coord vector) const
+void QueueGpsr::updateDestinationPosition(const L3Address& destination, GpsrOption *gpsrOption) const
 {
-    ASSERT(vector != Coord::ZERO);
-    double angle = atan2(-vector.y, vector.x);
-    if (angle < 0)
-        angle += 2 * M_PI;
-    return angle;
+    if (!enablePositionExtrapolation || gpsrOption->getDestinationPosition().isUnspecified())
+        return;
+    // A destination in radio range advertises fresher position information than the packet carries
+    const NeighborStateService::NeighborState *state = neighborStateService->findNeighbor(destination);
+    if (state != nullptr && state->lastUpdate > gpsrOption->getDestinationFixTime()) {
+        gpsrOption->setDestinationPosition(state->position);
+        gpsrOption->setDestinationVelocity(state->velocity);
+        gpsrOption->setDestinationPositionTime(state->lastUpdate);
+        gpsrOption->setDestinationFixTime(state->lastUpdate);
+    }
+    // Advance the carried position to now; the total horizon since the fix is bounded by maxExtrapolationTime
+    simtime_t horizonEnd = std::min(simTime(), gpsrOption->getDestinationFixTime() + maxExtrapolationTime);
+    simtime_t step = horizonEnd - gpsrOption->getDestinationPositionTime();
+    if (step > 0) {
+        gpsrOption->setDestinationPosition(gpsrOption->getDestinationPosition() + gpsrOption->getDestinationVelocity() * step.dbl());
+        gpsrOption->setDestinationPositionTime(horizonEnd);
+    }
 }
 
-double QueueGpsr::getNeighborAngle(const L3Address& address) const
+std::vector<L3Address> QueueGpsr::getCandidateNeighborAddresses(bool countDrops) const
 {
-    return getVectorAngle(getNeighborPosition(address) - mobility->getCurrentPosition());
+    std::vector<L3Address> addresses = neighborStateService->getFreshNeighborAddresses(neighborValidityInterval);
+    if (maxNeighborRange < 0)
+        return addresses;
+    // A neighbor predicted to have left radio range would only cost failed transmissions
+    Coord selfPosition = mobility->getCurrentPosition();
+    auto end = std::remove_if(addresses.begin(), addresses.end(), [&] (const L3Address& address) {
+        return getNeighborPosition(address).distance(selfPosition) > maxNeighborRange;
+    });
+    if (countDrops)
+        predictedOutOfRangeCandidates += addresses.end() - end;
+    addresses.erase(end, addresses.end());
+    return addresses;
 }
 
 //
@@ -940,16 +1655,75 @@ L3Address QueueGpsr::getSenderNeighborAddress(const Ptr<const NetworkHeaderBase>
 
 simtime_t QueueGpsr::getNextNeighborExpiration()
 {
-    simtime_t oldestPosition = neighborPositionTable.getOldestPosition();
-    if (oldestPosition == SimTime::getMaxTime())
-        return oldestPosition;
+    simtime_t oldestUpdate = neighborStateService->getOldestUpdate();
+    if (oldestUpdate == SimTime::getMaxTime())
+        return oldestUpdate;
     else
-        return oldestPosition + neighborValidityInterval;
+        return oldestUpdate + neighborValidityInterval;
 }
 
 void QueueGpsr::purgeNeighbors()
 {
-    neighborPositionTable.removeOldPositions(simTime() - neighborValidityInterval);
+    neighborStateService->removeOldNeighbors(simTime() - neighborValidityInterval);
+}
+
+//
+// routing core adapters
+//
+
+gpsrcore::Params QueueGpsr::getCoreParams() const
+{
+    gpsrcore::Params params;
+    switch (planarizationMode) {
+        case GPSR_NO_PLANARIZATION: params.planarization = gpsrcore::Planarization::NONE; break;
+        case GPSR_GG_PLANARIZATION: params.planarization = gpsrcore::Planarization::GG; break;
+        case GPSR_RNG_PLANARIZATION: params.planarization = gpsrcore::Planarization::RNG; break;
+        default: throw cRuntimeError("Unknown planarization mode");
+    }
+    params.enableDelayTiebreaker = enableDelayTiebreaker;
+    params.enableQueueDelay = enableQueueDelay;
+    params.distanceEqualityThreshold = distanceEqualityThreshold;
+    params.delayEstimationFactor = delayEstimationFactor;
+    params.maxInfoAge = (beaconInterval * 3).dbl();
+    params.taskCyclesPerBit = taskCyclesPerBit;
+    params.offloadPipelineDelay = enableOffloadPipelineEstimate;
+    params.reductionFactor = reductionFactor;
+    params.measuredLinkDelay = enableLinkDelayMeasurement;
+    params.linkDelayDeviationWeight = linkDelayDeviationWeight;
+    // modeled links are charged our own queue too, which every measured link delay includes
+    if (enableLinkDelayMeasurement)
+        params.localQueueDelay = getLocalQueueDelay();
+    return params;
+}
+
+gpsrcore::Neighbor QueueGpsr::getCoreNeighbor(const L3Address& address) const
+{
+    gpsrcore::Neighbor neighbor;
+    neighbor.id = getCoreNodeId(address);
+    neighbor.position = toVec3(getNeighborPosition(address));
+    if (const NeighborStateService::NeighborState *state = neighborStateService->findNeighbor(address)) {
+        // queue and CPU state come with the same beacon
+        double age = (simTime() - state->lastUpdate).dbl();
+        neighbor.backlogBytes = state->backlogBytes;
+        neighbor.sojournTime = state->sojournTime;
+        neighbor.linkDelayMean = state->linkDelayMean;
+        neighbor.linkDelayVariance = state->linkDelayVariance;
+        neighbor.txBitrate = state->txBitrate;
+        neighbor.queueInfoAge = age;
+        neighbor.cpuOffloadHz = state->cpuOffloadHz;
+        neighbor.cpuOffloadBacklogCycles = state->cpuOffloadBacklogCycles;
+        neighbor.cpuInfoAge = age;
+    }
+    return neighbor;
+}
+
+std::vector<gpsrcore::Neighbor> QueueGpsr::getCoreNeighbors(const std::vector<L3Address>& addresses) const
+{
+    std::vector<gpsrcore::Neighbor> neighbors;
+    neighbors.reserve(addresses.size());
+    for (const auto& address : addresses)
+        neighbors.push_back(getCoreNeighbor(address));
+    return neighbors;
 }
 
 double QueueGpsr::estimateNeighborDelay(const L3Address& address) const
@@ -958,114 +1732,48 @@ double QueueGpsr::estimateNeighborDelay(const L3Address& address) const
     EV_INFO << "📊 estimateNeighborDelay() called for " << address 
             << " | enableQueueDelay=" << enableQueueDelay << endl;
     
-    Coord selfPosition = mobility->getCurrentPosition();
-    Coord neighborPosition = neighborPositionTable.getPosition(address);
-    double distance = (neighborPosition - selfPosition).length();
-    
-    double delay = distance * delayEstimationFactor;
-    if (enableQueueDelay) {
-        EV_INFO << "   enableQueueDelay is TRUE, checking neighbor backlog map..." << endl;
+    gpsrcore::Params params = getCoreParams();
+    gpsrcore::Neighbor neighbor = getCoreNeighbor(address);
+    double delay = gpsrcore::estimateNeighborDelay(params, toVec3(mobility->getCurrentPosition()), neighbor);
+    if (enableQueueDelay && neighbor.queueInfoAge >= 0) {
+        EV_INFO << "   ✅ Found neighbor in backlog map, bytes=" << neighbor.backlogBytes << endl;
         
-        // add queueing delay term based on neighbor backlog (if known and fresh)
-        auto it = neighborTxBacklogBytes.find(address);
-        if (it != neighborTxBacklogBytes.end()) {
-            EV_INFO << "   ✅ Found neighbor in backlog map, bytes=" << it->second.bytes << endl;
-            
-            const NeighborQueueInfo& info = it->second;
-            
-            // AGING CHECK: Discard stale queue info (older than 1.5× beacon interval)
-            simtime_t age = simTime() - info.lastUpdate;
-            simtime_t maxAge = beaconInterval * 3;
-            
-            // Log age check for ALL routing decisions to track freshness
-            std::cout << "[AGE-CHECK] t=" << simTime() << " " << getContainingNode(this)->getFullName()
-                     << ": neighbor=" << address << " age=" << age << "s maxAge=" << maxAge << "s"
-                     << " Q=" << info.bytes << " bytes"
-                     << (age > maxAge ? " ⚠️ STALE" : " ✓ FRESH") << std::endl;
-            
-            // DIAGNOSTIC: Additional detail for source node during validation window
-            bool isSourceNode = (strcmp(getContainingNode(this)->getFullName(), "host[0]") == 0);
-            if (isSourceNode && simTime() >= 9.0 && simTime() <= 15.0) {
-                std::cout << "    🕒 Age check for " << address << ": age=" << age 
-                          << "s, maxAge=" << maxAge << "s";
-                if (age > maxAge) {
-                    std::cout << " ⚠️  STALE (age > maxAge, will use distance-only)" << std::endl;
-                } else {
-                    std::cout << " ✓ FRESH (age <= maxAge, will use Q/R)" << std::endl;
-                }
-            }
-            
+        // AGING CHECK: the core ignores queue info older than maxInfoAge (3× beacon interval)
+        simtime_t age = neighbor.queueInfoAge;
+        simtime_t maxAge = params.maxInfoAge;
+        
+        // Log age check for ALL routing decisions to track freshness
+        std::cout << "[AGE-CHECK] t=" << simTime() << " " << getContainingNode(this)->getFullName()
+                 << ": neighbor=" << address << " age=" << age << "s maxAge=" << maxAge << "s"
+                 << " Q=" << neighbor.backlogBytes << " bytes"
+                 << (age > maxAge ? " ⚠️ STALE" : " ✓ FRESH") << std::endl;
+        
+        // DIAGNOSTIC: Additional detail for source node during validation window
+        bool isSourceNode = (strcmp(getContainingNode(this)->getFullName(), "host[0]") == 0);
+        if (isSourceNode && simTime() >= 9.0 && simTime() <= 15.0) {
+            std::cout << "    🕒 Age check for " << address << ": age=" << age 
+                      << "s, maxAge=" << maxAge << "s";
             if (age > maxAge) {
-                // Queue info is stale - ignore it
-                EV_DETAIL << "Ignoring stale queue info for neighbor " << address 
-                         << " (age=" << age << "s, maxAge=" << maxAge << "s)" << endl;
-                if (isSourceNode && simTime() >= 9.0 && simTime() <= 15.0) {
-                    std::cout << "    ⏭️  Skipping Q/R for " << address 
-                              << " (stale beacon from t=" << info.lastUpdate << "s)" << std::endl;
-                }
-                return delay; // return distance-only delay
-            }
-            
-            double backlogBytes = (double) info.bytes;
-            
-            // Read neighbor's transmitter bitrate dynamically (INET 4.5.x canonical path)
-            double bitrate = 0.0; // in bps
-            
-            // Resolve neighbor host module from L3 address
-            L3AddressResolver resolver;
-            cModule *neighborHost = resolver.findHostWithAddress(address);
-            
-            std::cout << "    🔍 [estimateNeighborDelay] Resolving bitrate for " << address 
-                     << " | backlogBytes=" << backlogBytes << std::endl;
-            std::cout << "       neighborHost: " << (neighborHost ? neighborHost->getFullPath() : "nullptr") << std::endl;
-            
-            if (neighborHost) {
-                // Navigate to neighbor's wlan[0].radio.transmitter.bitrate
-                cModule *wlan = neighborHost->getSubmodule("wlan", 0);
-                std::cout << "       wlan[0]: " << (wlan ? wlan->getFullPath() : "nullptr") << std::endl;
-                
-                if (wlan) {
-                    cModule *radio = wlan->getSubmodule("radio");
-                    std::cout << "       radio: " << (radio ? radio->getFullPath() : "nullptr") << std::endl;
-                    
-                    if (radio) {
-                        cModule *transmitter = radio->getSubmodule("transmitter");
-                        std::cout << "       transmitter: " << (transmitter ? transmitter->getFullPath() : "nullptr") << std::endl;
-                        
-                        if (transmitter && transmitter->hasPar("bitrate")) {
-                            try {
-                                bitrate = transmitter->par("bitrate").doubleValue();
-                                std::cout << "       ✅ bitrate read: " << bitrate << " bps (" << (bitrate/1e6) << " Mbps)" << std::endl;
-                                
-                                // Guard against unspecified/auto bitrate (≤0)
-                                if (bitrate <= 0.0) {
-                                    std::cout << "       ⚠️  bitrate ≤0, treating as unknown" << std::endl;
-                                    bitrate = 0.0;
-                                }
-                            }
-                            catch (...) { 
-                                std::cout << "       ⚠️  Exception reading bitrate parameter" << std::endl;
-                                bitrate = 0.0; 
-                            }
-                        } else {
-                            std::cout << "       ⚠️  transmitter has no bitrate parameter" << std::endl;
-                        }
-                    }
-                }
-            } else {
-                std::cout << "       ⚠️  L3AddressResolver could not find host" << std::endl;
-            }
-            
-            if (bitrate > 0.0) {
-                double backlogBits = backlogBytes * 8.0;
-                double queueDelay = backlogBits / bitrate;
-                delay += queueDelay; // seconds
-                std::cout << "       ✅ Q/R calculated: " << backlogBytes << " bytes / " << (bitrate/1e6) 
-                         << " Mbps = " << queueDelay << "s | Total delay=" << delay << "s" << std::endl;
+                std::cout << " ⚠️  STALE (age > maxAge, will use distance-only)" << std::endl;
             } else {
-                std::cout << "       ⚠️  Could not read bitrate - using distance-only delay (" << delay << "s)" << std::endl;
+                std::cout << " ✓ FRESH (age <= maxAge, will use Q/R)" << std::endl;
             }
         }
+        
+        if (age > maxAge) {
+            EV_DETAIL << "Ignoring stale queue info for neighbor " << address 
+                     << " (age=" << age << "s, maxAge=" << maxAge << "s)" << endl;
+        }
+        else if (neighbor.sojournTime >= 0) {
+            std::cout << "       ✅ Sojourn time advertised: " << neighbor.sojournTime << "s | Total delay=" << delay << "s" << std::endl;
+        }
+        else if (neighbor.txBitrate > 0.0) {
+            std::cout << "       ✅ Q/R calculated: " << neighbor.backlogBytes << " bytes / " << (neighbor.txBitrate/1e6) 
+                     << " Mbps = " << neighbor.backlogBytes * 8.0 / neighbor.txBitrate << "s | Total delay=" << delay << "s" << std::endl;
+        }
+        else {
+            std::cout << "       ⚠️  Could not read bitrate - using distance-only delay (" << delay << "s)" << std::endl;
+        }
     }
 
     return delay;
@@ -1077,16 +1785,12 @@ double QueueGpsr::estimateNeighborDelay(const L3Address& address) const
 
 double QueueGpsr::estimateLocalProcessingTime(int taskBits) const
 {
-    if (cpuOffloadHz <= 0) {
+    if (cpuOffloadHz <= 0)
         EV_WARN << "cpuOffloadHz is zero or negative, cannot estimate local processing time" << endl;
-        return std::numeric_limits<double>::infinity();
-    }
-    
-    double totalCycles = taskBits * taskCyclesPerBit;
-    double processingTime = totalCycles / cpuOffloadHz;  // seconds
+    double processingTime = gpsrcore::estimateLocalProcessingTime(getCoreParams(), taskBits, cpuOffloadHz);
     
     EV_DETAIL << "Local processing estimate: " << taskBits << " bits × " << taskCyclesPerBit 
-              << " cycles/bit = " << totalCycles << " cycles / " << cpuOffloadHz 
+              << " cycles/bit = " << (taskBits * taskCyclesPerBit) << " cycles / " << cpuOffloadHz 
               << " Hz = " << processingTime << "s" << endl;
     
     return processingTime;
@@ -1094,43 +1798,16 @@ double QueueGpsr::estimateLocalProcessingTime(int taskBits) const
 
 double QueueGpsr::estimateRemoteProcessingTime(const L3Address& neighbor, int taskBits) const
 {
-    // Look up neighbor's CPU capacity
-    auto it = neighborCpuCapacity.find(neighbor);
-    if (it == neighborCpuCapacity.end()) {
+    gpsrcore::Neighbor coreNeighbor = getCoreNeighbor(neighbor);
+    double processingTime = gpsrcore::estimateRemoteProcessingTime(getCoreParams(), coreNeighbor, taskBits);
+    if (coreNeighbor.cpuInfoAge < 0)
         EV_WARN << "No CPU capacity info for neighbor " << neighbor << endl;
-        return std::numeric_limits<double>::infinity();
-    }
-    
-    const NeighborCpuInfo& cpuInfo = it->second;
-    
-    // Check freshness
-    simtime_t age = simTime() - cpuInfo.lastUpdate;
-    simtime_t maxAge = beaconInterval * 3;
-    if (age > maxAge) {
-        EV_DETAIL << "Stale CPU info for neighbor " << neighbor << " (age=" << age << "s)" << endl;
-        return std::numeric_limits<double>::infinity();
-    }
-    
-    if (cpuInfo.cpuOffloadHz <= 0) {
-        EV_WARN << "Neighbor " << neighbor << " has zero or negative cpuOffloadHz" << endl;
-        return std::numeric_limits<double>::infinity();
-    }
-    
-    double totalCycles = taskBits * taskCyclesPerBit;
-    double processingTime = totalCycles / cpuInfo.cpuOffloadHz;  // seconds
-    
-    // Optional: add CPU queueing delay if backlog is tracked
-    double cpuQueueDelay = 0.0;
-    if (cpuInfo.cpuOffloadBacklogCycles > 0) {
-        cpuQueueDelay = cpuInfo.cpuOffloadBacklogCycles / cpuInfo.cpuOffloadHz;
-    }
-    
-    EV_DETAIL << "Remote processing estimate for " << neighbor << ": " 
-              << taskBits << " bits × " << taskCyclesPerBit << " cycles/bit = " 
-              << totalCycles << " cycles / " << cpuInfo.cpuOffloadHz << " Hz = " 
-              << processingTime << "s (CPU queue: " << cpuQueueDelay << "s)" << endl;
-    
-    return processingTime + cpuQueueDelay;
+    else
+        EV_DETAIL << "Remote processing estimate for " << neighbor << ": " 
+                  << taskBits << " bits × " << taskCyclesPerBit << " cycles/bit / " << coreNeighbor.cpuOffloadHz
+                  << " Hz (CPU info age " << coreNeighbor.cpuInfoAge << "s, backlog "
+                  << coreNeighbor.cpuOffloadBacklogCycles << " cycles) = " << processingTime << "s" << endl;
+    return processingTime;
 }
 
 double QueueGpsr::estimateOffloadTotalDelay(const L3Address& neighbor, int taskBits) const
@@ -1150,7 +1827,7 @@ void QueueGpsr::logOffloadDecisionEstimates(const std::vector<L3Address>& candid
         return;  // don't log if offload decisions are disabled
     }
     
-    double localTime = estimateLocalProcessingTime(taskBits);
+    double localTime = estimateLocalTaskDelay(taskBits);
     
     std::cout << "━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━" << std::endl;
     std::cout << "🔍 OFFLOAD DECISION ESTIMATES [" << getHostName() << "] t=" << simTime() << "s" << std::endl;
@@ -1169,9 +1846,8 @@ void QueueGpsr::logOffloadDecisionEstimates(const std::vector<L3Address>& candid
         
         // Get CPU capacity for display
         double cpuGHz = 0.0;
-        auto it = neighborCpuCapacity.find(neighbor);
-        if (it != neighborCpuCapacity.end()) {
-            cpuGHz = it->second.cpuOffloadHz / 1e9;
+        if (const NeighborStateService::NeighborState *state = neighborStateService->findNeighbor(neighbor)) {
+            cpuGHz = state->cpuOffloadHz / 1e9;
         }
         
         std::cout << "   Neighbor " << neighbor << " (CPU: " << cpuGHz << " GHz):" << std::endl;
@@ -1198,60 +1874,437 @@ void QueueGpsr::logOffloadDecisionEstimates(const std::vector<L3Address>& candid
     std::cout << "━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━" << std::endl;
 }
 
-L3Address QueueGpsr::makeOffloadDecision(const std::vector<L3Address>& candidates, int taskBits, bool& shouldOffload)
+double QueueGpsr::estimateLocalTaskDelay(int taskBits) const
 {
-    double localTime = estimateLocalProcessingTime(taskBits);
-    L3Address bestNeighbor;
-    double bestOffloadTime = std::numeric_limits<double>::infinity();
-    
-    // Find best offload candidate
-    for (const auto& neighbor : candidates) {
-        double totalDelay = estimateOffloadTotalDelay(neighbor, taskBits);
-        if (totalDelay < bestOffloadTime) {
-            bestOffloadTime = totalDelay;
-            bestNeighbor = neighbor;
-        }
-    }
+    // Local processing also waits behind the work already queued on our own CPU
+    return gpsrcore::estimateLocalTaskDelay(getCoreParams(), taskBits, cpuOffloadHz, cpuOffloadBacklogCycles);
+}
+
+L3Address QueueGpsr::makeOffloadDecision(const std::vector<L3Address>& candidates, int taskBits, simtime_t deadline, const Coord& destinationPosition,
+                                         bool& shouldOffload, double& delayEstimate)
+{
+    double slack = deadline > 0 ? (deadline - simTime()).dbl() : std::numeric_limits<double>::infinity();
+    std::vector<gpsrcore::Neighbor> neighbors = getCoreNeighbors(candidates);
+    // an unknown destination position (location lookup still pending) leaves the delivery term out
+    gpsrcore::OffloadDecision decision = gpsrcore::makeOffloadDecision(getCoreParams(), toVec3(mobility->getCurrentPosition()), toVec3(destinationPosition),
+            neighbors, taskBits, cpuOffloadHz, cpuOffloadBacklogCycles, slack);
     
     // Decide: offload if best remote option is better than local
-    shouldOffload = (bestOffloadTime < localTime && !bestNeighbor.isUnspecified());
+    shouldOffload = decision.shouldOffload;
+    delayEstimate = shouldOffload ? decision.bestOffloadTime : decision.localTime;
     
-    EV_INFO << "Offload decision: localTime=" << localTime << "s, bestOffloadTime=" 
-            << bestOffloadTime << "s, shouldOffload=" << shouldOffload << endl;
+    EV_INFO << "Offload decision: localTime=" << decision.localTime << "s, bestOffloadTime=" 
+            << decision.bestOffloadTime << "s, slack=" << slack << "s, shouldOffload=" << shouldOffload << endl;
+    if (enableOffloadPipelineEstimate) {
+        const gpsrcore::PipelineDelay& pipeline = shouldOffload ? decision.bestOffloadPipeline : decision.localPipeline;
+        EV_INFO << "Pipeline estimate of the chosen option: transfer=" << pipeline.transfer << "s, processing="
+                << pipeline.processing << "s, delivery=" << pipeline.delivery << "s" << endl;
+    }
     
-    return bestNeighbor;
+    return decision.target == gpsrcore::NO_NEIGHBOR ? L3Address() : candidates[decision.target];
+}
+
+bool QueueGpsr::assignOffloadTarget(Packet *datagram, GpsrOption *gpsrOption)
+{
+    // Every locally originated data packet is a task whose payload is processed either here or at a neighbor;
+    // a task input spans taskChunks consecutive datagrams to the same destination and is decided once per task
+    const auto& networkHeader = getNetworkProtocolHeader(datagram);
+    int chunkBits = b(datagram->getDataLength() - networkHeader->getChunkLength()).get();
+    SourceTaskState& task = sourceTasks[networkHeader->getDestinationAddress()];
+    if (task.nextChunkIndex == 0) {
+        int taskBits = chunkBits * taskChunks;
+        task.taskId = ++nextTaskId;
+        task.creationTime = simTime();
+        task.deadline = taskDeadline > 0 ? simTime() + taskDeadline : SIMTIME_ZERO;
+        task.rejected = false;
+        
+        bool shouldOffload = false;
+        task.target = makeOffloadDecision(getCandidateNeighborAddresses(), taskBits, task.deadline, gpsrOption->getDestinationPosition(),
+                                          shouldOffload, task.delayEstimate);
+        if (!shouldOffload)
+            task.target = getSelfAddress();
+        if (decisionTrace.isOpen()) {
+            const L3Address& destination = networkHeader->getDestinationAddress();
+            DecisionRecord record = {};
+            record.kind = DECISION_OFFLOAD;
+            record.destination = destination.getType() == L3Address::IPv4 ? destination.toIpv4().getInt() : 0;
+            record.chosen = task.target.getType() == L3Address::IPv4 ? task.target.toIpv4().getInt() : 0;
+            record.taskBits = taskBits;
+            record.deadline = task.deadline.dbl();
+            recordDecision(record, gpsrOption->getDestinationPosition());
+        }
+        if (!shouldOffload) {
+            double localTime = task.delayEstimate;
+            if (task.deadline > 0 && simTime() + localTime > task.deadline) {
+                EV_WARN << "Task cannot meet its deadline locally or at any neighbor, dropping at source: localTime="
+                        << localTime << "s, deadline=" << task.deadline << endl;
+                task.rejected = true;
+            }
+        }
+        // Overlapping inputs (e.g. camera tiles) are modeled by drawing content from a finite pool
+        task.contentId = taskContentPoolSize > 0 ? intuniform(1, taskContentPoolSize) : 0;
+    }
+    int chunkIndex = task.nextChunkIndex;
+    task.nextChunkIndex = (task.nextChunkIndex + 1) % taskChunks;
+    if (task.rejected) {
+        // the whole task is rejected; its remaining chunks are dropped without counting it again
+        if (chunkIndex == 0) {
+            tasksRejectedAtSource++;
+            recordTaskDeadlineOutcome(false);
+        }
+        return false;
+    }
+    
+    gpsrOption->setIsOffloadTask(true);
+    gpsrOption->setOffloadTargetAddress(task.target);
+    gpsrOption->setOriginalPayloadBits(chunkBits);
+    gpsrOption->setTaskDeadline(task.deadline);
+    gpsrOption->setTaskContentId(task.contentId);
+    gpsrOption->setTaskId(task.taskId);
+    gpsrOption->setTaskChunkIndex(chunkIndex);
+    gpsrOption->setTaskChunkCount(taskChunks);
+    gpsrOption->setTaskCreationTime(task.creationTime);
+    gpsrOption->setTaskDelayEstimate(task.delayEstimate);
+    return true;
+}
+
+bool QueueGpsr::isLocalTask(const GpsrOption *gpsrOption) const
+{
+    return gpsrOption->getIsOffloadTask() && !gpsrOption->getHasBeenProcessed() &&
+           gpsrOption->getOffloadTargetAddress() == getSelfAddress();
+}
+
+QueueGpsr::TrafficClass QueueGpsr::getTrafficClass(const GpsrOption *gpsrOption) const
+{
+    if (!gpsrOption->getIsOffloadTask())
+        return TRAFFIC_CLASS_BULK;
+    return gpsrOption->getHasBeenProcessed() ? TRAFFIC_CLASS_RESULT : TRAFFIC_CLASS_TASK;
+}
+
+QueueGpsr::ClassForwardingPolicy QueueGpsr::parseClassForwardingPolicy(const char *parameterName)
+{
+    const char *policyString = par(parameterName);
+    if (!strcmp(policyString, "greedy"))
+        return CLASS_POLICY_GREEDY;
+    else if (!strcmp(policyString, "lowestDelay"))
+        return CLASS_POLICY_LOWEST_DELAY;
+    else
+        throw cRuntimeError("Unknown traffic class policy '%s' in %s", policyString, parameterName);
+}
+
+void QueueGpsr::recordTrafficClassDelay(const GpsrOption *gpsrOption)
+{
+    // tasks end at their offload target, results and bulk datagrams at the destination
+    emit(classDelaySignals[getTrafficClass(gpsrOption)], simTime() - gpsrOption->getClassStartTime());
+}
+
+bool QueueGpsr::isTaskExpired(const GpsrOption *gpsrOption) const
+{
+    return gpsrOption->getIsOffloadTask() && gpsrOption->getTaskDeadline() > 0 && simTime() > gpsrOption->getTaskDeadline();
+}
+
+void QueueGpsr::recordTaskDeadlineOutcome(bool met)
+{
+    if (met)
+        tasksDeadlineMet++;
+    else {
+        tasksDeadlineMissed++;
+        emit(taskDeadlineMissedSignal, tasksDeadlineMissed);
+    }
+}
+
+bool QueueGpsr::isFirstTaskOutcome(const L3Address& source, uint64_t taskId, int chunkCount)
+{
+    // A multi-chunk task has a single outcome here: its first dropped chunk or the delivery of its last one
+    if (chunkCount <= 1)
+        return true;
+    if (!taskOutcomes.insert({std::make_pair(source, taskId), simTime()}).second)
+        return false;
+    scheduleTaskAssemblyTimer();
+    return true;
+}
+
+void QueueGpsr::recordTaskDeadlineMiss(const L3Address& source, uint64_t taskId, int chunkCount)
+{
+    if (isFirstTaskOutcome(source, taskId, chunkCount))
+        recordTaskDeadlineOutcome(false);
+}
+
+INetfilter::IHook::Result QueueGpsr::queueLocalTask(Packet *datagram, GpsrOption *gpsrOption)
+{
+    // Store-and-process: the result cache and the deadline are checked once the whole input has arrived
+    if (gpsrOption->getTaskChunkCount() > 1 && !enableStreamingProcessing)
+        return bufferTaskChunk(datagram, gpsrOption);
+
+    int resultBits = 0;
+    uint64_t cacheKey = getResultCacheKey(gpsrOption);
+    if (enableResultCache && cacheKey != 0 && lookupResultCache(cacheKey, resultBits)) {
+        // Cache hit: the result is already known, so the task never reaches the CPU
+        resultCacheCyclesSaved += gpsrOption->getOriginalPayloadBits() * taskCyclesPerBit;
+        gpsrOption->setHasBeenProcessed(true);
+        gpsrOption->setClassStartTime(simTime());
+        datagram->setBitLength(resultBits);
+        EV_INFO << "Result cache hit for content " << gpsrOption->getTaskContentId() 
+                << ": skipping processing, result is " << resultBits << " bits" << endl;
+        if (routingTable->isLocalAddress(getNetworkProtocolHeader(datagram)->getDestinationAddress()))
+            return ACCEPT;
+        return routeDatagram(datagram, gpsrOption);
+    }
+
+    // NOTE: the datagram is only queued by the network layer after this hook returns,
+    // so infeasible tasks must be rejected here rather than dropped from the CPU queue
+    double processingTime = estimateLocalProcessingTime(gpsrOption->getOriginalPayloadBits());
+    simtime_t deadline = gpsrOption->getTaskDeadline();
+    if (deadline > 0 && simTime() + processingTime > deadline) {
+        EV_WARN << "Task would miss its deadline even on an idle CPU, dropping: deadline=" << deadline << endl;
+        countExpiredTask(datagram);
+        recordTaskDeadlineMiss(getNetworkProtocolHeader(datagram)->getSourceAddress(), gpsrOption->getTaskId(), gpsrOption->getTaskChunkCount());
+        return DROP;
+    }
+    // Streaming: every chunk is processed as soon as it arrives, overlapping transfer of the next chunk with compute
+    scheduleTaskProcessing(datagram, processingTime);
+    return QUEUE;
+}
+
+INetfilter::IHook::Result QueueGpsr::bufferTaskChunk(Packet *datagram, GpsrOption *gpsrOption)
+{
+    // Store-and-process: chunks are held until the whole task input has arrived
+    auto key = std::make_pair(getNetworkProtocolHeader(datagram)->getSourceAddress(), gpsrOption->getTaskId());
+    TaskAssembly& assembly = taskAssemblies[key];
+    if (assembly.chunks.empty()) {
+        assembly.expectedChunks = gpsrOption->getTaskChunkCount();
+        assembly.firstArrival = simTime();
+        assembly.deadline = gpsrOption->getTaskDeadline();
+        scheduleTaskAssemblyTimer();
+    }
+    assembly.totalBits += gpsrOption->getOriginalPayloadBits();
+    if ((int)assembly.chunks.size() + 1 < assembly.expectedChunks) {
+        assembly.chunks.push_back(datagram);
+        return QUEUE;
+    }
+    
+    // Last chunk: the whole input enters the CPU queue as a single job
+    std::vector<Packet *> chunks = assembly.chunks;
+    chunks.push_back(datagram);
+    int totalBits = assembly.totalBits;
+    taskAssemblies.erase(key);
+
+    int resultBits = 0;
+    uint64_t cacheKey = getResultCacheKey(gpsrOption);
+    if (enableResultCache && cacheKey != 0 && lookupResultCache(cacheKey, resultBits)) {
+        // Cache hit: the cached result of the whole input is split over the chunks in proportion to their length
+        resultCacheCyclesSaved += totalBits * taskCyclesPerBit;
+        int64_t inputBits = 0;
+        for (Packet *chunk : chunks)
+            inputBits += chunk->getBitLength();
+        EV_INFO << "Result cache hit for content " << gpsrOption->getTaskContentId() 
+                << ": skipping processing of " << chunks.size() << " chunks, result is " << resultBits << " bits" << endl;
+        for (Packet *chunk : chunks) {
+            int chunkResultBits = (int)(chunk->getBitLength() * resultBits / inputBits);
+            chunk->setBitLength(chunkResultBits);
+            if (chunk == datagram)
+                continue;
+            auto mutableNetworkHeader = chunk->removeAtFront<NetworkHeaderBase>();
+            GpsrOption *chunkOption = getGpsrOptionFromNetworkDatagramForUpdate(mutableNetworkHeader);
+            chunkOption->setHasBeenProcessed(true);
+            chunkOption->setClassStartTime(simTime());
+            chunk->insertAtFront(mutableNetworkHeader);
+            resumeQueuedDatagram(chunk);
+        }
+        gpsrOption->setHasBeenProcessed(true);
+        gpsrOption->setClassStartTime(simTime());
+        if (routingTable->isLocalAddress(getNetworkProtocolHeader(datagram)->getDestinationAddress()))
+            return ACCEPT;
+        return routeDatagram(datagram, gpsrOption);
+    }
+
+    double processingTime = estimateLocalProcessingTime(totalBits);
+    simtime_t deadline = gpsrOption->getTaskDeadline();
+    if (deadline > 0 && simTime() + processingTime > deadline) {
+        EV_WARN << "Assembled task would miss its deadline even on an idle CPU, dropping: deadline=" << deadline << endl;
+        tasksExpiredInQueue++;
+        recordTaskDeadlineMiss(key.first, key.second, gpsrOption->getTaskChunkCount());
+        for (Packet *chunk : chunks)
+            if (chunk != datagram)
+                networkProtocol->dropQueuedDatagram(chunk);
+        return DROP;
+    }
+    scheduleTaskProcessing(chunks, processingTime);
+    return QUEUE;
+}
+
+void QueueGpsr::scheduleTaskAssemblyTimer()
+{
+    // every partial task expires taskAssemblyTimeout after it was first seen, so a pending timer is never late
+    if (!taskAssemblyTimer->isScheduled())
+        scheduleAt(simTime() + taskAssemblyTimeout, taskAssemblyTimer);
+}
+
+void QueueGpsr::processTaskAssemblyTimer()
+{
+    simtime_t nextExpiration = SimTime::getMaxTime();
+    for (auto it = taskAssemblies.begin(); it != taskAssemblies.end();) {
+        simtime_t expiration = it->second.firstArrival + taskAssemblyTimeout;
+        if (expiration <= simTime()) {
+            EV_WARN << "Incomplete task input from " << it->first.first << " timed out, dropping "
+                    << it->second.chunks.size() << " of " << it->second.expectedChunks << " chunks" << endl;
+            for (Packet *chunk : it->second.chunks)
+                networkProtocol->dropQueuedDatagram(chunk);
+            if (it->second.deadline > 0)
+                recordTaskDeadlineMiss(it->first.first, it->first.second, it->second.expectedChunks);
+            taskAssemblyTimeouts++;
+            it = taskAssemblies.erase(it);
+        }
+        else {
+            nextExpiration = std::min(nextExpiration, expiration);
+            ++it;
+        }
+    }
+    // Tasks whose remaining chunks were lost on the way never complete here
+    for (auto it = receivedTaskChunks.begin(); it != receivedTaskChunks.end();) {
+        simtime_t expiration = it->second.firstArrival + taskAssemblyTimeout;
+        if (expiration <= simTime()) {
+            EV_DETAIL << "Task " << it->first.second << " from " << it->first.first << " incomplete after "
+                      << it->second.chunks << " chunks, forgetting it" << endl;
+            it = receivedTaskChunks.erase(it);
+        }
+        else {
+            nextExpiration = std::min(nextExpiration, expiration);
+            ++it;
+        }
+    }
+    for (auto it = expiredStreamedTasks.begin(); it != expiredStreamedTasks.end();) {
+        simtime_t expiration = it->second + taskAssemblyTimeout;
+        if (expiration <= simTime())
+            it = expiredStreamedTasks.erase(it);
+        else {
+            nextExpiration = std::min(nextExpiration, expiration);
+            ++it;
+        }
+    }
+    for (auto it = taskOutcomes.begin(); it != taskOutcomes.end();) {
+        simtime_t expiration = it->second + taskAssemblyTimeout;
+        if (expiration <= simTime())
+            it = taskOutcomes.erase(it);
+        else {
+            nextExpiration = std::min(nextExpiration, expiration);
+            ++it;
+        }
+    }
+    if (nextExpiration != SimTime::getMaxTime())
+        scheduleAt(nextExpiration, taskAssemblyTimer);
+}
+
+void QueueGpsr::countExpiredTask(Packet *datagram)
+{
+    // Streamed chunks of one input expire one by one, but the input counts as a single expired task
+    const auto& networkHeader = getNetworkProtocolHeader(datagram);
+    const GpsrOption *gpsrOption = findGpsrOptionInNetworkDatagram(networkHeader);
+    if (gpsrOption != nullptr && gpsrOption->getTaskChunkCount() > 1 && enableStreamingProcessing) {
+        auto key = std::make_pair(networkHeader->getSourceAddress(), gpsrOption->getTaskId());
+        if (!expiredStreamedTasks.insert({key, simTime()}).second)
+            return;
+        scheduleTaskAssemblyTimer();
+    }
+    tasksExpiredInQueue++;
 }
 
 void QueueGpsr::scheduleTaskProcessing(Packet *packet, double processingTimeSeconds)
 {
-    // Create a self-message to represent processing completion
-    cMessage *processingCompleteMsg = new cMessage("ProcessingComplete");
-    
+    scheduleTaskProcessing(std::vector<Packet *>{packet}, processingTimeSeconds);
+}
+
+void QueueGpsr::scheduleTaskProcessing(const std::vector<Packet *>& packets, double processingTimeSeconds)
+{
     // Store task info
     ProcessingTask task;
-    task.packet = packet;
+    task.packets = packets;
     task.processingTimeSeconds = processingTimeSeconds;
-    task.originalSizeBits = packet->getBitLength();
-    pendingProcessingTasks[processingCompleteMsg] = task;
-    
-    // Update CPU backlog (task starts processing)
-    double totalCycles = task.originalSizeBits * taskCyclesPerBit;
-    cpuOffloadBacklogCycles += totalCycles;
-    
-    // Schedule completion
-    scheduleAt(simTime() + processingTimeSeconds, processingCompleteMsg);
-    
-    EV_INFO << "Scheduled task processing: " << task.originalSizeBits << " bits, " 
-            << processingTimeSeconds << "s, completion at t=" << (simTime() + processingTimeSeconds) << endl;
+    task.originalSizeBits = 0;
+    for (Packet *packet : packets)
+        task.originalSizeBits += packet->getBitLength();
+    task.cycles = processingTimeSeconds * cpuOffloadHz;
+    task.enqueueTime = simTime();
+    const GpsrOption *gpsrOption = findGpsrOptionInNetworkDatagram(getNetworkProtocolHeader(packets.front()));
+    task.deadline = gpsrOption != nullptr ? gpsrOption->getTaskDeadline() : SIMTIME_ZERO;
+    
+    // EDF serves the earliest deadline first (tasks without deadline last), FIFO serves in arrival order;
+    // equal keys keep their arrival order in the multimap
+    simtime_t key = task.enqueueTime;
+    if (cpuSchedulingPolicy == CPU_SCHEDULING_EDF)
+        key = task.deadline > 0 ? task.deadline : SimTime::getMaxTime();
+    cpuReadyQueue.insert({key, task});
+    
+    // Update CPU backlog (task accepted for processing)
+    cpuOffloadBacklogCycles += task.cycles;
+    
+    EV_INFO << "Queued task for processing: " << task.originalSizeBits << " bits, " 
+            << processingTimeSeconds << "s, deadline=" << task.deadline 
+            << ", queue length=" << cpuReadyQueue.size() << endl;
     
     std::cout << "🔧 [" << getHostName() << "] t=" << simTime() 
-              << "s: Processing task (" << task.originalSizeBits << " bits) for " 
+              << "s: Queued task (" << task.originalSizeBits << " bits) for " 
               << (processingTimeSeconds * 1000) << " ms | CPU backlog now: " 
               << cpuOffloadBacklogCycles << " cycles" << std::endl;
+    
+    if (pendingProcessingTasks.empty())
+        startNextTaskProcessing();
+}
+
+void QueueGpsr::startNextTaskProcessing()
+{
+    while (!cpuReadyQueue.empty()) {
+        auto it = cpuReadyQueue.begin();
+        ProcessingTask task = it->second;
+        cpuReadyQueue.erase(it);
+        
+        // Drop tasks that expired while waiting instead of wasting cycles and airtime on them
+        if (task.deadline > 0 && simTime() + task.processingTimeSeconds > task.deadline) {
+            EV_WARN << "Task expired in CPU queue, dropping: deadline=" << task.deadline << endl;
+            cpuOffloadBacklogCycles -= task.cycles;
+            if (cpuOffloadBacklogCycles < 0) cpuOffloadBacklogCycles = 0;
+            countExpiredTask(task.packets.front());
+            const auto& networkHeader = getNetworkProtocolHeader(task.packets.front());
+            const GpsrOption *gpsrOption = getGpsrOptionFromNetworkDatagram(networkHeader);
+            recordTaskDeadlineMiss(networkHeader->getSourceAddress(), gpsrOption->getTaskId(), gpsrOption->getTaskChunkCount());
+            for (Packet *packet : task.packets)
+                networkProtocol->dropQueuedDatagram(packet);
+            continue;
+        }
+        
+        emit(taskQueueingTimeSignal, simTime() - task.enqueueTime);
+        
+        // Create a self-message to represent processing completion
+        cMessage *processingCompleteMsg = new cMessage("ProcessingComplete");
+        pendingProcessingTasks[processingCompleteMsg] = task;
+        scheduleAt(simTime() + task.processingTimeSeconds, processingCompleteMsg);
+        
+        EV_INFO << "Started task processing: " << task.originalSizeBits << " bits, " 
+                << task.processingTimeSeconds << "s, completion at t=" << (simTime() + task.processingTimeSeconds) << endl;
+        return;
+    }
+}
+
+void QueueGpsr::clearTaskState()
+{
+    // The network layer flushes the datagrams it holds for us when the node goes down; drop every
+    // reference to them and the timers that would resume them
+    for (auto& entry : pendingProcessingTasks)
+        cancelAndDelete(entry.first);
+    pendingProcessingTasks.clear();
+    cpuReadyQueue.clear();
+    cpuOffloadBacklogCycles = 0;
+    taskAssemblies.clear();
+    receivedTaskChunks.clear();
+    expiredStreamedTasks.clear();
+    taskOutcomes.clear();
+    sourceTasks.clear();
+    cancelEvent(taskAssemblyTimer);
 }
 
 void QueueGpsr::completeTaskProcessing(cMessage *processingCompleteMsg)
 {
+    HandlerProfiler::Scope profileScope(profiler, PROFILE_COMPLETE_TASK_PROCESSING);
     // Retrieve task info
     auto it = pendingProcessingTasks.find(processingCompleteMsg);
     if (it == pendingProcessingTasks.end()) {
@@ -1261,16 +2314,13 @@ void QueueGpsr::completeTaskProcessing(cMessage *processingCompleteMsg)
     }
     
     ProcessingTask task = it->second;
-    Packet *packet = task.packet;
     
     // Update CPU backlog (task completes)
-    double totalCycles = task.originalSizeBits * taskCyclesPerBit;
-    cpuOffloadBacklogCycles -= totalCycles;
+    cpuOffloadBacklogCycles -= task.cycles;
     if (cpuOffloadBacklogCycles < 0) cpuOffloadBacklogCycles = 0;  // avoid negative due to rounding
+    tasksProcessed++;
     
-    // Apply data reduction: shrink packet to reductionFactor * originalSize
     int reducedSizeBits = (int)(task.originalSizeBits * reductionFactor);
-    packet->setBitLength(reducedSizeBits);
     
     EV_INFO << "Task processing complete: reduced from " << task.originalSizeBits 
             << " bits to " << reducedSizeBits << " bits (" << (reductionFactor * 100) 
@@ -1281,103 +2331,327 @@ void QueueGpsr::completeTaskProcessing(cMessage *processingCompleteMsg)
               << reducedSizeBits << " bits (" << (reductionFactor * 100) << "%) | CPU backlog now: " 
               << cpuOffloadBacklogCycles << " cycles" << std::endl;
     
-    // Mark packet as processed in GPSR option
-    auto networkHeader = packet->peekAtFront<NetworkHeaderBase>();
-    auto mutableNetworkHeader = packet->removeAtFront<NetworkHeaderBase>();
-    GpsrOption *gpsrOption = getGpsrOptionFromNetworkDatagramForUpdate(mutableNetworkHeader);
-    if (gpsrOption) {
-        gpsrOption->setHasBeenProcessed(true);
-    }
-    packet->insertAtFront(mutableNetworkHeader);
-    
-    // Forward the packet (continue routing toward destination)
-    sendUdpPacket(packet);
-    
     // Clean up
     pendingProcessingTasks.erase(it);
     delete processingCompleteMsg;
+    
+    uint64_t cacheKey = 0;
+    int resultBits = 0;
+    for (Packet *packet : task.packets) {
+        // Apply data reduction: shrink packet to reductionFactor * originalSize
+        int packetReducedBits = (int)(packet->getBitLength() * reductionFactor);
+        packet->setBitLength(packetReducedBits);
+        
+        // Mark packet as processed in GPSR option
+        auto mutableNetworkHeader = packet->removeAtFront<NetworkHeaderBase>();
+        GpsrOption *gpsrOption = getGpsrOptionFromNetworkDatagramForUpdate(mutableNetworkHeader);
+        gpsrOption->setHasBeenProcessed(true);
+        gpsrOption->setClassStartTime(simTime());
+        cacheKey = getResultCacheKey(gpsrOption);
+        packet->insertAtFront(mutableNetworkHeader);
+        resultBits += packetReducedBits;
+        
+        // Continue routing toward the destination (the datagram is held by the network layer)
+        resumeQueuedDatagram(packet);
+    }
+    // An assembled input shares one cache key, so its result is cached once for the whole task
+    if (enableResultCache && cacheKey != 0)
+        insertResultCache(cacheKey, resultBits);
+    startNextTaskProcessing();
+}
+
+uint64_t QueueGpsr::getResultCacheKey(const GpsrOption *gpsrOption) const
+{
+    // Each streamed chunk of a multi-chunk input is a different piece of content,
+    // while an assembled input is processed (and cached) as a whole
+    if (gpsrOption->getTaskContentId() == 0)
+        return 0;
+    if (gpsrOption->getTaskChunkCount() > 1 && !enableStreamingProcessing)
+        return gpsrOption->getTaskContentId();
+    return gpsrOption->getTaskContentId() + (uint64_t)gpsrOption->getTaskChunkIndex() * 0x9E3779B97F4A7C15ULL;
+}
+
+bool QueueGpsr::lookupResultCache(uint64_t contentId, int& resultBits)
+{
+    auto it = resultCache.find(contentId);
+    if (it == resultCache.end()) {
+        resultCacheMisses++;
+        return false;
+    }
+    // Move to the most recently used position
+    resultCacheLru.splice(resultCacheLru.begin(), resultCacheLru, it->second.lruPosition);
+    resultBits = it->second.resultBits;
+    resultCacheHits++;
+    return true;
+}
+
+void QueueGpsr::insertResultCache(uint64_t contentId, int resultBits)
+{
+    long resultBytes = (resultBits + 7) / 8;
+    if (resultBytes > resultCacheCapacityBytes || resultCache.find(contentId) != resultCache.end())
+        return;
+    // Evict least recently used results until the new one fits
+    while (resultCacheBytes + resultBytes > resultCacheCapacityBytes) {
+        auto victim = resultCache.find(resultCacheLru.back());
+        resultCacheBytes -= (victim->second.resultBits + 7) / 8;
+        resultCache.erase(victim);
+        resultCacheLru.pop_back();
+        resultCacheEvictions++;
+    }
+    resultCacheLru.push_front(contentId);
+    resultCache[contentId] = ResultCacheEntry{resultBits, resultCacheLru.begin()};
+    resultCacheBytes += resultBytes;
+    EV_DETAIL << "Cached result for content " << contentId << ": " << resultBits << " bits, cache size "
+              << resultCacheBytes << "/" << resultCacheCapacityBytes << " bytes" << endl;
+}
+
+double QueueGpsr::getAdvertisedCpuOffloadHz() const
+{
+    // Cache hits cost no cycles, so the capacity seen by offloading neighbors scales with 1 / (1 - hit ratio);
+    // the hit ratio is capped so that a lucky streak cannot advertise unbounded capacity
+    long lookups = resultCacheHits + resultCacheMisses;
+    if (!enableResultCache || lookups == 0)
+        return cpuOffloadHz;
+    double hitRatio = std::min((double)resultCacheHits / lookups, 0.9);
+    return cpuOffloadHz / (1 - hitRatio);
+}
+
+//
+// Decision traces
+//
+
+void QueueGpsr::openDecisionTrace()
+{
+    std::string dir = par("decisionTraceDir").stdstringValue();
+    std::filesystem::create_directories(dir);
+    DecisionTraceHeader header = {};
+    header.flags = (enableDelayTiebreaker ? TRACE_DELAY_TIEBREAKER : 0) | (enableQueueDelay ? TRACE_QUEUE_DELAY : 0) |
+                   (enableOffloadPipelineEstimate ? TRACE_OFFLOAD_PIPELINE_DELAY : 0) | (enableLinkDelayMeasurement ? TRACE_MEASURED_LINK_DELAY : 0);
+    header.maxInfoAge = getCoreParams().maxInfoAge;
+    header.delayEstimationFactor = delayEstimationFactor;
+    header.distanceEqualityThreshold = distanceEqualityThreshold;
+    header.taskCyclesPerBit = taskCyclesPerBit;
+    header.reductionFactor = reductionFactor;
+    header.linkDelayDeviationWeight = linkDelayDeviationWeight;
+    std::string fileName = dir + "/" + host->getFullName() + ".trace";
+    if (!decisionTrace.open(fileName, header))
+        throw cRuntimeError("Cannot write decision trace file '%s'", fileName.c_str());
 }
 
-std::vector<L3Address> QueueGpsr::getPlanarNeighbors() const
+void QueueGpsr::recordDecision(DecisionRecord& record, const Coord& destinationPosition)
 {
-    std::vector<L3Address> planarNeighbors;
-    std::vector<L3Address> neighborAddresses = neighborPositionTable.getAddresses();
+    // The record carries everything the estimators read: own position, CPU state and the neighbor table
+    L3Address selfAddress = getSelfAddress();
     Coord selfPosition = mobility->getCurrentPosition();
-    for (auto it = neighborAddresses.begin(); it != neighborAddresses.end(); it++) {
-        auto neighborAddress = *it;
-        Coord neighborPosition = neighborPositionTable.getPosition(neighborAddress);
-        if (planarizationMode == GPSR_NO_PLANARIZATION)
-            return neighborAddresses;
-        else if (planarizationMode == GPSR_RNG_PLANARIZATION) {
-            double neighborDistance = (neighborPosition - selfPosition).length();
-            for (auto& witnessAddress : neighborAddresses) {
-                Coord witnessPosition = neighborPositionTable.getPosition(witnessAddress);
-                double witnessDistance = (witnessPosition - selfPosition).length();
-                double neighborWitnessDistance = (witnessPosition - neighborPosition).length();
-                if (neighborAddress == witnessAddress)
-                    continue;
-                else if (neighborDistance > std::max(witnessDistance, neighborWitnessDistance))
-                    goto eliminate;
-            }
+    record.node = selfAddress.getType() == L3Address::IPv4 ? selfAddress.toIpv4().getInt() : 0;
+    record.time = simTime().dbl();
+    record.selfX = selfPosition.x;
+    record.selfY = selfPosition.y;
+    record.selfZ = selfPosition.z;
+    record.destX = destinationPosition.x;
+    record.destY = destinationPosition.y;
+    record.destZ = destinationPosition.z;
+    record.localCpuHz = cpuOffloadHz;
+    record.localBacklogCycles = cpuOffloadBacklogCycles;
+    record.localQueueDelay = enableLinkDelayMeasurement ? getLocalQueueDelay() : 0;
+    std::vector<DecisionTraceNeighbor> neighbors;
+    for (const auto& coreNeighbor : getCoreNeighbors(getCandidateNeighborAddresses(false))) {
+        DecisionTraceNeighbor neighbor = {};
+        neighbor.address = coreNeighbor.id <= UINT32_MAX ? coreNeighbor.id : 0;  // IPv4 only
+        neighbor.backlogBytes = coreNeighbor.backlogBytes;
+        neighbor.sojournTime = coreNeighbor.sojournTime;
+        neighbor.linkDelayMean = coreNeighbor.linkDelayMean;
+        neighbor.linkDelayVariance = coreNeighbor.linkDelayVariance;
+        neighbor.x = coreNeighbor.position.x;
+        neighbor.y = coreNeighbor.position.y;
+        neighbor.z = coreNeighbor.position.z;
+        neighbor.queueInfoAge = coreNeighbor.queueInfoAge;
+        neighbor.txBitrate = coreNeighbor.txBitrate;
+        neighbor.cpuInfoAge = coreNeighbor.cpuInfoAge;
+        neighbor.cpuOffloadHz = coreNeighbor.cpuOffloadHz;
+        neighbor.cpuOffloadBacklogCycles = coreNeighbor.cpuOffloadBacklogCycles;
+        neighbors.push_back(neighbor);
+    }
+    decisionTrace.write(record, neighbors);
+}
+
+//
+// Warm-start snapshots
+//
+
+std::string QueueGpsr::getSnapshotFileName() const
+{
+    return snapshotDir + "/" + host->getFullName() + ".snapshot";
+}
+
+void QueueGpsr::saveSnapshot() const
+{
+    // One text file per node; neighbor ages are stored relative to the save time so that
+    // freshness checks behave the same after restoring at t=0
+    std::filesystem::create_directories(snapshotDir);
+    std::ofstream out(getSnapshotFileName());
+    if (!out)
+        throw cRuntimeError("Cannot write snapshot file '%s'", getSnapshotFileName().c_str());
+    out.precision(17);
+    out << "# QueueGpsr snapshot of " << host->getFullPath() << " at t=" << simTime() << "\n";
+    out << "cpuOffloadHz " << cpuOffloadHz << "\n";
+    for (const auto& address : neighborStateService->getNeighborAddresses()) {
+        const NeighborStateService::NeighborState *state = neighborStateService->findNeighbor(address);
+        double age = (simTime() - state->lastUpdate).dbl();
+        out << "neighbor " << address << " " << state->position.x << " " << state->position.y << " " << state->position.z;
+        out << " " << age << " " << state->backlogBytes << " " << state->txBitrate;
+        out << " " << state->cpuOffloadHz << " " << state->cpuOffloadBacklogCycles;
+        out << " " << state->sojournTime;
+        out << " " << state->linkDelayMean << " " << state->linkDelayVariance;
+        // velocity with its age last; the age equals the state age now but stays for the older snapshot format
+        out << " " << state->velocity.x << " " << state->velocity.y << " " << state->velocity.z << " " << age;
+        out << "\n";
+    }
+    // our own measurements of the links from our neighbors, fed back to them in beacons
+    for (const auto& it : measuredLinkDelays)
+        out << "linkDelay " << it.first << " " << it.second.mean << " " << it.second.variance << " " << (simTime() - it.second.lastSample).dbl() << "\n";
+    // the global registry is rebuilt from every node's own position at startup; only a
+    // per-node location table has to be saved
+    if (!useGlobalLocationService) {
+        for (const auto& address : localPositionTable.getAddresses()) {
+            Coord position = localPositionTable.getPosition(address);
+            out << "location " << address << " " << position.x << " " << position.y << " " << position.z << "\n";
+        }
+    }
+    EV_INFO << "Saved snapshot with " << neighborStateService->getNumNeighbors() << " neighbors to " << getSnapshotFileName() << endl;
+}
+
+void QueueGpsr::loadSnapshot()
+{
+    std::ifstream in(getSnapshotFileName());
+    if (!in)
+        throw cRuntimeError("Cannot read snapshot file '%s'", getSnapshotFileName().c_str());
+    int numNeighbors = 0;
+    std::string line;
+    while (std::getline(in, line)) {
+        std::istringstream fields(line);
+        std::string kind, addressString;
+        fields >> kind;
+        if (kind.empty() || kind[0] == '#')
+            continue;
+        if (kind == "cpuOffloadHz") {
+            // overrides the value drawn in initialize(); the draw itself still happens so that
+            // the random number streams are the same as in runs without snapshots
+            fields >> cpuOffloadHz;
+            continue;
+        }
+        if (kind == "linkDelay") {
+            LinkDelayMeasurement measurement;
+            double age;
+            fields >> addressString >> measurement.mean >> measurement.variance >> age;
+            if (fields.fail())
+                throw cRuntimeError("Malformed line in snapshot file '%s': %s", getSnapshotFileName().c_str(), line.c_str());
+            measurement.lastSample = simTime() - age;
+            measuredLinkDelays[L3Address(addressString.c_str())] = measurement;
+            continue;
         }
-        else if (planarizationMode == GPSR_GG_PLANARIZATION) {
-            Coord middlePosition = (selfPosition + neighborPosition) / 2;
-            double neighborDistance = (neighborPosition - middlePosition).length();
-            for (auto& witnessAddress : neighborAddresses) {
-                Coord witnessPosition = neighborPositionTable.getPosition(witnessAddress);
-                double witnessDistance = (witnessPosition - middlePosition).length();
-                if (neighborAddress == witnessAddress)
-                    continue;
-                else if (witnessDistance < neighborDistance)
-                    goto eliminate;
+        Coord position;
+        fields >> addressString >> position.x >> position.y >> position.z;
+        if (fields.fail())
+            throw cRuntimeError("Malformed line in snapshot file '%s': %s", getSnapshotFileName().c_str(), line.c_str());
+        L3Address address(addressString.c_str());
+        if (kind == "location")
+            getLocationTable().setPosition(address, position);
+        else if (kind == "neighbor") {
+            double age;
+            NeighborStateService::NeighborState state;
+            state.position = position;
+            fields >> age >> state.backlogBytes >> state.txBitrate >> state.cpuOffloadHz >> state.cpuOffloadBacklogCycles;
+            if (fields.fail())
+                throw cRuntimeError("Malformed line in snapshot file '%s': %s", getSnapshotFileName().c_str(), line.c_str());
+            // trailing fields are optional so that older snapshots still load
+            if (!(fields >> state.sojournTime))
+                state.sojournTime = -1;  // snapshot written before sojourn times were advertised
+            if (!(fields >> state.linkDelayMean >> state.linkDelayVariance)) {
+                state.linkDelayMean = -1;
+                state.linkDelayVariance = 0;
             }
+            double motionAge;
+            if (!(fields >> state.velocity.x >> state.velocity.y >> state.velocity.z >> motionAge))
+                state.velocity = Coord::ZERO;
+            storePositionInGlobalRegistry(address, position, state.velocity);
+            state.lastUpdate = simTime() - age;
+            neighborStateService->updateNeighbor(address, state);
+            numNeighbors++;
         }
         else
-            throw cRuntimeError("Unknown planarization mode");
-        planarNeighbors.push_back(*it);
-      eliminate:;
+            throw cRuntimeError("Unknown entry '%s' in snapshot file '%s'", kind.c_str(), getSnapshotFileName().c_str());
     }
-    return planarNeighbors;
+    EV_INFO << "Restored snapshot with " << numNeighbors << " neighbors from " << getSnapshotFileName() << endl;
 }
 
-std::vector<L3Address> QueueGpsr::getPlanarNeighborsCounterClockwise(double startAngle) const
+void QueueGpsr::resumeQueuedDatagram(Packet *datagram)
 {
-    std::vector<L3Address> neighborAddresses = getPlanarNeighbors();
-    std::sort(neighborAddresses.begin(), neighborAddresses.end(), [&] (const L3Address& address1, const L3Address& address2) {
-        // NOTE: make sure the neighbor at startAngle goes to the end
-        auto angle1 = getNeighborAngle(address1) - startAngle;
-        auto angle2 = getNeighborAngle(address2) - startAngle;
-        if (angle1 <= 0)
-            angle1 += 2 * M_PI;
-        if (angle2 <= 0)
-            angle2 += 2 * M_PI;
-        return angle1 < angle2;
-    });
-    return neighborAddresses;
+    const auto& networkHeader = getNetworkProtocolHeader(datagram);
+    if (routingTable->isLocalAddress(networkHeader->getDestinationAddress())) {
+        networkProtocol->reinjectQueuedDatagram(datagram);
+        return;
+    }
+    // KLUDGE this allows overwriting the GPSR option inside
+    auto gpsrOption = const_cast<GpsrOption *>(getGpsrOptionFromNetworkDatagram(networkHeader));
+    // a task processed at its source skipped the lookup in datagramLocalOutHook; its result needs the position now
+    if (useHomeRegionLocationService && gpsrOption->getDestinationPosition().isUnspecified()) {
+        lookupDestinationLocation(datagram, networkHeader->getDestinationAddress());
+        return;
+    }
+    Result result = routeDatagram(datagram, gpsrOption);
+    if (result == ACCEPT)
+        networkProtocol->reinjectQueuedDatagram(datagram);
+    else if (result == DROP)
+        networkProtocol->dropQueuedDatagram(datagram);
+    // QUEUE: still held by the network layer, now in the store-carry-forward buffer
 }
 
 //
 // next hop
 //
 
-L3Address QueueGpsr::findNextHop(const L3Address& destination, GpsrOption *gpsrOption)
+L3Address QueueGpsr::findNextHop(const L3Address& source, const L3Address& destination, GpsrOption *gpsrOption)
 {
-    switch (gpsrOption->getRoutingMode()) {
-        case GPSR_GREEDY_ROUTING: return findGreedyRoutingNextHop(destination, gpsrOption);
-        case GPSR_PERIMETER_ROUTING: return findPerimeterRoutingNextHop(destination, gpsrOption);
+    // Unprocessed offload tasks go straight to the selected target (always a neighbor at decision time);
+    // no class policy applies to that single hop. A target that has left the neighborhood since the decision
+    // is bypassed: the task continues towards its destination like any other packet, and greedy forwarding
+    // applies taskClassPolicy to it
+    if (gpsrOption->getIsOffloadTask() && !gpsrOption->getHasBeenProcessed()) {
+        const L3Address& offloadTarget = gpsrOption->getOffloadTargetAddress();
+        if (neighborStateService->hasNeighbor(offloadTarget))
+            return offloadTarget;
+    }
+    GpsrForwardingMode routingMode = gpsrOption->getRoutingMode();
+    L3Address nextHop;
+    switch (routingMode) {
+        case GPSR_GREEDY_ROUTING: nextHop = findGreedyRoutingNextHop(source, destination, gpsrOption); break;
+        case GPSR_PERIMETER_ROUTING: nextHop = findPerimeterRoutingNextHop(source, destination, gpsrOption); break;
+        case GPSR_BACKPRESSURE_ROUTING: nextHop = findBackpressureRoutingNextHop(source, destination, gpsrOption); break;
         default: throw cRuntimeError("Unknown routing mode");
     }
+    if (decisionTrace.isOpen()) {
+        DecisionRecord record = {};
+        record.kind = DECISION_FORWARD;
+        record.routingModeBefore = routingMode;
+        record.routingModeAfter = gpsrOption->getRoutingMode();
+        record.destination = destination.getType() == L3Address::IPv4 ? destination.toIpv4().getInt() : 0;
+        record.chosen = nextHop.getType() == L3Address::IPv4 ? nextHop.toIpv4().getInt() : 0;
+        recordDecision(record, gpsrOption->getDestinationPosition());
+    }
+    return nextHop;
 }
 
-L3Address QueueGpsr::findGreedyRoutingNextHop(const L3Address& destination, GpsrOption *gpsrOption)
+L3Address QueueGpsr::findGreedyRoutingNextHop(const L3Address& source, const L3Address& destination, GpsrOption *gpsrOption)
 {
+    HandlerProfiler::Scope profileScope(profiler, PROFILE_GREEDY_NEXT_HOP);
     EV_DEBUG << "Finding next hop using greedy routing: destination = " << destination << endl;
     L3Address selfAddress = getSelfAddress();
     Coord selfPosition = mobility->getCurrentPosition();
     Coord destinationPosition = gpsrOption->getDestinationPosition();
-    double bestDistance = (destinationPosition - selfPosition).length();
-    L3Address bestNeighbor;
-    double bestDelay = INFINITY;  // Track best delay for tiebreaker
+    double selfDistance = (destinationPosition - selfPosition).length();
+    
+    std::vector<L3Address> neighborAddresses = getCandidateNeighborAddresses();
     
     // STEP 4 AUDIT: Log routing decision for source node (host[0]) only
     bool isSourceNode = (strcmp(getContainingNode(this)->getFullName(), "host[0]") == 0);
@@ -1388,13 +2662,12 @@ L3Address QueueGpsr::findGreedyRoutingNextHop(const L3Address& destination, Gpsr
         std::cout << "  Destination: " << destination << "\n";
         std::cout << "  My position: (" << selfPosition.x << ", " << selfPosition.y << ")\n";
         std::cout << "  Dest position: (" << destinationPosition.x << ", " << destinationPosition.y << ")\n";
-        std::cout << "  My distance to dest: " << bestDistance << " m\n";
-        std::cout << "  Evaluating " << neighborPositionTable.getAddresses().size() << " neighbors:\n";
+        std::cout << "  My distance to dest: " << selfDistance << " m\n";
+        std::cout << "  Evaluating " << neighborAddresses.size() << " neighbors:\n";
     }
     
-    std::vector<L3Address> neighborAddresses = neighborPositionTable.getAddresses();
     for (auto& neighborAddress : neighborAddresses) {
-        Coord neighborPosition = neighborPositionTable.getPosition(neighborAddress);
+        Coord neighborPosition = getNeighborPosition(neighborAddress);
         double neighborDistance = (destinationPosition - neighborPosition).length();
         
         // STEP 4 AUDIT: Log each candidate evaluation with Q/R breakdown
@@ -1405,32 +2678,16 @@ L3Address QueueGpsr::findGreedyRoutingNextHop(const L3Address& destination, Gpsr
             double distanceDelayTerm = neighborDistance * delayEstimationFactor;
             double linkRateMbps = 0.0;
             
-            auto it = neighborTxBacklogBytes.find(neighborAddress);
-            if (it != neighborTxBacklogBytes.end()) {
-                candidateBacklog = it->second.bytes;
+            if (const NeighborStateService::NeighborState *state = neighborStateService->findNeighbor(neighborAddress)) {
+                candidateBacklog = state->backlogBytes;
                 
                 // Calculate Q/R if queue-aware enabled
                 if (enableQueueDelay && candidateBacklog > 0) {
-                    // Read bitrate from NEIGHBOR's radio.transmitter.bitrate (INET 4.5.x path)
-                    L3AddressResolver resolver;
-                    cModule *neighborHost = resolver.findHostWithAddress(neighborAddress);
-                    if (neighborHost) {
-                        cModule *wlan = neighborHost->getSubmodule("wlan", 0);
-                        if (wlan) {
-                            cModule *radio = wlan->getSubmodule("radio");
-                            if (radio) {
-                                cModule *transmitter = radio->getSubmodule("transmitter");
-                                if (transmitter && transmitter->hasPar("bitrate")) {
-                                    try {
-                                        double bitrate = transmitter->par("bitrate").doubleValue();
-                                        if (bitrate > 0.0) {
-                                            linkRateMbps = bitrate / 1e6;  // Convert to Mbps
-                                            queueDelayTerm = (candidateBacklog * 8.0) / bitrate;
-                                        }
-                                    } catch (...) {}
-                                }
-                            }
-                        }
+                    // Bitrate advertised in the neighbor's beacon
+                    double bitrate = state->txBitrate;
+                    if (bitrate > 0.0) {
+                        linkRateMbps = bitrate / 1e6;  // Convert to Mbps
+                        queueDelayTerm = (candidateBacklog * 8.0) / bitrate;
                     }
                 }
             }
@@ -1443,90 +2700,77 @@ L3Address QueueGpsr::findGreedyRoutingNextHop(const L3Address& destination, Gpsr
                      << " | D×factor=" << distanceDelayTerm << "s"
                      << " | Total delay=" << candidateDelay << "s\n";
         }
+    }
+    
+    // Delay tiebreaker logic (Phase 2/3) lives in the routing core; ties are reported back for diagnostics
+    std::vector<gpsrcore::Neighbor> neighbors = getCoreNeighbors(neighborAddresses);
+    auto onTie = [&] (const gpsrcore::TieEvent& tie) {
+        const L3Address& bestNeighbor = neighborAddresses[tie.best];
+        const L3Address& neighborAddress = neighborAddresses[tie.challenger];
+        double distanceDiff = fabs(tie.challengerDistance - tie.bestDistance);
         
-        // DEBUG: Log distance comparisons when tiebreaker enabled
-        if (enableDelayTiebreaker && !bestNeighbor.isUnspecified()) {
-            double distanceDiff = fabs(neighborDistance - bestDistance);
-            EV_DETAIL << "Comparing neighbor " << neighborAddress 
-                      << ": neighborDist=" << neighborDistance << "m, bestDist=" << bestDistance 
-                      << "m, diff=" << distanceDiff << "m, threshold=" << distanceEqualityThreshold 
-                      << "m" << endl;
+        // Log ALL ties with full details including queue sizes
+        std::cout << "[TIE] t=" << simTime() << " " << getContainingNode(this)->getFullName()
+                 << ": dst=" << destination 
+                 << " | best=" << bestNeighbor << " dist=" << tie.bestDistance << "m delay=" << tie.bestDelay << "s Q=" << neighbors[tie.best].backlogBytes << "B"
+                 << " | challenger=" << neighborAddress << " dist=" << tie.challengerDistance << "m delay=" << tie.challengerDelay << "s Q=" << neighbors[tie.challenger].backlogBytes << "B"
+                 << " | distDiff=" << distanceDiff << "m" << std::endl;
+        
+        if (isSourceNode && simTime() >= 15.0) {
+            std::cout << "    🔀 TIE DETECTED! Candidates equidistant (diff=" 
+                     << distanceDiff << "m < " 
+                     << distanceEqualityThreshold << "m threshold)\n";
+            std::cout << "       Current best: " << bestNeighbor << " delay=" << tie.bestDelay << "s\n";
+            std::cout << "       Challenger: " << neighborAddress << " delay=" << tie.challengerDelay << "s\n";
         }
         
-        // Delay tiebreaker logic (Phase 2/3)
-        if (enableDelayTiebreaker && neighborDistance < bestDistance) {
-            // This neighbor is strictly closer - it becomes the new best
-            bestDistance = neighborDistance;
-            bestNeighbor = neighborAddress;
-            bestDelay = estimateNeighborDelay(neighborAddress);
-            greedySelections++;
-        }
-        else if (enableDelayTiebreaker && 
-                 !bestNeighbor.isUnspecified() &&
-                 fabs(neighborDistance - bestDistance) < distanceEqualityThreshold) {
-            // Neighbors are equidistant (within threshold) - use delay tiebreaker
-            double neighborDelay = estimateNeighborDelay(neighborAddress);
-            
-            // Get queue info for detailed logging
-            double bestQueueBytes = 0, neighborQueueBytes = 0;
-            auto bestIt = neighborTxBacklogBytes.find(bestNeighbor);
-            auto neighIt = neighborTxBacklogBytes.find(neighborAddress);
-            if (bestIt != neighborTxBacklogBytes.end()) bestQueueBytes = bestIt->second.bytes;
-            if (neighIt != neighborTxBacklogBytes.end()) neighborQueueBytes = neighIt->second.bytes;
+        EV_INFO << "TIE DETECTED! neighbor=" << neighborAddress 
+                << " neighborDist=" << tie.challengerDistance << "m bestDist=" << tie.bestDistance 
+                << "m diff=" << distanceDiff << "m threshold=" 
+                << distanceEqualityThreshold << "m neighborDelay=" << tie.challengerDelay 
+                << "s bestDelay=" << tie.bestDelay << "s" << endl;
+        
+        if (tie.challengerWins) {
+            tiebreakerActivations++;
+            emit(tiebreakerActivationsSignal, tiebreakerActivations);
             
-            // Log ALL ties with full details including queue sizes
-            std::cout << "[TIE] t=" << simTime() << " " << getContainingNode(this)->getFullName()
-                     << ": dst=" << destination 
-                     << " | best=" << bestNeighbor << " dist=" << bestDistance << "m delay=" << bestDelay << "s Q=" << bestQueueBytes << "B"
-                     << " | challenger=" << neighborAddress << " dist=" << neighborDistance << "m delay=" << neighborDelay << "s Q=" << neighborQueueBytes << "B"
-                     << " | distDiff=" << fabs(neighborDistance - bestDistance) << "m" << std::endl;
+            // Log ALL tiebreaker activations with full context
+            std::cout << "[TIEBREAKER-WIN] t=" << simTime() << " " << getContainingNode(this)->getFullName()
+                     << ": chose=" << neighborAddress << " delay=" << tie.challengerDelay << "s"
+                     << " over=" << bestNeighbor << " delay=" << tie.bestDelay << "s"
+                     << " | activations=" << tiebreakerActivations << std::endl;
             
             if (isSourceNode && simTime() >= 15.0) {
-                std::cout << "    🔀 TIE DETECTED! Candidates equidistant (diff=" 
-                         << fabs(neighborDistance - bestDistance) << "m < " 
-                         << distanceEqualityThreshold << "m threshold)\n";
-                std::cout << "       Current best: " << bestNeighbor << " delay=" << bestDelay << "s\n";
-                std::cout << "       Challenger: " << neighborAddress << " delay=" << neighborDelay << "s\n";
+                std::cout << "       ✅ TIEBREAKER ACTIVATED! Chose " << neighborAddress 
+                         << " (lower delay: " << tie.challengerDelay << "s < " << tie.bestDelay << "s)\n";
+                std::cout << "       Total tiebreaker activations: " << tiebreakerActivations << "\n";
             }
             
-            EV_INFO << "TIE DETECTED! neighbor=" << neighborAddress 
-                    << " neighborDist=" << neighborDistance << "m bestDist=" << bestDistance 
-                    << "m diff=" << fabs(neighborDistance - bestDistance) << "m threshold=" 
-                    << distanceEqualityThreshold << "m neighborDelay=" << neighborDelay 
-                    << "s bestDelay=" << bestDelay << "s" << endl;
-            
-            if (neighborDelay < bestDelay) {
-                double previousBestDelay = bestDelay;  // Save for logging before update
-                bestDistance = neighborDistance;
-                bestNeighbor = neighborAddress;
-                bestDelay = neighborDelay;
-                tiebreakerActivations++;
-                emit(tiebreakerActivationsSignal, tiebreakerActivations);
-                
-                // Log ALL tiebreaker activations with full context
-                std::cout << "[TIEBREAKER-WIN] t=" << simTime() << " " << getContainingNode(this)->getFullName()
-                         << ": chose=" << neighborAddress << " delay=" << neighborDelay << "s"
-                         << " over=" << bestNeighbor << " delay=" << previousBestDelay << "s"
-                         << " | activations=" << tiebreakerActivations << std::endl;
-                
-                if (isSourceNode && simTime() >= 15.0) {
-                    std::cout << "       ✅ TIEBREAKER ACTIVATED! Chose " << neighborAddress 
-                             << " (lower delay: " << neighborDelay << "s < " << previousBestDelay << "s)\n";
-                    std::cout << "       Total tiebreaker activations: " << tiebreakerActivations << "\n";
-                }
-                
-                EV_DEBUG << "Tiebreaker activated: selected neighbor " << neighborAddress 
-                         << " with delay " << neighborDelay << "s over previous best with delay " 
-                         << bestDelay << "s (distances: " << neighborDistance << "m vs " 
-                         << bestDistance << "m)" << endl;
-            }
+            EV_DEBUG << "Tiebreaker activated: selected neighbor " << neighborAddress 
+                     << " with delay " << tie.challengerDelay << "s over previous best with delay " 
+                     << tie.bestDelay << "s (distances: " << tie.challengerDistance << "m vs " 
+                     << tie.bestDistance << "m)" << endl;
         }
-        else if (!enableDelayTiebreaker && neighborDistance < bestDistance) {
-            // Original GPSR logic: just select strictly closer neighbor
-            bestDistance = neighborDistance;
-            bestNeighbor = neighborAddress;
+    };
+    gpsrcore::GreedyResult result = gpsrcore::findGreedyNextHop(getCoreParams(), toVec3(selfPosition), toVec3(destinationPosition), neighbors, onTie);
+    greedySelections += result.greedySelections;
+    L3Address bestNeighbor = result.nextHop == gpsrcore::NO_NEIGHBOR ? L3Address() : neighborAddresses[result.nextHop];
+    
+    // Latency-sensitive traffic classes take the lowest delay per meter of progress instead
+    if (enableTrafficClasses && classForwardingPolicies[getTrafficClass(gpsrOption)] == CLASS_POLICY_LOWEST_DELAY && !bestNeighbor.isUnspecified()) {
+        int lowestDelayNeighbor = gpsrcore::findLowestDelayNextHop(getCoreParams(), toVec3(selfPosition), toVec3(destinationPosition), neighbors);
+        if (lowestDelayNeighbor != gpsrcore::NO_NEIGHBOR && neighborAddresses[lowestDelayNeighbor] != bestNeighbor) {
+            EV_DETAIL << "Lowest delay next hop " << neighborAddresses[lowestDelayNeighbor] << " overrides greedy next hop " << bestNeighbor << endl;
+            bestNeighbor = neighborAddresses[lowestDelayNeighbor];
+            lowestDelayOverrides++;
         }
     }
+    // Load spreading: split traffic over the near-equal candidates instead of the single tiebreaker winner
+    else if (multipathMode != MULTIPATH_NONE && !bestNeighbor.isUnspecified())
+        bestNeighbor = selectMultipathNextHop(source, destination, neighborAddresses, neighbors, selfPosition, destinationPosition);
+    // Hysteresis: the flow keeps its previous next hop unless the new choice is clearly cheaper
+    else if (enableStickyNextHop && !bestNeighbor.isUnspecified())
+        bestNeighbor = applyNextHopHysteresis(source, destination, bestNeighbor, neighborAddresses, neighbors, selfPosition, destinationPosition);
     
     // Phase 5: Log offload decision estimates (only when enabled, just logging for now)
     if (enableOffloadDecisions && !neighborAddresses.empty()) {
@@ -1538,8 +2782,8 @@ L3Address QueueGpsr::findGreedyRoutingNextHop(const L3Address& destination, Gpsr
         if (!bestNeighbor.isUnspecified()) {
             std::cout << "  ──────────────────────────────────────────\n";
             std::cout << "  ✓ SELECTED: " << bestNeighbor << "\n";
-            std::cout << "    Distance to dest: " << bestDistance << " m\n";
-            std::cout << "    Estimated delay: " << bestDelay << " s\n";
+            std::cout << "    Distance to dest: " << result.distance << " m\n";
+            std::cout << "    Estimated delay: " << result.delay << " s\n";
             std::cout << "    Tiebreaker activations (total): " << tiebreakerActivations << "\n";
             std::cout << "━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━\n" << std::flush;
         } else {
@@ -1557,71 +2801,127 @@ L3Address QueueGpsr::findGreedyRoutingNextHop(const L3Address& destination, Gpsr
         gpsrOption->setPerimeterRoutingForwardPosition(selfPosition);
         gpsrOption->setCurrentFaceFirstSenderAddress(selfAddress);
         gpsrOption->setCurrentFaceFirstReceiverAddress(L3Address());
-        return findPerimeterRoutingNextHop(destination, gpsrOption);
+        gpsrOption->setRecoveryRadius(recoveryInitialRadiusFactor * selfPosition.distance(destinationPosition));
+        gpsrOption->setRecoveryReverse(false);
+        gpsrOption->setRecoveryBoundaryHits(0);
+        gpsrOption->setRecoveryPlane(0);
+        gpsrOption->setPerimeterStartTime(simTime());
+        gpsrOption->setPerimeterHopCount(0);
+        recoveryEpisodes++;
+        return findPerimeterRoutingNextHop(source, destination, gpsrOption);
     }
     else
         return bestNeighbor;
 }
 
-L3Address QueueGpsr::findPerimeterRoutingNextHop(const L3Address& destination, GpsrOption *gpsrOption)
+L3Address QueueGpsr::findPerimeterRoutingNextHop(const L3Address& source, const L3Address& destination, GpsrOption *gpsrOption)
 {
+    HandlerProfiler::Scope profileScope(profiler, PROFILE_PERIMETER_NEXT_HOP);
     EV_DEBUG << "Finding next hop using perimeter routing: destination = " << destination << endl;
     L3Address selfAddress = getSelfAddress();
-    Coord selfPosition = mobility->getCurrentPosition();
-    Coord perimeterRoutingStartPosition = gpsrOption->getPerimeterRoutingStartPosition();
-    Coord destinationPosition = gpsrOption->getDestinationPosition();
-    double selfDistance = (destinationPosition - selfPosition).length();
-    double perimeterRoutingStartDistance = (destinationPosition - perimeterRoutingStartPosition).length();
-    if (selfDistance < perimeterRoutingStartDistance) {
+    const L3Address& firstSenderAddress = gpsrOption->getCurrentFaceFirstSenderAddress();
+    const L3Address& firstReceiverAddress = gpsrOption->getCurrentFaceFirstReceiverAddress();
+    auto senderNeighborAddress = gpsrOption->getSenderAddress();
+    gpsrcore::PerimeterInput input;
+    input.selfId = getCoreNodeId(selfAddress);
+    input.self = toVec3(mobility->getCurrentPosition());
+    input.destination = toVec3(gpsrOption->getDestinationPosition());
+    input.perimeterStartPosition = toVec3(gpsrOption->getPerimeterRoutingStartPosition());
+    input.faceFirstSender = getCoreNodeId(firstSenderAddress);
+    input.faceFirstReceiver = getCoreNodeId(firstReceiverAddress);
+    gpsrcore::Vec3 senderPosition;
+    if (!senderNeighborAddress.isUnspecified()) {
+        senderPosition = toVec3(getNeighborPosition(senderNeighborAddress));
+        input.senderPosition = &senderPosition;
+        input.senderId = getCoreNodeId(senderNeighborAddress);
+    }
+    std::vector<L3Address> neighborAddresses = getCandidateNeighborAddresses();
+    std::vector<gpsrcore::Neighbor> neighbors = getCoreNeighbors(neighborAddresses);
+    gpsrcore::PerimeterResult result;
+    if (recoveryStrategy == RECOVERY_BOUNDED_FACE) {
+        gpsrcore::FaceBound bound;
+        bound.radius = gpsrOption->getRecoveryRadius();
+        bound.reverse = gpsrOption->getRecoveryReverse();
+        bound.boundaryHits = gpsrOption->getRecoveryBoundaryHits();
+        result = gpsrcore::findBoundedPerimeterNextHop(getCoreParams(), input, bound, recoveryRadiusGrowthFactor, neighbors);
+        if (bound.reversals > 0 || bound.expansions > 0)
+            EV_DEBUG << "Bounded face routing: reversals = " << bound.reversals << ", expansions = " << bound.expansions << ", radius = " << bound.radius << endl;
+        gpsrOption->setRecoveryRadius(bound.radius);
+        gpsrOption->setRecoveryReverse(bound.reverse);
+        gpsrOption->setRecoveryBoundaryHits(bound.boundaryHits);
+        recoveryReversals += bound.reversals;
+        recoveryExpansions += bound.expansions;
+    }
+    else if (recoveryStrategy == RECOVERY_PROJECTED_FACE) {
+        int plane = gpsrOption->getRecoveryPlane();
+        result = gpsrcore::findProjectedPerimeterNextHop(getCoreParams(), input, plane, neighbors);
+        if (plane != gpsrOption->getRecoveryPlane()) {
+            EV_DEBUG << "Projected face routing: switching from plane " << gpsrOption->getRecoveryPlane() << " to plane " << plane << endl;
+            recoveryPlaneSwitches += plane - gpsrOption->getRecoveryPlane();
+            gpsrOption->setRecoveryPlane(plane);
+        }
+    }
+    else
+        result = gpsrcore::findPerimeterNextHop(getCoreParams(), input, neighbors);
+    if (result.outcome == gpsrcore::PerimeterResult::SWITCH_TO_GREEDY) {
         EV_DEBUG << "Switching to greedy routing: destination = " << destination << endl;
         if (displayBubbles && hasGUI())
             getContainingNode(host)->bubble("Switching to greedy routing");
-        gpsrOption->setRoutingMode(GPSR_GREEDY_ROUTING);
-        gpsrOption->setPerimeterRoutingStartPosition(Coord());
-        gpsrOption->setPerimeterRoutingForwardPosition(Coord());
-        gpsrOption->setCurrentFaceFirstSenderAddress(L3Address());
+        recordRecoveryEnd(gpsrOption);
+        clearPerimeterState(gpsrOption);
+        if (forwardingMode == GPSR_BACKPRESSURE_ROUTING)
+            return findBackpressureRoutingNextHop(source, destination, gpsrOption);
+        return findGreedyRoutingNextHop(source, destination, gpsrOption);
+    }
+    if (result.faceChanged) {
+        EV_DEBUG << "Edge to next hop intersects: intersection = " << toCoord(result.forwardPosition) << ", firstSender = " << firstSenderAddress << ", firstReceiver = " << firstReceiverAddress << ", destination = " << destination << endl;
+        gpsrOption->setCurrentFaceFirstSenderAddress(selfAddress);
         gpsrOption->setCurrentFaceFirstReceiverAddress(L3Address());
-        return findGreedyRoutingNextHop(destination, gpsrOption);
+        gpsrOption->setPerimeterRoutingForwardPosition(toCoord(result.forwardPosition));
+    }
+    if (result.outcome == gpsrcore::PerimeterResult::NO_NEIGHBOR_FOUND) {
+        EV_DEBUG << "No suitable planar graph neighbor found in perimeter routing: firstSender = " << firstSenderAddress << ", firstReceiver = " << firstReceiverAddress << ", destination = " << destination << endl;
+        recoveryFailures++;
+        return L3Address();
+    }
+    else if (result.outcome == gpsrcore::PerimeterResult::END_OF_PERIMETER) {
+        EV_DEBUG << "End of perimeter reached: firstSender = " << firstSenderAddress << ", firstReceiver = " << firstReceiverAddress << ", destination = " << destination << endl;
+        if (displayBubbles && hasGUI())
+            getContainingNode(host)->bubble("End of perimeter reached");
+        recoveryFailures++;
+        return L3Address();
     }
     else {
-        const L3Address& firstSenderAddress = gpsrOption->getCurrentFaceFirstSenderAddress();
-        const L3Address& firstReceiverAddress = gpsrOption->getCurrentFaceFirstReceiverAddress();
-        auto senderNeighborAddress = gpsrOption->getSenderAddress();
-        auto neighborAngle = senderNeighborAddress.isUnspecified() ? getVectorAngle(destinationPosition - mobility->getCurrentPosition()) : getNeighborAngle(senderNeighborAddress);
-        L3Address selectedNeighborAddress;
-        std::vector<L3Address> neighborAddresses = getPlanarNeighborsCounterClockwise(neighborAngle);
-        for (auto& neighborAddress : neighborAddresses) {
-            Coord neighborPosition = getNeighborPosition(neighborAddress);
-            Coord intersection = computeIntersectionInsideLineSegments(perimeterRoutingStartPosition, destinationPosition, selfPosition, neighborPosition);
-            if (std::isnan(intersection.x)) {
-                selectedNeighborAddress = neighborAddress;
-                break;
-            }
-            else {
-                EV_DEBUG << "Edge to next hop intersects: intersection = " << intersection << ", nextNeighbor = " << selectedNeighborAddress << ", firstSender = " << firstSenderAddress << ", firstReceiver = " << firstReceiverAddress << ", destination = " << destination << endl;
-                gpsrOption->setCurrentFaceFirstSenderAddress(selfAddress);
-                gpsrOption->setCurrentFaceFirstReceiverAddress(L3Address());
-                gpsrOption->setPerimeterRoutingForwardPosition(intersection);
-            }
-        }
-        if (selectedNeighborAddress.isUnspecified()) {
-            EV_DEBUG << "No suitable planar graph neighbor found in perimeter routing: firstSender = " << firstSenderAddress << ", firstReceiver = " << firstReceiverAddress << ", destination = " << destination << endl;
-            return L3Address();
-        }
-        else if (firstSenderAddress == selfAddress && firstReceiverAddress == selectedNeighborAddress) {
-            EV_DEBUG << "End of perimeter reached: firstSender = " << firstSenderAddress << ", firstReceiver = " << firstReceiverAddress << ", destination = " << destination << endl;
-            if (displayBubbles && hasGUI())
-                getContainingNode(host)->bubble("End of perimeter reached");
-            return L3Address();
-        }
-        else {
-            if (gpsrOption->getCurrentFaceFirstReceiverAddress().isUnspecified())
-                gpsrOption->setCurrentFaceFirstReceiverAddress(selectedNeighborAddress);
-            return selectedNeighborAddress;
-        }
+        const L3Address& selectedNeighborAddress = neighborAddresses[result.nextHop];
+        if (result.firstReceiverSet)
+            gpsrOption->setCurrentFaceFirstReceiverAddress(selectedNeighborAddress);
+        return selectedNeighborAddress;
     }
 }
 
+L3Address QueueGpsr::findBackpressureRoutingNextHop(const L3Address& source, const L3Address& destination, GpsrOption *gpsrOption)
+{
+    EV_DEBUG << "Finding next hop using backpressure routing: destination = " << destination << endl;
+    Coord selfPosition = mobility->getCurrentPosition();
+    std::vector<L3Address> neighborAddresses = getCandidateNeighborAddresses();
+    std::vector<gpsrcore::Neighbor> neighbors = getCoreNeighbors(neighborAddresses);
+    double selfBacklogBytes = getLocalTxBacklogBytes();
+    gpsrcore::BackpressureResult result = gpsrcore::findBackpressureNextHop(getCoreParams(), toVec3(selfPosition),
+            toVec3(gpsrOption->getDestinationPosition()), neighbors, selfBacklogBytes, getLocalTxBitrate());
+    if (result.nextHop == gpsrcore::NO_NEIGHBOR) {
+        // No positive queue differential towards the destination: greedy decides this hop. The packet stays
+        // in backpressure mode unless greedy runs into a local minimum and switches to perimeter routing.
+        EV_DEBUG << "No positive backpressure weight among " << result.eligible << " neighbors, falling back to greedy" << endl;
+        backpressureFallbacks++;
+        return findGreedyRoutingNextHop(source, destination, gpsrOption);
+    }
+    backpressureSelections++;
+    const L3Address& nextHop = neighborAddresses[result.nextHop];
+    EV_INFO << "Backpressure: selected " << nextHop << " weight=" << result.weight << " ownQ=" << selfBacklogBytes
+            << "B neighborQ=" << neighbors[result.nextHop].backlogBytes << "B" << endl;
+    return nextHop;
+}
+
 //
 // routing
 //
@@ -1631,15 +2931,27 @@ INetfilter::IHook::Result QueueGpsr::routeDatagram(Packet *datagram, GpsrOption
     const auto& networkHeader = getNetworkProtocolHeader(datagram);
     const L3Address& source = networkHeader->getSourceAddress();
     const L3Address& destination = networkHeader->getDestinationAddress();
+    if (isTaskExpired(gpsrOption)) {
+        // Deadline already passed: forwarding further would only waste airtime
+        EV_WARN << "Task deadline expired, dropping packet: source = " << source << ", destination = " << destination << endl;
+        tasksExpiredInNetwork++;
+        recordTaskDeadlineMiss(source, gpsrOption->getTaskId(), gpsrOption->getTaskChunkCount());
+        return DROP;
+    }
     EV_INFO << "Finding next hop: source = " << source << ", destination = " << destination << endl;
-    auto nextHop = findNextHop(destination, gpsrOption);
+    L3Address nextHop = findDatagramNextHop(source, destination, gpsrOption);
     
     // DEBUG: Log ALL routing decisions with comprehensive details
     std::cout << "[ROUTE] t=" << simTime() << " " << getContainingNode(this)->getFullName() 
               << ": src=" << source << " dst=" << destination << " nextHop=" << nextHop << std::endl;
     
     datagram->addTagIfAbsent<NextHopAddressReq>()->setNextHopAddress(nextHop);
-    if (nextHop.isUnspecified()) {
+    if (nextHop.isUnspecified() && enableStoreCarryForward) {
+        EV_WARN << "No next hop found, carrying packet: source = " << source << ", destination = " << destination << endl;
+        carryDatagram(datagram, gpsrOption);
+        return QUEUE;
+    }
+    else if (nextHop.isUnspecified()) {
         EV_WARN << "No next hop found, dropping packet: source = " << source << ", destination = " << destination << endl;
         std::cout << "[DROP] " << getContainingNode(this)->getFullName() << ": No next hop for dst=" << destination << std::endl;
         if (displayBubbles && hasGUI())
@@ -1648,13 +2960,160 @@ INetfilter::IHook::Result QueueGpsr::routeDatagram(Packet *datagram, GpsrOption
     }
     else {
         EV_INFO << "Next hop found: source = " << source << ", destination = " << destination << ", nextHop: " << nextHop << endl;
-        gpsrOption->setSenderAddress(getSelfAddress());
-        auto networkInterface = CHK(interfaceTable->findInterfaceByName(outputInterface));
-        datagram->addTagIfAbsent<InterfaceReq>()->setInterfaceId(networkInterface->getInterfaceId());
+        setDatagramNextHop(datagram, gpsrOption, source, destination, nextHop);
         return ACCEPT;
     }
 }
 
+L3Address QueueGpsr::findDatagramNextHop(const L3Address& source, const L3Address& destination, GpsrOption *gpsrOption)
+{
+    if (gpsrOption->getDestinationPosition().isUnspecified()) {
+        // Destination position not known to the (local) location service: only direct delivery is possible
+        if (neighborStateService->hasNeighbor(destination))
+            return destination;
+        return L3Address();
+    }
+    updateDestinationPosition(destination, gpsrOption);
+    return findNextHop(source, destination, gpsrOption);
+}
+
+void QueueGpsr::setDatagramNextHop(Packet *datagram, GpsrOption *gpsrOption, const L3Address& source, const L3Address& destination, const L3Address& nextHop)
+{
+    recordFlowNextHop(source, destination, nextHop);
+    gpsrOption->setHopCount(gpsrOption->getHopCount() + 1);
+    if (neighborStateService->hasNeighbor(nextHop))
+        gpsrOption->setPathLength(gpsrOption->getPathLength() + mobility->getCurrentPosition().distance(getNeighborPosition(nextHop)));
+    if (gpsrOption->getRoutingMode() == GPSR_PERIMETER_ROUTING)
+        gpsrOption->setPerimeterHopCount(gpsrOption->getPerimeterHopCount() + 1);
+    if (enableTrafficClasses) {
+        TrafficClass trafficClass = getTrafficClass(gpsrOption);
+        classForwardedPackets[trafficClass]++;
+        // 802.11e access category of this hop (the class changes when a task is processed)
+        if (classUserPriorities[trafficClass] >= 0)
+            datagram->addTagIfAbsent<UserPriorityReq>()->setUserPriority(classUserPriorities[trafficClass]);
+        else
+            datagram->removeTagIfPresent<UserPriorityReq>();
+    }
+    datagram->addTagIfAbsent<NextHopAddressReq>()->setNextHopAddress(nextHop);
+    gpsrOption->setSenderAddress(getSelfAddress());
+    // the receiver's delay sample covers our queueing, channel access and transmission
+    gpsrOption->setHopSendTime(enableLinkDelayMeasurement ? simTime() : SimTime(-1));
+    auto networkInterface = CHK(interfaceTable->findInterfaceByName(outputInterface));
+    datagram->addTagIfAbsent<InterfaceReq>()->setInterfaceId(networkInterface->getInterfaceId());
+}
+
+void QueueGpsr::clearPerimeterState(GpsrOption *gpsrOption)
+{
+    gpsrOption->setRoutingMode(forwardingMode);
+    gpsrOption->setPerimeterRoutingStartPosition(Coord());
+    gpsrOption->setPerimeterRoutingForwardPosition(Coord());
+    gpsrOption->setCurrentFaceFirstSenderAddress(L3Address());
+    gpsrOption->setCurrentFaceFirstReceiverAddress(L3Address());
+    gpsrOption->setRecoveryRadius(0);
+    gpsrOption->setRecoveryReverse(false);
+    gpsrOption->setRecoveryBoundaryHits(0);
+    gpsrOption->setRecoveryPlane(0);
+}
+
+void QueueGpsr::recordRecoveryEnd(const GpsrOption *gpsrOption)
+{
+    recoverySuccesses++;
+    emit(perimeterDurationSignal, simTime() - gpsrOption->getPerimeterStartTime());
+    emit(perimeterHopsSignal, (long)gpsrOption->getPerimeterHopCount());
+}
+
+void QueueGpsr::recordPathStatistics(const GpsrOption *gpsrOption)
+{
+    // a packet delivered in perimeter mode ends its recovery here
+    if (gpsrOption->getRoutingMode() == GPSR_PERIMETER_ROUTING)
+        recordRecoveryEnd(gpsrOption);
+    emit(hopCountSignal, (long)gpsrOption->getHopCount());
+    const Coord& sourcePosition = gpsrOption->getSourcePosition();
+    double distance = sourcePosition.isUnspecified() ? 0 : sourcePosition.distance(mobility->getCurrentPosition());
+    if (distance > 0)
+        emit(pathStretchSignal, gpsrOption->getPathLength() / distance);
+}
+
+//
+// store-carry-forward
+//
+
+void QueueGpsr::carryDatagram(Packet *datagram, GpsrOption *gpsrOption)
+{
+    if ((int)carriedDatagrams.size() >= storeCarryForwardCapacity) {
+        EV_WARN << "Store-carry-forward buffer full, dropping oldest packet" << endl;
+        Packet *oldest = carriedDatagrams.front().datagram;
+        carriedDatagrams.pop_front();
+        carriedPacketsEvicted++;
+        networkProtocol->dropQueuedDatagram(oldest);
+    }
+    // the face traversal that failed here is meaningless once the node has moved: retries start over in greedy mode
+    clearPerimeterState(gpsrOption);
+    const Coord& destinationPosition = gpsrOption->getDestinationPosition();
+    double distance = destinationPosition.isUnspecified() ? std::numeric_limits<double>::infinity() : mobility->getCurrentPosition().distance(destinationPosition);
+    carriedDatagrams.push_back(CarriedDatagram { datagram, simTime(), distance });
+    carriedPackets++;
+    if (displayBubbles && hasGUI())
+        getContainingNode(host)->bubble("No next hop found, carrying packet");
+    if (!storeCarryForwardTimer->isScheduled())
+        scheduleAt(simTime() + storeCarryForwardCheckInterval, storeCarryForwardTimer);
+}
+
+void QueueGpsr::processCarriedDatagrams(bool retryAll)
+{
+    Coord selfPosition = mobility->getCurrentPosition();
+    for (auto it = carriedDatagrams.begin(); it != carriedDatagrams.end();) {
+        Packet *datagram = it->datagram;
+        const auto& networkHeader = getNetworkProtocolHeader(datagram);
+        const L3Address& source = networkHeader->getSourceAddress();
+        const L3Address& destination = networkHeader->getDestinationAddress();
+        // KLUDGE this allows overwriting the GPSR option inside
+        auto gpsrOption = const_cast<GpsrOption *>(getGpsrOptionFromNetworkDatagram(networkHeader));
+        if (isTaskExpired(gpsrOption) || simTime() >= it->enqueueTime + storeCarryForwardTimeout) {
+            EV_WARN << "Carried packet expired, dropping: source = " << source << ", destination = " << destination
+                    << ", carried for " << simTime() - it->enqueueTime << " s" << endl;
+            if (isTaskExpired(gpsrOption)) {
+                tasksExpiredInNetwork++;
+                recordTaskDeadlineMiss(source, gpsrOption->getTaskId(), gpsrOption->getTaskChunkCount());
+            }
+            carriedPacketsExpired++;
+            it = carriedDatagrams.erase(it);
+            networkProtocol->dropQueuedDatagram(datagram);
+            continue;
+        }
+        if (!gpsrOption->getDestinationPosition().isUnspecified())
+            updateDestinationPosition(destination, gpsrOption);
+        const Coord& destinationPosition = gpsrOption->getDestinationPosition();
+        double distance = destinationPosition.isUnspecified() ? std::numeric_limits<double>::infinity() : selfPosition.distance(destinationPosition);
+        // without news from the neighbors only getting closer to the destination can create a next hop
+        if (!retryAll && !(distance < it->lastAttemptDistance)) {
+            ++it;
+            continue;
+        }
+        it->lastAttemptDistance = distance;
+        L3Address nextHop = findDatagramNextHop(source, destination, gpsrOption);
+        if (nextHop.isUnspecified()) {
+            clearPerimeterState(gpsrOption);
+            ++it;
+            continue;
+        }
+        EV_INFO << "Forwarding carried packet: source = " << source << ", destination = " << destination << ", nextHop: " << nextHop
+                << ", carried for " << simTime() - it->enqueueTime << " s" << endl;
+        setDatagramNextHop(datagram, gpsrOption, source, destination, nextHop);
+        emit(carryBufferingDelaySignal, simTime() - it->enqueueTime);
+        carriedPacketsForwarded++;
+        it = carriedDatagrams.erase(it);
+        networkProtocol->reinjectQueuedDatagram(datagram);
+    }
+}
+
+void QueueGpsr::processStoreCarryForwardTimer()
+{
+    processCarriedDatagrams(false);
+    if (!carriedDatagrams.empty())
+        scheduleAt(simTime() + storeCarryForwardCheckInterval, storeCarryForwardTimer);
+}
+
 void QueueGpsr::setGpsrOptionOnNetworkDatagram(Packet *packet, const Ptr<const NetworkHeaderBase>& networkHeader, GpsrOption *gpsrOption)
 {
     packet->trimFront();
@@ -1799,24 +3258,83 @@ GpsrOption *QueueGpsr::getGpsrOptionFromNetworkDatagramForUpdate(const Ptr<Netwo
 INetfilter::IHook::Result QueueGpsr::datagramPreRoutingHook(Packet *datagram)
 {
     Enter_Method("datagramPreRoutingHook");
+    HandlerProfiler::Scope profileScope(profiler, PROFILE_PRE_ROUTING_HOOK);
     const auto& networkHeader = getNetworkProtocolHeader(datagram);
     const L3Address& destination = networkHeader->getDestinationAddress();
-    if (destination.isMulticast() || destination.isBroadcast() || routingTable->isLocalAddress(destination))
+    if (destination.isMulticast() || destination.isBroadcast())
         return ACCEPT;
-    else {
-        // KLUDGE this allows overwriting the GPSR option inside
-        auto gpsrOption = const_cast<GpsrOption *>(getGpsrOptionFromNetworkDatagram(networkHeader));
-        return routeDatagram(datagram, gpsrOption);
+    // KLUDGE this allows overwriting the GPSR option inside
+    auto gpsrOption = const_cast<GpsrOption *>(findGpsrOptionInNetworkDatagram(networkHeader));
+    if (gpsrOption != nullptr && enableLinkDelayMeasurement)
+        measureLinkDelay(gpsrOption);
+    // Offloaded tasks targeting our CPU are processed before they are delivered or forwarded
+    if (gpsrOption != nullptr && isLocalTask(gpsrOption)) {
+        recordTrafficClassDelay(gpsrOption);
+        return queueLocalTask(datagram, gpsrOption);
+    }
+    if (routingTable->isLocalAddress(destination))
+        return ACCEPT;
+    if (gpsrOption == nullptr)
+        throw cRuntimeError("Gpsr option not found in datagram!");
+    return routeDatagram(datagram, gpsrOption);
+}
+
+INetfilter::IHook::Result QueueGpsr::datagramLocalInHook(Packet *datagram)
+{
+    Enter_Method("datagramLocalInHook");
+    HandlerProfiler::Scope profileScope(profiler, PROFILE_LOCAL_IN_HOOK);
+    const auto& networkHeader = getNetworkProtocolHeader(datagram);
+    const GpsrOption *gpsrOption = findGpsrOptionInNetworkDatagram(networkHeader);
+    if (gpsrOption != nullptr) {
+        recordFlowSequence(networkHeader->getSourceAddress(), gpsrOption);
+        recordPathStatistics(gpsrOption);
+        recordTrafficClassDelay(gpsrOption);
+    }
+    if (gpsrOption != nullptr && gpsrOption->getIsOffloadTask()) {
+        // The task is complete once the last of its chunks has been delivered
+        bool taskComplete = true;
+        if (gpsrOption->getTaskChunkCount() > 1) {
+            auto key = std::make_pair(networkHeader->getSourceAddress(), gpsrOption->getTaskId());
+            ReceivedTask& received = receivedTaskChunks[key];
+            if (received.chunks++ == 0) {
+                received.firstArrival = simTime();
+                scheduleTaskAssemblyTimer();
+            }
+            if (received.chunks < gpsrOption->getTaskChunkCount())
+                taskComplete = false;
+            else
+                receivedTaskChunks.erase(key);
+        }
+        if (taskComplete) {
+            // the last chunk decides: it arrives no earlier than the others
+            if (gpsrOption->getTaskDeadline() > 0 && isFirstTaskOutcome(networkHeader->getSourceAddress(), gpsrOption->getTaskId(), gpsrOption->getTaskChunkCount()))
+                recordTaskDeadlineOutcome(simTime() <= gpsrOption->getTaskDeadline());
+            simtime_t latency = simTime() - gpsrOption->getTaskCreationTime();
+            emit(taskCompletionLatencySignal, latency);
+            double estimate = gpsrOption->getTaskDelayEstimate();
+            if (std::isfinite(estimate)) {
+                emit(taskDelayEstimateSignal, estimate);
+                emit(taskDelayEstimationErrorSignal, latency.dbl() - estimate);
+                EV_INFO << "Task " << gpsrOption->getTaskId() << " from " << networkHeader->getSourceAddress()
+                        << " complete: target=" << gpsrOption->getOffloadTargetAddress() << ", estimated delay=" << estimate
+                        << "s, realized delay=" << latency << "s" << endl;
+            }
+        }
     }
+    return ACCEPT;
 }
 
 INetfilter::IHook::Result QueueGpsr::datagramLocalOutHook(Packet *packet)
 {
     Enter_Method("datagramLocalOutHook");
+    HandlerProfiler::Scope profileScope(profiler, PROFILE_LOCAL_OUT_HOOK);
     const auto& networkHeader = getNetworkProtocolHeader(packet);
     const L3Address& destination = networkHeader->getDestinationAddress();
     if (destination.isMulticast() || destination.isBroadcast() || routingTable->isLocalAddress(destination)) {
         return ACCEPT;
+    } else if (networkHeader->getProtocol() == &Protocol::manet) {
+        // location service messages are addressed to the next hop chosen by the service itself
+        return ACCEPT;
     } else {
         // Track local TX backlog: increment when packet enters routing
         if (enableQueueDelay) {
@@ -1824,7 +3342,19 @@ INetfilter::IHook::Result QueueGpsr::datagramLocalOutHook(Packet *packet)
         }
         
         GpsrOption *gpsrOption = createGpsrOption(networkHeader->getDestinationAddress());
+        gpsrOption->setFlowSequenceNumber(++flowSequenceNumbers[destination]);
+        if (enableOffloadDecisions && !assignOffloadTarget(packet, gpsrOption)) {
+            delete gpsrOption;
+            return DROP;
+        }
         setGpsrOptionOnNetworkDatagram(packet, networkHeader, gpsrOption);
+        if (isLocalTask(gpsrOption))
+            return queueLocalTask(packet, gpsrOption);
+        if (useHomeRegionLocationService) {
+            if (gpsrOption->getDestinationPosition().isUnspecified())
+                return lookupDestinationLocation(packet, destination);
+            locationCacheHits++;
+        }
         return routeDatagram(packet, gpsrOption);
     }
 }
@@ -1835,6 +3365,9 @@ INetfilter::IHook::Result QueueGpsr::datagramLocalOutHook(Packet *packet)
 
 void QueueGpsr::finish()
 {
+    if (decisionTrace.isOpen())
+        decisionTrace.close();
+
     // Record tiebreaker statistics
     recordScalar("tiebreakerActivations", tiebreakerActivations);
     recordScalar("greedySelections", greedySelections);
@@ -1842,28 +3375,271 @@ void QueueGpsr::finish()
         double tiebreakerRatio = (double)tiebreakerActivations / (double)greedySelections;
         recordScalar("tiebreakerRatio", tiebreakerRatio);
     }
+    if (maxNeighborRange >= 0)
+        recordScalar("predictedOutOfRangeCandidates", predictedOutOfRangeCandidates);
+    // Next hop stability and reordering
+    recordScalar("nextHopChanges", nextHopChanges);
+    if (enableStickyNextHop)
+        recordScalar("stickyNextHopHolds", stickyNextHopHolds);
+    recordScalar("reorderedPackets", reorderedPackets);
+    if (enableLinkDelayMeasurement)
+        recordScalar("linkDelaySamples", linkDelaySamples);
+    recordScalar("maxReorderDepth", maxReorderDepth);
+    if (useHomeRegionLocationService) {
+        recordScalar("locationCacheHits", locationCacheHits);
+        recordScalar("locationLookups", locationLookups);
+        recordScalar("locationLookupsResolved", locationLookupsResolved);
+        recordScalar("locationLookupsFailed", locationLookupsFailed);
+        recordScalar("locationUpdatesSent", locationUpdatesSent);
+        recordScalar("locationQueriesSent", locationQueriesSent);
+        if (locationQueriesSent > 0)
+            recordScalar("locationQueryBatchSize", (double)locationQuerySubjects / locationQueriesSent);
+        recordScalar("locationRepliesSent", locationRepliesSent);
+        recordScalar("locationMessagesLost", locationMessagesLost);
+        recordScalar("locationControlPacketsSent", locationControlPacketsSent);
+        recordScalar("locationControlBytesSent", locationControlBytesSent);
+        recordScalar("locationRegistrySize", (double)homeRegionRegistry.size());
+    }
+    // Recovery (perimeter routing)
+    recordScalar("recoveryEpisodes", recoveryEpisodes);
+    recordScalar("recoverySuccesses", recoverySuccesses);
+    recordScalar("recoveryFailures", recoveryFailures);
+    if (recoveryStrategy == RECOVERY_BOUNDED_FACE) {
+        recordScalar("recoveryReversals", recoveryReversals);
+        recordScalar("recoveryExpansions", recoveryExpansions);
+    }
+    if (recoveryStrategy == RECOVERY_PROJECTED_FACE)
+        recordScalar("recoveryPlaneSwitches", recoveryPlaneSwitches);
+    if (enableStoreCarryForward) {
+        recordScalar("carriedPackets", carriedPackets);
+        recordScalar("carriedPacketsForwarded", carriedPacketsForwarded);
+        recordScalar("carriedPacketsExpired", carriedPacketsExpired);
+        recordScalar("carriedPacketsEvicted", carriedPacketsEvicted);
+        recordScalar("carriedPacketsPending", (double)carriedDatagrams.size());
+        if (carriedPackets > 0)
+            recordScalar("carryForwardDeliveryRatio", (double)carriedPacketsForwarded / carriedPackets);
+    }
+    if (forwardingMode == GPSR_BACKPRESSURE_ROUTING) {
+        recordScalar("backpressureSelections", backpressureSelections);
+        recordScalar("backpressureFallbacks", backpressureFallbacks);
+    }
+    if (multipathMode != MULTIPATH_NONE) {
+        recordScalar("multipathDecisions", multipathDecisions);
+        if (multipathPerFlow)
+            recordScalar("multipathFlowReassignments", multipathFlowReassignments);
+    }
+    if (enableTrafficClasses) {
+        recordScalar("taskPacketsForwarded", classForwardedPackets[TRAFFIC_CLASS_TASK]);
+        recordScalar("resultPacketsForwarded", classForwardedPackets[TRAFFIC_CLASS_RESULT]);
+        recordScalar("bulkPacketsForwarded", classForwardedPackets[TRAFFIC_CLASS_BULK]);
+        recordScalar("lowestDelayOverrides", lowestDelayOverrides);
+    }
+    if (useOracleDiscovery)
+        recordScalar("oracleDiscoveryTicks", oracleDiscoveryTicks);
+    
+    // Handler profiling: this module, and the whole network once the last profiled module finishes
+    if (profiler.isEnabled()) {
+        recordProfileScalars(this, profiler);
+        networkProfiler.merge(profiler);
+        if (--numProfiledModules == 0) {
+            recordProfileScalars(getSimulation()->getSystemModule(), networkProfiler);
+            networkProfiler.configure(false, 0);
+        }
+    }
+    
+    // Deadline-aware scheduling statistics
+    recordScalar("tasksProcessed", tasksProcessed);
+    recordScalar("tasksDeadlineMet", tasksDeadlineMet);
+    recordScalar("tasksDeadlineMissed", tasksDeadlineMissed);
+    recordScalar("tasksExpiredInQueue", tasksExpiredInQueue);
+    recordScalar("tasksExpiredInNetwork", tasksExpiredInNetwork);
+    recordScalar("tasksRejectedAtSource", tasksRejectedAtSource);
+    long deadlineOutcomes = tasksDeadlineMet + tasksDeadlineMissed;
+    if (deadlineOutcomes > 0)
+        recordScalar("deadlineMissRatio", (double)tasksDeadlineMissed / (double)deadlineOutcomes);
+    if (taskChunks > 1)
+        recordScalar("taskAssemblyTimeouts", taskAssemblyTimeouts);
+    
+    // Result cache statistics
+    if (enableResultCache) {
+        recordScalar("resultCacheHits", resultCacheHits);
+        recordScalar("resultCacheMisses", resultCacheMisses);
+        recordScalar("resultCacheEvictions", resultCacheEvictions);
+        recordScalar("resultCacheCyclesSaved", resultCacheCyclesSaved);
+        long lookups = resultCacheHits + resultCacheMisses;
+        if (lookups > 0)
+            recordScalar("resultCacheHitRatio", (double)resultCacheHits / (double)lookups);
+    }
+}
+
+L3Address QueueGpsr::applyNextHopHysteresis(const L3Address& source, const L3Address& destination, const L3Address& candidate, const std::vector<L3Address>& neighborAddresses,
+                                            const std::vector<gpsrcore::Neighbor>& neighbors, const Coord& selfPosition, const Coord& destinationPosition)
+{
+    auto it = flowNextHops.find(std::make_pair(source, destination));
+    if (it == flowNextHops.end() || it->second == candidate)
+        return candidate;
+    const L3Address& current = it->second;
+    auto currentIt = std::find(neighborAddresses.begin(), neighborAddresses.end(), current);
+    auto candidateIt = std::find(neighborAddresses.begin(), neighborAddresses.end(), candidate);
+    if (currentIt == neighborAddresses.end()) {
+        EV_DETAIL << "Sticky next hop " << current << " unreachable, switching to " << candidate << endl;
+        return candidate;
+    }
+    gpsrcore::Params params = getCoreParams();
+    const gpsrcore::Neighbor& currentNeighbor = neighbors[currentIt - neighborAddresses.begin()];
+    bool stale = enableQueueDelay && (currentNeighbor.queueInfoAge < 0 || currentNeighbor.queueInfoAge > params.maxInfoAge);
+    double currentCost = gpsrcore::estimateProgressCost(params, toVec3(selfPosition), toVec3(destinationPosition), currentNeighbor);
+    double candidateCost = gpsrcore::estimateProgressCost(params, toVec3(selfPosition), toVec3(destinationPosition), neighbors[candidateIt - neighborAddresses.begin()]);
+    // a current hop without progress has infinite cost and is always replaced
+    if (!stale && candidateCost >= currentCost * (1 - stickyCostMargin)) {
+        stickyNextHopHolds++;
+        EV_DETAIL << "Keeping sticky next hop " << current << " (cost " << currentCost << " s/m) over " << candidate
+                  << " (cost " << candidateCost << " s/m)" << endl;
+        return current;
+    }
+    EV_DETAIL << "Switching sticky next hop " << current << " -> " << candidate << (stale ? " (stale queue information)" : "") << endl;
+    return candidate;
+}
+
+void QueueGpsr::recordFlowNextHop(const L3Address& source, const L3Address& destination, const L3Address& nextHop)
+{
+    auto flow = std::make_pair(source, destination);
+    auto it = flowNextHops.find(flow);
+    if (it == flowNextHops.end())
+        flowNextHops[flow] = nextHop;
+    else if (it->second != nextHop) {
+        nextHopChanges++;
+        it->second = nextHop;
+    }
+}
+
+void QueueGpsr::recordFlowSequence(const L3Address& source, const GpsrOption *gpsrOption)
+{
+    // A packet older than the newest one already delivered from its source arrived out of order;
+    // its depth is how many sequence numbers it fell behind
+    uint32_t sequenceNumber = gpsrOption->getFlowSequenceNumber();
+    if (sequenceNumber == 0)
+        return;
+    uint32_t& highest = highestReceivedSequence[source];
+    if (sequenceNumber > highest)
+        highest = sequenceNumber;
+    else if (sequenceNumber < highest) {
+        long depth = highest - sequenceNumber;
+        reorderedPackets++;
+        maxReorderDepth = std::max(maxReorderDepth, depth);
+        emit(reorderDepthSignal, depth);
+    }
+}
+
+L3Address QueueGpsr::selectMultipathNextHop(const L3Address& source, const L3Address& destination, const std::vector<L3Address>& neighborAddresses,
+                                            const std::vector<gpsrcore::Neighbor>& neighbors, const Coord& selfPosition, const Coord& destinationPosition)
+{
+    gpsrcore::Params params = getCoreParams();
+    std::vector<int> candidates = gpsrcore::findGreedyCandidateSet(params, toVec3(selfPosition), toVec3(destinationPosition), neighbors);
+    if (candidates.empty())
+        return L3Address();
+    if (candidates.size() == 1)
+        return neighborAddresses[candidates[0]];
+    multipathDecisions++;
+    
+    // Per flow: keep the relay while it stays in the candidate set, so that packets of a flow are not reordered
+    auto flow = std::make_pair(source, destination);
+    if (multipathPerFlow) {
+        auto it = multipathFlowNextHops.find(flow);
+        if (it != multipathFlowNextHops.end()) {
+            for (int candidate : candidates)
+                if (neighborAddresses[candidate] == it->second)
+                    return it->second;
+            multipathFlowReassignments++;
+        }
+    }
+    
+    std::vector<double> weights = gpsrcore::getLoadSpreadingWeights(params, toVec3(selfPosition), neighbors, candidates);
+    int selected;
+    if (multipathMode == MULTIPATH_WEIGHTED)
+        selected = gpsrcore::selectWeightedRandom(weights, uniform(0, 1));
+    else {
+        // deficits are kept per destination, for the current candidates only
+        std::map<L3Address, double>& destinationDeficits = multipathDeficits[destination];
+        std::vector<double> deficits;
+        for (int candidate : candidates)
+            deficits.push_back(destinationDeficits[neighborAddresses[candidate]]);
+        selected = gpsrcore::selectDeficitRoundRobin(weights, deficits);
+        destinationDeficits.clear();
+        for (size_t i = 0; i < candidates.size(); i++)
+            destinationDeficits[neighborAddresses[candidates[i]]] = deficits[i];
+    }
+    L3Address nextHop = neighborAddresses[candidates[selected]];
+    if (multipathPerFlow)
+        multipathFlowNextHops[flow] = nextHop;
+    EV_INFO << "Multipath: " << candidates.size() << " near-equal candidates, selected " << nextHop
+            << " (share " << weights[selected] << ")" << endl;
+    return nextHop;
+}
+
+void QueueGpsr::recordProfileScalars(cComponent *component, const HandlerProfiler& profiler)
+{
+    // Wall-clock times are inclusive: nested handlers (e.g. greedy routing inside a hook) are counted in both
+    for (int i = 0; i < profiler.getNumHandlers(); i++) {
+        const HandlerProfile& profile = profiler.getProfile(i);
+        if (profile.calls == 0)
+            continue;
+        std::string prefix = std::string("profile.") + profiledHandlerNames[i];
+        component->recordScalar((prefix + ".calls").c_str(), profile.calls);
+        component->recordScalar((prefix + ".totalTime").c_str(), profile.totalNs * 1e-9, "s");
+        component->recordScalar((prefix + ".meanTime").c_str(), profile.totalNs * 1e-9 / profile.calls, "s");
+        component->recordScalar((prefix + ".p50Time").c_str(), profile.getQuantileNs(0.5) * 1e-9, "s");
+        component->recordScalar((prefix + ".p99Time").c_str(), profile.getQuantileNs(0.99) * 1e-9, "s");
+        component->recordScalar((prefix + ".maxTime").c_str(), profile.maxNs * 1e-9, "s");
+    }
 }
 
 void QueueGpsr::handleStartOperation(LifecycleOperation *operation)
 {
     configureInterfaces();
     storeSelfPositionInGlobalRegistry();
+    if (restoreSnapshot)
+        loadSnapshot();
+    if (snapshotSaveTime >= simTime() && !snapshotTimer->isScheduled())
+        scheduleAt(snapshotSaveTime, snapshotTimer);
     scheduleBeaconTimer();
 }
 
 void QueueGpsr::handleStopOperation(LifecycleOperation *operation)
 {
     // TODO send a beacon to remove ourself from peers neighbor position table
-    neighborPositionTable.clear();
+    neighborStateService->clear();
+    measuredLinkDelays.clear();
+    if (useOracleDiscovery)
+        oracleIndex.remove(getSelfAddress());
     cancelEvent(beaconTimer);
     cancelEvent(purgeNeighborsTimer);
+    // the network layer flushes the datagrams it holds for us
+    carriedDatagrams.clear();
+    cancelEvent(storeCarryForwardTimer);
+    homeRegionRegistry.clear();
+    pendingLocationLookups.clear();
+    lastLocationUpdateTime = -1;
+    cancelEvent(locationQueryTimer);
+    clearTaskState();
 }
 
 void QueueGpsr::handleCrashOperation(LifecycleOperation *operation)
 {
-    neighborPositionTable.clear();
+    neighborStateService->clear();
+    measuredLinkDelays.clear();
+    if (useOracleDiscovery)
+        oracleIndex.remove(getSelfAddress());
     cancelEvent(beaconTimer);
     cancelEvent(purgeNeighborsTimer);
+    // the network layer flushes the datagrams it holds for us
+    carriedDatagrams.clear();
+    cancelEvent(storeCarryForwardTimer);
+    homeRegionRegistry.clear();
+    pendingLocationLookups.clear();
+    lastLocationUpdateTime = -1;
+    cancelEvent(locationQueryTimer);
+    clearTaskState();
 }
 
 //
@@ -8,6 +8,8 @@
 #ifndef __RESEARCHPROJECT_QUEUEGPSR_H
 #define __RESEARCHPROJECT_QUEUEGPSR_H
 
+#include <list>
+
 #include "inet/common/ModuleRefByPar.h"
 #include "inet/common/geometry/common/Coord.h"
 #include "inet/common/packet/Packet.h"
@@ -18,6 +20,12 @@
 #include "inet/networklayer/contract/IRoutingTable.h"
 #include "inet/routing/base/RoutingProtocolBase.h"
 #include "QueueGpsr_m.h"
+#include "DecisionTrace.h"
+#include "HandlerProfiler.h"
+#include "researchproject/routing/gpsrcore/GpsrCore.h"
+#include "researchproject/common/NeighborStateService.h"
+#include "researchproject/common/SpatialGridIndex.h"
+#include "researchproject/linklayer/queue/SojournFairQueue.h"
 #include "inet/routing/gpsr/PositionTable.h"
 #include "inet/transportlayer/udp/UdpHeader_m.h"
 
@@ -57,7 +65,75 @@ class QueueGpsr : public RoutingProtocolBase, public cListener, public Netfilter
     const char *outputInterface = nullptr;
     ModuleRefByPar<IRoutingTable> routingTable; // TODO delete when necessary functions are moved to interface table
     ModuleRefByPar<INetfilter> networkProtocol;
+    ModuleRefByPar<NeighborStateService> neighborStateService;  // neighbor table: written from beacons, read by routing and offloading
     PositionTable& globalPositionTable = SIMULATION_SHARED_VARIABLE(globalPositionTable); // KLUDGE implement position registry protocol
+    bool useGlobalLocationService = true;
+    mutable PositionTable localPositionTable; // positions known to this node when locationService = "local" or "homeRegion"
+
+    // Home-region location service: positions are stored in the region the address hashes to and looked up on demand
+    struct LocationRecord {
+        Coord position;
+        Coord velocity;
+        simtime_t fixTime;
+    };
+    struct PendingLocationLookup {
+        std::vector<Packet *> datagrams;  // held by the network layer until the destination is located
+        simtime_t requestTime;
+        simtime_t querySendTime;
+        uint32_t queryId = 0;             // 0 until the lookup leaves in a query batch
+    };
+    bool useHomeRegionLocationService = false;
+    double homeRegionSize = 0;
+    int numHomeRegionColumns = 0;
+    int numHomeRegionRows = 0;
+    simtime_t locationUpdateInterval;
+    double locationUpdateDistance = 0;
+    simtime_t locationRegistryTimeout;
+    simtime_t locationCacheTimeout;
+    simtime_t locationQueryBatchDelay;
+    simtime_t locationQueryTimeout;
+    int locationMaxHops = 0;
+    cMessage *locationQueryTimer = nullptr;  // flushes query batches and expires unanswered lookups
+    std::map<L3Address, LocationRecord> homeRegionRegistry;  // subjects this node serves as a home region member
+    std::map<L3Address, PendingLocationLookup> pendingLocationLookups;  // destination -> lookup
+    simtime_t lastLocationUpdateTime = -1;
+    Coord lastLocationUpdatePosition;
+    uint32_t nextLocationQueryId = 0;
+    simsignal_t locationLookupLatencySignal;
+    long locationCacheHits = 0;
+    long locationLookups = 0;          // cache misses that started a lookup
+    long locationLookupsResolved = 0;
+    long locationLookupsFailed = 0;    // negative reply or timeout; the held datagrams are dropped
+    long locationUpdatesSent = 0;
+    long locationQueriesSent = 0;
+    long locationQuerySubjects = 0;    // lookups carried by the queries sent (batching)
+    long locationRepliesSent = 0;
+    long locationMessagesLost = 0;     // replies without a way towards the querier, messages over locationMaxHops
+    long locationControlPacketsSent = 0;  // including forwarded ones
+    long locationControlBytesSent = 0;
+
+    // Velocity-aware position extrapolation
+    struct MotionInfo {
+        Coord velocity;
+        simtime_t lastUpdate;  // time the associated position was valid
+    };
+    bool enablePositionExtrapolation = false;
+    simtime_t maxExtrapolationTime;
+    double maxNeighborRange = -1;  // m, negative = no range check
+    std::map<L3Address, MotionInfo>& globalLocationMotion = SIMULATION_SHARED_VARIABLE(globalLocationMotion); // KLUDGE, parallels globalPositionTable
+    mutable std::map<L3Address, MotionInfo> localLocationMotion;
+    mutable long predictedOutOfRangeCandidates = 0;
+
+    // Oracle neighbor discovery: neighbor state read from a simulation-wide index instead of beacons
+    struct OracleNodeState {
+        Ptr<const GpsrBeacon> state;  // what a beacon sent at publishTime would carry
+        simtime_t publishTime;
+    };
+    bool useOracleDiscovery = false;
+    simtime_t oracleDiscoveryInterval;
+    double oracleDiscoveryRange = 0;
+    SpatialGridIndex<L3Address, OracleNodeState>& oracleIndex = SIMULATION_SHARED_VARIABLE(oracleIndex); // KLUDGE, like globalPositionTable
+    long oracleDiscoveryTicks = 0;
 
     // packet size
     int positionByteLength = -1;
@@ -68,15 +144,23 @@ class QueueGpsr : public RoutingProtocolBase, public cListener, public Netfilter
     cMessage *queueMonitorTimer = nullptr;  // STEP 2 AUDIT: periodic queue monitoring
     cMessage *neighborTableDebugTimer = nullptr;  // STEP 4 AUDIT: one-shot neighbor table dump
     cMessage *preloadDurabilityTimer = nullptr;  // PRELOAD DURABILITY: monitor congested relay queue
-    PositionTable neighborPositionTable;
-    
-  // Phase 3: neighbor TX backlog with timestamp for aging
-  struct NeighborQueueInfo {
-      uint32_t bytes;
-      simtime_t lastUpdate;
-  };
-  std::map<L3Address, NeighborQueueInfo> neighborTxBacklogBytes;
+
   bool enableQueueDelay = false;
+  bool useSojournTime = false;  // queueDelayMetric = "sojourn"
+  SojournFairQueue *sojournQueue = nullptr;
+
+  // Measured link delay (enableLinkDelayMeasurement): one-hop delay from each sender to us, fed back in beacons
+  struct LinkDelayMeasurement {
+      double mean = 0;
+      double variance = 0;
+      simtime_t lastSample;
+  };
+  bool enableLinkDelayMeasurement = false;
+  double linkDelaySmoothing = 0.125;
+  double linkDelayDeviationWeight = 0;
+  simtime_t linkDelayMaxAge;
+  std::map<L3Address, LinkDelayMeasurement> measuredLinkDelays;
+  long linkDelaySamples = 0;
   
   // Local transmit backlog counter (UDP/IP level, avoids MAC queue API issues)
   mutable unsigned long localTxBacklogBytes = 0;
@@ -86,6 +170,76 @@ class QueueGpsr : public RoutingProtocolBase, public cListener, public Netfilter
     double distanceEqualityThreshold = 1.0;  // meters - when distances considered equal
     double delayEstimationFactor = 0.001;    // seconds per meter (simulated delay)
     
+    // Next hop stability (hysteresis) and reordering measurement
+    bool enableStickyNextHop = false;
+    double stickyCostMargin = 0;
+    std::map<std::pair<L3Address, L3Address>, L3Address> flowNextHops;  // (source, destination) -> last next hop used here
+    long nextHopChanges = 0;       // flaps: a flow forwarded to a different next hop than its previous packet
+    long stickyNextHopHolds = 0;   // decisions where hysteresis kept the previous next hop
+    std::map<L3Address, uint32_t> flowSequenceNumbers;        // destination -> last sequence number sent
+    std::map<L3Address, uint32_t> highestReceivedSequence;    // source -> highest sequence number delivered
+    simsignal_t reorderDepthSignal;
+    long reorderedPackets = 0;
+    long maxReorderDepth = 0;
+    
+    // Backpressure forwarding (queue differential weighted by progress)
+    GpsrForwardingMode forwardingMode = GPSR_GREEDY_ROUTING;  // mode of locally originated packets and after perimeter recovery
+    long backpressureSelections = 0;
+    long backpressureFallbacks = 0;     // hops decided by greedy for lack of a positive differential
+    
+    // Recovery strategy at greedy local minima
+    enum RecoveryStrategy { RECOVERY_FACE, RECOVERY_BOUNDED_FACE, RECOVERY_PROJECTED_FACE };
+    RecoveryStrategy recoveryStrategy = RECOVERY_FACE;
+    double recoveryInitialRadiusFactor = 0;
+    double recoveryRadiusGrowthFactor = 0;
+    simsignal_t perimeterDurationSignal;
+    simsignal_t perimeterHopsSignal;
+    simsignal_t hopCountSignal;
+    simsignal_t pathStretchSignal;
+    long recoveryEpisodes = 0;     // switches to perimeter mode here
+    long recoverySuccesses = 0;    // switches back to greedy (or deliveries in perimeter mode) here
+    long recoveryFailures = 0;     // perimeter routing found no next hop here
+    long recoveryReversals = 0;    // bounded face routing turned back at the circle
+    long recoveryExpansions = 0;   // bounded face routing enlarged the circle
+    long recoveryPlaneSwitches = 0; // projected face routing moved on to the next projection plane
+    
+    // Multipath load spreading among near-equal greedy candidates
+    enum MultipathMode { MULTIPATH_NONE, MULTIPATH_WEIGHTED, MULTIPATH_DRR };
+    MultipathMode multipathMode = MULTIPATH_NONE;
+    bool multipathPerFlow = false;
+    std::map<L3Address, std::map<L3Address, double>> multipathDeficits;  // destination -> candidate -> DRR deficit
+    std::map<std::pair<L3Address, L3Address>, L3Address> multipathFlowNextHops;  // (source, destination) -> relay
+    long multipathDecisions = 0;          // greedy decisions with more than one near-equal candidate
+    long multipathFlowReassignments = 0;  // flows moved because their relay left the candidate set
+    
+    // Traffic classes: per-class greedy policy, user priority and delay
+    enum TrafficClass { TRAFFIC_CLASS_TASK, TRAFFIC_CLASS_RESULT, TRAFFIC_CLASS_BULK, NUM_TRAFFIC_CLASSES };
+    enum ClassForwardingPolicy { CLASS_POLICY_GREEDY, CLASS_POLICY_LOWEST_DELAY };
+    bool enableTrafficClasses = false;
+    ClassForwardingPolicy classForwardingPolicies[NUM_TRAFFIC_CLASSES] = {};
+    int classUserPriorities[NUM_TRAFFIC_CLASSES] = {};
+    simsignal_t classDelaySignals[NUM_TRAFFIC_CLASSES];
+    long classForwardedPackets[NUM_TRAFFIC_CLASSES] = {};
+    long lowestDelayOverrides = 0;   // lowestDelay hops that differ from the greedy choice
+    
+    // Store-carry-forward of packets without a next hop (sparse/partitioned topologies)
+    bool enableStoreCarryForward = false;
+    int storeCarryForwardCapacity = 0;
+    simtime_t storeCarryForwardTimeout;
+    simtime_t storeCarryForwardCheckInterval;
+    cMessage *storeCarryForwardTimer = nullptr;
+    struct CarriedDatagram {
+        Packet *datagram;          // held by the network layer (QUEUE) until reinjected or dropped
+        simtime_t enqueueTime;
+        double lastAttemptDistance;  // self to destination at the last forwarding attempt
+    };
+    std::list<CarriedDatagram> carriedDatagrams;  // oldest first
+    simsignal_t carryBufferingDelaySignal;
+    long carriedPackets = 0;
+    long carriedPacketsForwarded = 0;
+    long carriedPacketsExpired = 0;     // carried longer than storeCarryForwardTimeout or past the task deadline
+    long carriedPacketsEvicted = 0;     // oldest packet dropped to make room in a full buffer
+    
     // Delay tiebreaker statistics
     simsignal_t tiebreakerActivationsSignal;
     long tiebreakerActivations = 0;
@@ -97,28 +251,119 @@ class QueueGpsr : public RoutingProtocolBase, public cListener, public Netfilter
     double offloadShareMax = 0;      // max fraction of CPU for offloading
     double cpuOffloadHz = 0;         // effective CPU capacity available for offloading (initialized randomly)
     double cpuOffloadBacklogCycles = 0;  // current backlog of offloaded work in CPU cycles
-    
-    // Neighbor CPU offload capacity tracking
-    struct NeighborCpuInfo {
-        double cpuOffloadHz;
-        double cpuOffloadBacklogCycles;
-        simtime_t lastUpdate;
-    };
-    std::map<L3Address, NeighborCpuInfo> neighborCpuCapacity;
 
     // Task model (Phase 5: offloading decisions)
     bool enableOffloadDecisions = false;  // enable local vs offload decision logic
+    bool enableOffloadPipelineEstimate = false;  // decisions estimate transfer, processing and delivery of the result
     int taskInputBits = 0;                // task input size in bits
     double taskCyclesPerBit = 0;          // computational complexity (cycles per bit)
     double reductionFactor = 0.1;         // output/input size ratio after processing (0.1 = 10x reduction)
     
     // Processing task tracking
     struct ProcessingTask {
-        Packet *packet;
+        std::vector<Packet *> packets;  // datagrams carrying the input (several when a whole multi-chunk task is processed)
         double processingTimeSeconds;
         int originalSizeBits;
+        double cycles;          // CPU cycles charged to the offload backlog
+        simtime_t deadline;     // absolute deadline (0 = none)
+        simtime_t enqueueTime;  // time the task entered the CPU queue
+    };
+    std::map<cMessage*, ProcessingTask> pendingProcessingTasks;  // self-messages -> task in service
+
+    // Deadline-aware scheduling: single-server CPU with a ready queue ordered by scheduling key
+    enum CpuSchedulingPolicy { CPU_SCHEDULING_FIFO, CPU_SCHEDULING_EDF };
+    CpuSchedulingPolicy cpuSchedulingPolicy = CPU_SCHEDULING_EDF;
+    simtime_t taskDeadline;                                  // relative deadline assigned at the task source
+    std::multimap<simtime_t, ProcessingTask> cpuReadyQueue;  // key = deadline (EDF) or enqueue time (FIFO)
+    simsignal_t taskDeadlineMissedSignal;
+    simsignal_t taskQueueingTimeSignal;
+    long tasksProcessed = 0;
+    long tasksDeadlineMet = 0;         // deadline outcomes are counted per task, not per chunk
+    long tasksDeadlineMissed = 0;
+    long tasksExpiredInQueue = 0;      // dropped by the CPU before wasting cycles
+    long tasksExpiredInNetwork = 0;    // dropped by a relay before wasting airtime
+    long tasksRejectedAtSource = 0;    // no local or remote option could meet the deadline
+
+    // Content-hash result cache (LRU, bounded by result bytes)
+    struct ResultCacheEntry {
+        int resultBits;
+        std::list<uint64_t>::iterator lruPosition;
+    };
+    bool enableResultCache = false;
+    long resultCacheCapacityBytes = 0;
+    int taskContentPoolSize = 0;
+    std::map<uint64_t, ResultCacheEntry> resultCache;
+    std::list<uint64_t> resultCacheLru;  // most recently used first
+    long resultCacheBytes = 0;
+    long resultCacheHits = 0;
+    long resultCacheMisses = 0;
+    long resultCacheEvictions = 0;
+    double resultCacheCyclesSaved = 0;
+
+    // Streaming (cut-through) processing of multi-chunk task inputs
+    bool enableStreamingProcessing = false;
+    int taskChunks = 1;
+    simtime_t taskAssemblyTimeout;
+    cMessage *taskAssemblyTimer = nullptr;
+    struct TaskAssembly {
+        std::vector<Packet *> chunks;  // held by the network layer until the input is complete
+        int expectedChunks = 0;
+        int totalBits = 0;
+        simtime_t firstArrival;
+        simtime_t deadline;  // absolute deadline of the task (0 = none)
     };
-    std::map<cMessage*, ProcessingTask> pendingProcessingTasks;  // self-messages -> task info
+    std::map<std::pair<L3Address, uint64_t>, TaskAssembly> taskAssemblies;  // (source, taskId) -> partial input
+    struct SourceTaskState {
+        uint64_t taskId = 0;
+        int nextChunkIndex = 0;
+        L3Address target;
+        simtime_t deadline;
+        simtime_t creationTime;
+        double delayEstimate = 0;  // estimated delay of the chosen option (offload target or local)
+        uint64_t contentId = 0;
+        bool rejected = false;
+    };
+    std::map<L3Address, SourceTaskState> sourceTasks;  // destination -> task whose chunks are being emitted
+    uint64_t nextTaskId = 0;
+    struct ReceivedTask {
+        int chunks = 0;
+        simtime_t firstArrival;
+    };
+    std::map<std::pair<L3Address, uint64_t>, ReceivedTask> receivedTaskChunks;  // (source, taskId) -> chunks delivered here
+    std::map<std::pair<L3Address, uint64_t>, simtime_t> expiredStreamedTasks;  // (source, taskId) -> first dropped chunk
+    std::map<std::pair<L3Address, uint64_t>, simtime_t> taskOutcomes;  // (source, taskId) -> time the deadline outcome of a multi-chunk task was recorded
+    simsignal_t taskCompletionLatencySignal;
+    simsignal_t taskDelayEstimateSignal;
+    simsignal_t linkDelaySignal;
+    simsignal_t taskDelayEstimationErrorSignal;
+    long taskAssemblyTimeouts = 0;
+
+    // Warm-start snapshots of converged neighbor state
+    std::string snapshotDir;
+    simtime_t snapshotSaveTime;
+    bool restoreSnapshot = false;
+    cMessage *snapshotTimer = nullptr;
+
+    // Decision trace recording (offline policy evaluation)
+    DecisionTraceWriter decisionTrace;
+
+    // Wall-clock profiling of the handlers (enableProfiling)
+    enum ProfiledHandler {
+        PROFILE_PRE_ROUTING_HOOK,
+        PROFILE_LOCAL_IN_HOOK,
+        PROFILE_LOCAL_OUT_HOOK,
+        PROFILE_PROCESS_BEACON,
+        PROFILE_ORACLE_DISCOVERY,
+        PROFILE_GREEDY_NEXT_HOP,
+        PROFILE_PERIMETER_NEXT_HOP,  // includes the planarization (getPlanarNeighbors)
+        PROFILE_LOCAL_TX_BACKLOG,
+        PROFILE_COMPLETE_TASK_PROCESSING,
+        NUM_PROFILED_HANDLERS
+    };
+    static const char *profiledHandlerNames[NUM_PROFILED_HANDLERS];
+    mutable HandlerProfiler profiler;
+    HandlerProfiler& networkProfiler = SIMULATION_SHARED_VARIABLE(networkProfiler); // merged in finish()
+    int& numProfiledModules = SIMULATION_SHARED_VARIABLE(numProfiledModules);
 
   public:
     QueueGpsr();
@@ -160,6 +405,12 @@ class QueueGpsr : public RoutingProtocolBase, public cListener, public Netfilter
     const Ptr<GpsrBeacon> createBeacon();
     void sendBeacon(const Ptr<GpsrBeacon>& beacon);
     void processBeacon(Packet *packet);
+    void storeNeighborState(const GpsrBeacon& beacon, simtime_t time);
+    void setLinkDelayFeedback(GpsrBeacon *beacon) const;
+    void measureLinkDelay(const GpsrOption *gpsrOption);
+
+    // oracle neighbor discovery
+    void processOracleDiscovery();
 
     // handling packets
     GpsrOption *createGpsrOption(L3Address destination);
@@ -179,14 +430,34 @@ class QueueGpsr : public RoutingProtocolBase, public cListener, public Netfilter
 
     // position
     Coord lookupPositionInGlobalRegistry(const L3Address& address) const;
-    void storePositionInGlobalRegistry(const L3Address& address, const Coord& position) const;
+    void storePositionInGlobalRegistry(const L3Address& address, const Coord& position, const Coord& velocity = Coord::ZERO) const;
     void storeSelfPositionInGlobalRegistry() const;
-    Coord computeIntersectionInsideLineSegments(Coord& begin1, Coord& end1, Coord& begin2, Coord& end2) const;
+    PositionTable& getLocationTable() const;
+    std::map<L3Address, MotionInfo>& getLocationMotion() const;
     Coord getNeighborPosition(const L3Address& address) const;
-
-    // angle
-    double getVectorAngle(Coord vector) const;
-    double getNeighborAngle(const L3Address& address) const;
+    void updateDestinationPosition(const L3Address& destination, GpsrOption *gpsrOption) const;
+    std::vector<L3Address> getCandidateNeighborAddresses(bool countDrops = true) const;
+    void setDestinationLocation(GpsrOption *gpsrOption, const L3Address& destination) const;
+
+    // home-region location service
+    int getHomeRegionIndex(const L3Address& address) const;
+    Coord getHomeRegionCenter(int index) const;
+    bool isInHomeRegion(const Coord& position, const Coord& center) const;
+    L3Address findLocationNextHop(const Coord& targetPosition) const;
+    B computeLocationMessageLength(const LocationMessage *message) const;
+    void sendLocationMessage(const Ptr<LocationMessage>& message, const L3Address& nextHop);
+    void forwardLocationMessage(const Ptr<const LocationMessage>& message, const L3Address& nextHop);
+    void sendLocationUpdateIfDue();
+    Result lookupDestinationLocation(Packet *datagram, const L3Address& destination);
+    void processLocationQueryTimer();
+    void processLocationMessage(Packet *packet);
+    void handleLocationMessage(const Ptr<const LocationMessage>& message);
+    void processLocationUpdate(const Ptr<const LocationMessage>& message);
+    void processLocationQuery(const Ptr<const LocationMessage>& message);
+    void processLocationReply(const Ptr<const LocationMessage>& message);
+
+    // profiling
+    static void recordProfileScalars(cComponent *component, const HandlerProfiler& profiler);
 
     // address
     std::string getHostName() const;
@@ -196,39 +467,95 @@ class QueueGpsr : public RoutingProtocolBase, public cListener, public Netfilter
     // neighbor
     simtime_t getNextNeighborExpiration();
     void purgeNeighbors();
-    std::vector<L3Address> getPlanarNeighbors() const;
-    std::vector<L3Address> getPlanarNeighborsCounterClockwise(double startAngle) const;
+
+    // Routing core adapters: plain data views of the neighbor table for gpsrcore
+    gpsrcore::Params getCoreParams() const;
+    gpsrcore::Neighbor getCoreNeighbor(const L3Address& address) const;
+    std::vector<gpsrcore::Neighbor> getCoreNeighbors(const std::vector<L3Address>& addresses) const;
     
     // Delay tiebreaker helper (Phase 2/3)
     double estimateNeighborDelay(const L3Address& address) const;
   // Phase 3 helper: read local TX backlog bytes from MAC queue
   unsigned long getLocalTxBacklogBytes() const;
+  SojournFairQueue *findSojournQueue() const;
+  double getLocalTxBitrate() const;
+  double getLocalQueueDelay() const;
 
     // Offload decision helpers (Phase 5)
     double estimateLocalProcessingTime(int taskBits) const;
     double estimateRemoteProcessingTime(const L3Address& neighbor, int taskBits) const;
     double estimateOffloadTotalDelay(const L3Address& neighbor, int taskBits) const;
     void logOffloadDecisionEstimates(const std::vector<L3Address>& candidates, int taskBits) const;
-    L3Address makeOffloadDecision(const std::vector<L3Address>& candidates, int taskBits, bool& shouldOffload);
+    L3Address makeOffloadDecision(const std::vector<L3Address>& candidates, int taskBits, simtime_t deadline, const Coord& destinationPosition,
+                                  bool& shouldOffload, double& delayEstimate);
+    double estimateLocalTaskDelay(int taskBits) const;
+    bool assignOffloadTarget(Packet *datagram, GpsrOption *gpsrOption);
+    bool isLocalTask(const GpsrOption *gpsrOption) const;
+    TrafficClass getTrafficClass(const GpsrOption *gpsrOption) const;
+    ClassForwardingPolicy parseClassForwardingPolicy(const char *parameterName);
+    void recordTrafficClassDelay(const GpsrOption *gpsrOption);
+    Result queueLocalTask(Packet *datagram, GpsrOption *gpsrOption);
+    Result bufferTaskChunk(Packet *datagram, GpsrOption *gpsrOption);
+    void scheduleTaskAssemblyTimer();
+    void processTaskAssemblyTimer();
+    void countExpiredTask(Packet *datagram);
     void scheduleTaskProcessing(Packet *packet, double processingTimeSeconds);
+    void scheduleTaskProcessing(const std::vector<Packet *>& packets, double processingTimeSeconds);
+    void startNextTaskProcessing();
     void completeTaskProcessing(cMessage *processingCompleteMsg);
+    void clearTaskState();
+    void resumeQueuedDatagram(Packet *datagram);
+    void carryDatagram(Packet *datagram, GpsrOption *gpsrOption);
+    void processCarriedDatagrams(bool retryAll);
+    void processStoreCarryForwardTimer();
+    bool isTaskExpired(const GpsrOption *gpsrOption) const;
+    void recordTaskDeadlineOutcome(bool met);
+    bool isFirstTaskOutcome(const L3Address& source, uint64_t taskId, int chunkCount);
+    void recordTaskDeadlineMiss(const L3Address& source, uint64_t taskId, int chunkCount);
+
+    // Result cache helpers
+    uint64_t getResultCacheKey(const GpsrOption *gpsrOption) const;
+    bool lookupResultCache(uint64_t contentId, int& resultBits);
+    void insertResultCache(uint64_t contentId, int resultBits);
+    double getAdvertisedCpuOffloadHz() const;
+
+    // Decision trace helpers
+    void openDecisionTrace();
+    void recordDecision(DecisionRecord& record, const Coord& destinationPosition);
+
+    // Warm-start snapshot helpers
+    std::string getSnapshotFileName() const;
+    void saveSnapshot() const;
+    void loadSnapshot();
 
     // Diagnostic: enumerate MAC submodules and report which implement IPacketCollection
     void auditMacQueues() const;
 
     // next hop
-    L3Address findNextHop(const L3Address& destination, GpsrOption *gpsrOption);
-    L3Address findGreedyRoutingNextHop(const L3Address& destination, GpsrOption *gpsrOption);
-    L3Address findPerimeterRoutingNextHop(const L3Address& destination, GpsrOption *gpsrOption);
+    L3Address findNextHop(const L3Address& source, const L3Address& destination, GpsrOption *gpsrOption);
+    L3Address findGreedyRoutingNextHop(const L3Address& source, const L3Address& destination, GpsrOption *gpsrOption);
+    L3Address findPerimeterRoutingNextHop(const L3Address& source, const L3Address& destination, GpsrOption *gpsrOption);
+    L3Address findBackpressureRoutingNextHop(const L3Address& source, const L3Address& destination, GpsrOption *gpsrOption);
+    L3Address applyNextHopHysteresis(const L3Address& source, const L3Address& destination, const L3Address& candidate, const std::vector<L3Address>& neighborAddresses,
+                                     const std::vector<gpsrcore::Neighbor>& neighbors, const Coord& selfPosition, const Coord& destinationPosition);
+    void recordFlowNextHop(const L3Address& source, const L3Address& destination, const L3Address& nextHop);
+    void recordFlowSequence(const L3Address& source, const GpsrOption *gpsrOption);
+    L3Address selectMultipathNextHop(const L3Address& source, const L3Address& destination, const std::vector<L3Address>& neighborAddresses,
+                                     const std::vector<gpsrcore::Neighbor>& neighbors, const Coord& selfPosition, const Coord& destinationPosition);
 
     // routing
     Result routeDatagram(Packet *datagram, GpsrOption *gpsrOption);
+    L3Address findDatagramNextHop(const L3Address& source, const L3Address& destination, GpsrOption *gpsrOption);
+    void setDatagramNextHop(Packet *datagram, GpsrOption *gpsrOption, const L3Address& source, const L3Address& destination, const L3Address& nextHop);
+    void clearPerimeterState(GpsrOption *gpsrOption);
+    void recordRecoveryEnd(const GpsrOption *gpsrOption);
+    void recordPathStatistics(const GpsrOption *gpsrOption);
 
     // netfilter
     virtual Result datagramPreRoutingHook(Packet *datagram) override;
     virtual Result datagramForwardHook(Packet *datagram) override { return ACCEPT; }
     virtual Result datagramPostRoutingHook(Packet *datagram) override { return ACCEPT; }
-    virtual Result datagramLocalInHook(Packet *datagram) override { return ACCEPT; }
+    virtual Result datagramLocalInHook(Packet *datagram) override;
     virtual Result datagramLocalOutHook(Packet *datagram) override;
 
     // lifecycle
@@ -0,0 +1,213 @@
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+//
+// Benchmark of the greedy candidate scoring kernel.
+//
+// Generates random neighborhoods (uniform in a disc of the radio range around
+// the node, destination far away, random backlogs) and compares, per
+// neighborhood size:
+//   - the vectorized scoring kernel against its scalar path (time per
+//     candidate, largest difference of the scores),
+//   - the greedy decision: the original per-neighbor loop of QueueGpsr,
+//     gpsrcore::findGreedyNextHop on a neighbor array, and on a prebuilt
+//     CandidateBatch (time per decision, agreement of the next hop).
+//
+// Usage: candidatebench [-n size,size,...] [-r decisions] [-s seed]
+//
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "CandidateScoring.h"
+
+using namespace researchproject::gpsrcore;
+
+namespace {
+
+struct Scenario {
+    Vec3 self;
+    Vec3 destination;
+    std::vector<Neighbor> neighbors;
+};
+
+Scenario makeScenario(std::mt19937_64& rng, size_t size, const Params& params)
+{
+    std::uniform_real_distribution<double> unit(0, 1);
+    const double range = 250;
+    Scenario scenario;
+    scenario.self = Vec3(1000 * unit(rng), 1000 * unit(rng), 0);
+    double angle = 2 * M_PI * unit(rng);
+    scenario.destination = scenario.self + Vec3(2000 * std::cos(angle), 2000 * std::sin(angle), 0);
+    for (size_t i = 0; i < size; i++) {
+        Neighbor neighbor;
+        double r = range * std::sqrt(unit(rng)), a = 2 * M_PI * unit(rng);
+        neighbor.id = i + 1;
+        neighbor.position = scenario.self + Vec3(r * std::cos(a), r * std::sin(a), 0);
+        // every fourth neighbor duplicates the distance of the previous one to exercise the tiebreaker
+        if (i % 4 == 3)
+            neighbor.position = scenario.neighbors.back().position + Vec3(0.1 * unit(rng), 0, 0);
+        neighbor.backlogBytes = std::floor(20000 * unit(rng));
+        neighbor.txBitrate = 2e6;
+        neighbor.queueInfoAge = params.maxInfoAge * 1.5 * unit(rng);
+        scenario.neighbors.push_back(neighbor);
+    }
+    return scenario;
+}
+
+// QueueGpsr::findGreedyRoutingNextHop before the batch kernel: one neighbor at a time, delays on demand
+int referenceGreedy(const Params& params, const Scenario& s)
+{
+    double bestDistance = s.destination.distance(s.self);
+    double bestDelay = INFINITY;
+    int best = NO_NEIGHBOR;
+    for (size_t i = 0; i < s.neighbors.size(); i++) {
+        double neighborDistance = s.destination.distance(s.neighbors[i].position);
+        if (params.enableDelayTiebreaker && neighborDistance < bestDistance) {
+            bestDistance = neighborDistance;
+            best = i;
+            bestDelay = estimateNeighborDelay(params, s.self, s.neighbors[i]);
+        }
+        else if (params.enableDelayTiebreaker && best != NO_NEIGHBOR && std::fabs(neighborDistance - bestDistance) < params.distanceEqualityThreshold) {
+            double neighborDelay = estimateNeighborDelay(params, s.self, s.neighbors[i]);
+            if (neighborDelay < bestDelay) {
+                bestDistance = neighborDistance;
+                best = i;
+                bestDelay = neighborDelay;
+            }
+        }
+        else if (!params.enableDelayTiebreaker && neighborDistance < bestDistance) {
+            bestDistance = neighborDistance;
+            best = i;
+        }
+    }
+    return best;
+}
+
+template <typename F>
+double timeNs(long repetitions, F f)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (long r = 0; r < repetitions; r++)
+        f(r);
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+}
+
+double maxDifference(const std::vector<double>& a, const std::vector<double>& b)
+{
+    double difference = 0;
+    for (size_t i = 0; i < a.size(); i++)
+        if (!(std::isinf(a[i]) && std::isinf(b[i])))
+            difference = std::max(difference, std::fabs(a[i] - b[i]));
+    return difference;
+}
+
+std::vector<size_t> parseSizes(const std::string& text)
+{
+    std::vector<size_t> sizes;
+    std::stringstream stream(text);
+    std::string part;
+    while (std::getline(stream, part, ','))
+        if (!part.empty())
+            sizes.push_back(std::max(1, std::atoi(part.c_str())));
+    return sizes;
+}
+
+void usage()
+{
+    std::fprintf(stderr,
+            "Usage: candidatebench [options]\n"
+            "  -n <list>   comma-separated neighborhood sizes (default: 4,8,16,32,64,128,256,1024)\n"
+            "  -r <n>      decisions per size (default: 200000)\n"
+            "  -s <seed>   random seed (default: 1)\n");
+    std::exit(1);
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    std::vector<size_t> sizes = { 4, 8, 16, 32, 64, 128, 256, 1024 };
+    long decisions = 200000;
+    unsigned long seed = 1;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "-n" && i + 1 < argc)
+            sizes = parseSizes(argv[++i]);
+        else if (arg == "-r" && i + 1 < argc)
+            decisions = std::max(1L, std::atol(argv[++i]));
+        else if (arg == "-s" && i + 1 < argc)
+            seed = std::strtoul(argv[++i], nullptr, 10);
+        else
+            usage();
+    }
+
+    Params params;
+    params.enableDelayTiebreaker = true;
+    params.enableQueueDelay = true;
+    params.distanceEqualityThreshold = 1;
+    params.delayEstimationFactor = 0.001;
+    params.maxInfoAge = 3;
+
+    std::printf("scoring kernel: %s\n\n", getCandidateScoringIsa());
+    std::printf("%8s | %12s %12s %8s %10s | %13s %13s %14s %9s\n", "size", "scalar[ns/c]", "simd[ns/c]", "speedup", "maxDiff",
+            "loop[ns/dec]", "span[ns/dec]", "batch[ns/dec]", "agree%");
+    std::mt19937_64 rng(seed);
+    for (size_t size : sizes) {
+        // a pool of scenarios, cycled through, so that the data does not stay in registers
+        const size_t poolSize = 64;
+        std::vector<Scenario> pool;
+        std::vector<CandidateBatch> batches(poolSize);
+        for (size_t p = 0; p < poolSize; p++) {
+            pool.push_back(makeScenario(rng, size, params));
+            batches[p].assign(params, pool[p].neighbors);
+        }
+        CandidateScores scalarScores, simdScores;
+        double maxDiff = 0;
+        for (size_t p = 0; p < poolSize; p++) {
+            scoreCandidatesScalar(pool[p].self, pool[p].destination, params.delayEstimationFactor, batches[p], scalarScores);
+            scoreCandidates(pool[p].self, pool[p].destination, params.delayEstimationFactor, batches[p], simdScores);
+            maxDiff = std::max({ maxDiff, maxDifference(scalarScores.distance, simdScores.distance),
+                                 maxDifference(scalarScores.delay, simdScores.delay), maxDifference(scalarScores.cost, simdScores.cost) });
+        }
+        long kernelRepetitions = std::max(1L, decisions * 16 / (long)size);
+        double sink = 0;
+        double scalarNs = timeNs(kernelRepetitions, [&](long r) {
+            const Scenario& s = pool[r % poolSize];
+            scoreCandidatesScalar(s.self, s.destination, params.delayEstimationFactor, batches[r % poolSize], scalarScores);
+            sink += scalarScores.cost[0];
+        });
+        double simdNs = timeNs(kernelRepetitions, [&](long r) {
+            const Scenario& s = pool[r % poolSize];
+            scoreCandidates(s.self, s.destination, params.delayEstimationFactor, batches[r % poolSize], simdScores);
+            sink += simdScores.cost[0];
+        });
+        long agreements = 0;
+        for (size_t p = 0; p < poolSize; p++) {
+            int reference = referenceGreedy(params, pool[p]);
+            agreements += reference == findGreedyNextHop(params, pool[p].self, pool[p].destination, pool[p].neighbors).nextHop &&
+                          reference == findGreedyNextHop(params, pool[p].self, pool[p].destination, batches[p], simdScores).nextHop;
+        }
+        double loopNs = timeNs(decisions, [&](long r) { sink += referenceGreedy(params, pool[r % poolSize]); });
+        double coreNs = timeNs(decisions, [&](long r) {
+            const Scenario& s = pool[r % poolSize];
+            sink += findGreedyNextHop(params, s.self, s.destination, s.neighbors).nextHop;
+        });
+        double batchNs = timeNs(decisions, [&](long r) {
+            const Scenario& s = pool[r % poolSize];
+            sink += findGreedyNextHop(params, s.self, s.destination, batches[r % poolSize], simdScores).nextHop;
+        });
+        double candidates = (double)kernelRepetitions * size;
+        std::printf("%8zu | %12.3f %12.3f %8.2f %10.3g | %13.1f %13.1f %14.1f %9.2f\n", size, scalarNs / candidates, simdNs / candidates,
+                scalarNs / simdNs, maxDiff, loopNs / decisions, coreNs / decisions, batchNs / decisions, 100.0 * agreements / poolSize);
+        if (sink == 42.4242)
+            std::printf(" ");  // keeps the timed work observable
+    }
+    return 0;
+}
@@ -0,0 +1,302 @@
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+//
+// Fuzz target of the framework-independent GPSR routing core.
+//
+// Each input is decoded into a node position, a destination, routing
+// parameters and a neighbor table, which are then run through planarization,
+// greedy and face routing (plain, bounded and projected), load spreading,
+// backpressure, the candidate scoring kernel and the offload decision. The
+// target checks the invariants the callers in QueueGpsr rely on: returned
+// neighbor indices are valid, greedy next hops make progress, the vectorized
+// scores equal the scalar estimators and the batch greedy selection equals
+// the NeighborSpan one.
+//
+// Coordinates are decoded on a coarse grid, so coincident and collinear
+// nodes - the corner cases of the angle ordering and of the segment
+// intersection tests - are common.
+//
+// Built with libFuzzer (make libfuzzer) it is a regular fuzz target. The
+// default build adds a standalone driver instead:
+//
+//   corefuzz [file|directory ...]    run the given inputs
+//   corefuzz -runs=N -seed=S          run N random inputs (default 100000)
+//
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+#include "CandidateScoring.h"
+#include "GpsrCore.h"
+
+using namespace researchproject::gpsrcore;
+
+namespace {
+
+// Reads values from the fuzzer input; reads past the end return zeros
+class InputReader
+{
+  private:
+    const uint8_t *data;
+    size_t size;
+    size_t offset = 0;
+
+  public:
+    InputReader(const uint8_t *data, size_t size) : data(data), size(size) {}
+
+    bool empty() const { return offset >= size; }
+    uint8_t byte() { return offset < size ? data[offset++] : 0; }
+    uint16_t word() { uint16_t high = byte(); return (high << 8) | byte(); }
+    bool flag() { return byte() & 1; }
+    // [0, max] in 256 steps
+    double fraction(double max) { return byte() * max / 255; }
+    // [-512, 508] m on a 4 m grid
+    double coordinate() { return ((int)byte() - 128) * 4.0; }
+    Vec3 position(bool threeDimensional) { Vec3 p(coordinate(), coordinate(), 0); if (threeDimensional) p.z = coordinate(); return p; }
+};
+
+// Input being run by the standalone driver (libFuzzer saves failing inputs itself)
+const std::vector<uint8_t> *standaloneInput = nullptr;
+
+void fail(const char *message, int detail)
+{
+    std::fprintf(stderr, "corefuzz: invariant violated: %s (%d)\n", message, detail);
+    if (standaloneInput != nullptr) {
+        if (FILE *file = std::fopen("corefuzz-crash.bin", "wb")) {
+            std::fwrite(standaloneInput->data(), 1, standaloneInput->size(), file);
+            std::fclose(file);
+            std::fprintf(stderr, "corefuzz: input written to corefuzz-crash.bin\n");
+        }
+    }
+    std::abort();
+}
+
+void checkIndex(int index, size_t size, const char *what)
+{
+    if (index != NO_NEIGHBOR && (index < 0 || (size_t)index >= size))
+        fail(what, index);
+}
+
+void checkPerimeterResult(const PerimeterResult& result, size_t size, const char *what)
+{
+    if (result.outcome == PerimeterResult::NEXT_HOP) {
+        if (result.nextHop == NO_NEIGHBOR)
+            fail(what, result.nextHop);
+        checkIndex(result.nextHop, size, what);
+    }
+}
+
+} // namespace
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    InputReader input(data, size);
+    bool threeDimensional = input.flag();
+    Params params;
+    uint8_t mode = input.byte();
+    params.planarization = (mode & 3) == 0 ? Planarization::NONE : (mode & 3) == 1 ? Planarization::GG : Planarization::RNG;
+    params.enableDelayTiebreaker = mode & 4;
+    params.enableQueueDelay = mode & 8;
+    params.offloadPipelineDelay = mode & 16;
+    params.measuredLinkDelay = mode & 32;
+    params.distanceEqualityThreshold = input.fraction(20);
+    params.delayEstimationFactor = input.fraction(0.01);
+    params.maxInfoAge = input.fraction(5);
+    params.taskCyclesPerBit = input.fraction(1000);
+    params.reductionFactor = input.fraction(1);
+    params.linkDelayDeviationWeight = input.fraction(4);
+    params.localQueueDelay = input.fraction(0.1);
+
+    Vec3 self = input.position(threeDimensional);
+    Vec3 destination = input.position(threeDimensional);
+    std::vector<Neighbor> neighbors;
+    size_t numNeighbors = input.byte() % 48;
+    for (size_t i = 0; i < numNeighbors && !input.empty(); i++) {
+        Neighbor neighbor;
+        neighbor.id = i + 2;  // self is 1
+        neighbor.position = input.position(threeDimensional);
+        neighbor.backlogBytes = input.fraction(100000);
+        neighbor.sojournTime = input.flag() ? input.fraction(0.1) : -1;
+        neighbor.linkDelayMean = input.flag() ? input.fraction(0.05) : -1;
+        neighbor.linkDelayVariance = input.fraction(1e-4);
+        neighbor.txBitrate = input.fraction(54e6);
+        neighbor.queueInfoAge = input.fraction(6) - 1;
+        neighbor.cpuOffloadHz = input.fraction(4e9);
+        neighbor.cpuOffloadBacklogCycles = input.fraction(1e9);
+        neighbor.cpuInfoAge = input.fraction(6) - 1;
+        neighbors.push_back(neighbor);
+    }
+
+    // Planarization
+    std::vector<int> planar = getPlanarNeighbors(params, self, neighbors);
+    for (size_t i = 0; i < planar.size(); i++) {
+        checkIndex(planar[i], neighbors.size(), "planar neighbor index");
+        if (i > 0 && planar[i] <= planar[i - 1])
+            fail("planar neighbors not ascending", planar[i]);
+    }
+
+    // Greedy: a next hop is strictly closer to the destination than self
+    GreedyResult greedy = findGreedyNextHop(params, self, destination, neighbors);
+    checkIndex(greedy.nextHop, neighbors.size(), "greedy next hop");
+    if (greedy.nextHop != NO_NEIGHBOR && !params.enableDelayTiebreaker &&
+        !(neighbors[greedy.nextHop].position.distance(destination) < self.distance(destination)))
+        fail("greedy next hop makes no progress", greedy.nextHop);
+    checkIndex(findLowestDelayNextHop(params, self, destination, neighbors), neighbors.size(), "lowest delay next hop");
+
+    // The batch kernel scores and selects exactly like the scalar estimators
+    CandidateBatch batch;
+    batch.assign(params, neighbors);
+    CandidateScores scores, scalarScores;
+    scoreCandidates(self, destination, params.delayEstimationFactor, batch, scores);
+    scoreCandidatesScalar(self, destination, params.delayEstimationFactor, batch, scalarScores);
+    for (size_t i = 0; i < neighbors.size(); i++) {
+        double delay = estimateNeighborDelay(params, self, neighbors[i]);
+        if (scores.delay[i] != delay || scalarScores.delay[i] != delay)
+            fail("candidate delay differs from estimateNeighborDelay", i);
+        if (scores.distance[i] != scalarScores.distance[i] || scores.cost[i] != scalarScores.cost[i])
+            fail("vectorized scores differ from scalar scores", i);
+    }
+    CandidateSelection selection;
+    selectCandidates(scores, params.distanceEqualityThreshold, selection);
+    checkIndex(selection.closest, neighbors.size(), "closest candidate");
+    checkIndex(selection.fastestTie, neighbors.size(), "fastest tie");
+    checkIndex(selection.cheapest, neighbors.size(), "cheapest candidate");
+    CandidateScores batchScores;
+    GreedyResult batchGreedy = findGreedyNextHop(params, self, destination, batch, batchScores);
+    if (batchGreedy.nextHop != greedy.nextHop || batchGreedy.tiebreakerActivations != greedy.tiebreakerActivations)
+        fail("batch greedy selection differs", batchGreedy.nextHop);
+
+    // Load spreading and backpressure
+    std::vector<int> candidates = findGreedyCandidateSet(params, self, destination, neighbors);
+    for (int candidate : candidates)
+        checkIndex(candidate, neighbors.size(), "load spreading candidate");
+    if (!candidates.empty()) {
+        std::vector<double> weights = getLoadSpreadingWeights(params, self, neighbors, candidates);
+        double sum = 0;
+        for (double weight : weights) {
+            if (!(weight >= 0 && weight <= 1))
+                fail("load spreading weight out of range", candidates.size());
+            sum += weight;
+        }
+        if (std::fabs(sum - 1) > 1e-9)
+            fail("load spreading weights do not sum to 1", candidates.size());
+        checkIndex(selectWeightedRandom(weights, input.fraction(0.999)), weights.size(), "weighted random choice");
+        std::vector<double> deficits(weights.size(), 0);
+        for (int i = 0; i < 4; i++)
+            checkIndex(selectDeficitRoundRobin(weights, deficits), weights.size(), "deficit round-robin choice");
+    }
+    BackpressureResult backpressure = findBackpressureNextHop(params, self, destination, neighbors, input.fraction(100000), input.fraction(54e6));
+    checkIndex(backpressure.nextHop, neighbors.size(), "backpressure next hop");
+
+    // Face routing from a perimeter entry point, optionally arriving from one of the neighbors
+    PerimeterInput perimeter;
+    perimeter.selfId = 1;
+    perimeter.self = self;
+    perimeter.destination = destination;
+    perimeter.perimeterStartPosition = input.flag() ? self : input.position(threeDimensional);
+    perimeter.faceFirstSender = input.flag() ? 1 : input.byte();
+    perimeter.faceFirstReceiver = input.byte() % (neighbors.size() + 2);
+    Vec3 senderPosition;
+    if (!neighbors.empty() && input.flag()) {
+        const Neighbor& sender = neighbors[input.byte() % neighbors.size()];
+        senderPosition = sender.position;
+        perimeter.senderPosition = &senderPosition;
+        perimeter.senderId = sender.id;
+    }
+    checkPerimeterResult(findPerimeterNextHop(params, perimeter, neighbors), neighbors.size(), "perimeter next hop");
+    FaceBound bound;
+    bound.radius = input.flag() ? std::numeric_limits<double>::infinity() : input.fraction(1500);
+    bound.reverse = input.flag();
+    bound.boundaryHits = input.flag();
+    checkPerimeterResult(findBoundedPerimeterNextHop(params, perimeter, bound, 1 + input.fraction(3), neighbors), neighbors.size(), "bounded perimeter next hop");
+    int plane = input.byte() % NUM_PROJECTION_PLANES;
+    PerimeterResult projected = findProjectedPerimeterNextHop(params, perimeter, plane, neighbors);
+    checkPerimeterResult(projected, neighbors.size(), "projected perimeter next hop");
+    if (plane < 0 || plane > NUM_PROJECTION_PLANES)
+        fail("projection plane out of range", plane);
+
+    // Offload decision
+    int taskBits = input.word() * 8;
+    OffloadDecision decision = makeOffloadDecision(params, self, destination, neighbors, taskBits, input.fraction(4e9), input.fraction(1e9),
+                                                   input.flag() ? std::numeric_limits<double>::infinity() : input.fraction(1));
+    checkIndex(decision.target, neighbors.size(), "offload target");
+    if (decision.shouldOffload && decision.target == NO_NEIGHBOR)
+        fail("offload without a target", 0);
+    return 0;
+}
+
+#ifndef CORE_FUZZ_LIBFUZZER
+
+#include <dirent.h>
+#include <random>
+#include <string>
+
+static void runFile(const std::string& fileName)
+{
+    FILE *file = std::fopen(fileName.c_str(), "rb");
+    if (file == nullptr) {
+        std::fprintf(stderr, "corefuzz: cannot open %s\n", fileName.c_str());
+        std::exit(2);
+    }
+    std::vector<uint8_t> data;
+    uint8_t buffer[4096];
+    size_t count;
+    while ((count = std::fread(buffer, 1, sizeof(buffer), file)) > 0)
+        data.insert(data.end(), buffer, buffer + count);
+    std::fclose(file);
+    standaloneInput = &data;
+    LLVMFuzzerTestOneInput(data.data(), data.size());
+    standaloneInput = nullptr;
+}
+
+static void runPath(const std::string& path)
+{
+    DIR *directory = opendir(path.c_str());
+    if (directory == nullptr) {
+        runFile(path);
+        return;
+    }
+    while (dirent *entry = readdir(directory))
+        if (entry->d_name[0] != '.')
+            runPath(path + "/" + entry->d_name);
+    closedir(directory);
+}
+
+int main(int argc, char **argv)
+{
+    long runs = 100000;
+    unsigned long seed = 1;
+    std::vector<std::string> paths;
+    for (int i = 1; i < argc; i++) {
+        if (!std::strncmp(argv[i], "-runs=", 6))
+            runs = std::atol(argv[i] + 6);
+        else if (!std::strncmp(argv[i], "-seed=", 6))
+            seed = std::strtoul(argv[i] + 6, nullptr, 10);
+        else
+            paths.push_back(argv[i]);
+    }
+    if (!paths.empty()) {
+        for (const std::string& path : paths)
+            runPath(path);
+        std::printf("corefuzz: ran %zu path(s)\n", paths.size());
+        return 0;
+    }
+    // random inputs of random length; a failing input is written to corefuzz-crash.bin
+    std::mt19937_64 rng(seed);
+    std::vector<uint8_t> data;
+    standaloneInput = &data;
+    for (long run = 0; run < runs; run++) {
+        data.resize(rng() % 1024);
+        for (uint8_t& byte : data)
+            byte = rng();
+        LLVMFuzzerTestOneInput(data.data(), data.size());
+    }
+    std::printf("corefuzz: %ld random inputs (seed %lu) passed\n", runs, seed);
+    return 0;
+}
+
+#endif
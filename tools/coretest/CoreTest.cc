@@ -0,0 +1,710 @@
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+//
+// Regression tests of the framework-independent GPSR routing core: geometry,
+// greedy and face routing (plain, bounded and projected), the delay and
+// offload estimators and the vectorized candidate scoring.
+//
+// The scenario tests replay the topologies that were used to evaluate bounded
+// face recovery and projected 3D recovery, so a change in their delivery or
+// hop counts shows up here rather than only in simulation results. Their
+// topologies are drawn with std::uniform_real_distribution, whose sequence is
+// implementation-defined; the expected numbers are those of libstdc++.
+//
+// Usage: coretest   (exit code 0 when all checks pass)
+//
+
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "CandidateScoring.h"
+#include "GpsrCore.h"
+
+using namespace researchproject::gpsrcore;
+
+static int numChecks = 0;
+static int numFailures = 0;
+
+#define CHECK(condition) check((condition), #condition, __FILE__, __LINE__)
+#define CHECK_NEAR(actual, expected, tolerance) checkNear((actual), (expected), (tolerance), #actual, __FILE__, __LINE__)
+
+static void check(bool condition, const char *expression, const char *file, int line)
+{
+    numChecks++;
+    if (!condition) {
+        numFailures++;
+        std::printf("%s:%d: check failed: %s\n", file, line, expression);
+    }
+}
+
+static void checkNear(double actual, double expected, double tolerance, const char *expression, const char *file, int line)
+{
+    numChecks++;
+    if (!(std::fabs(actual - expected) <= tolerance)) {
+        numFailures++;
+        std::printf("%s:%d: check failed: %s = %.17g, expected %.17g\n", file, line, expression, actual, expected);
+    }
+}
+
+static Neighbor makeNeighbor(uint64_t id, const Vec3& position)
+{
+    Neighbor neighbor;
+    neighbor.id = id;
+    neighbor.position = position;
+    return neighbor;
+}
+
+//
+// Hop-by-hop routing over a unit disk graph, as QueueGpsr does it: greedy until a local
+// minimum, then the selected recovery strategy until a node is closer than the entry node
+//
+
+enum class Recovery { FACE, BOUNDED, PROJECTED };
+
+struct Route
+{
+    bool delivered = false;
+    int hops = 0;
+};
+
+static Route routePacket(const Params& params, const std::vector<Vec3>& nodes, double range, int source, int destination,
+                         Recovery recovery, int maxHops)
+{
+    Route route;
+    int current = source, previous = -1;
+    bool perimeter = false;
+    Vec3 perimeterStart;
+    uint64_t faceFirstSender = 0, faceFirstReceiver = 0;
+    FaceBound bound;
+    int plane = 0;
+    while (route.hops < maxHops) {
+        if (current == destination) {
+            route.delivered = true;
+            break;
+        }
+        // node ids are indices + 1 (0 = unspecified)
+        std::vector<Neighbor> neighbors;
+        std::vector<int> indices;
+        for (int j = 0; j < (int)nodes.size(); j++) {
+            if (j != current && nodes[j].distance(nodes[current]) <= range) {
+                neighbors.push_back(makeNeighbor(j + 1, nodes[j]));
+                indices.push_back(j);
+            }
+        }
+        int next = -1;
+        if (!perimeter) {
+            GreedyResult greedy = findGreedyNextHop(params, nodes[current], nodes[destination], neighbors);
+            if (greedy.nextHop != NO_NEIGHBOR)
+                next = indices[greedy.nextHop];
+            else {
+                perimeter = true;
+                perimeterStart = nodes[current];
+                faceFirstSender = current + 1;
+                faceFirstReceiver = 0;
+                previous = -1;
+                bound = FaceBound();
+                bound.radius = 1.4142 * nodes[current].distance(nodes[destination]);
+                plane = 0;
+            }
+        }
+        if (perimeter && next < 0) {
+            PerimeterInput input;
+            input.selfId = current + 1;
+            input.self = nodes[current];
+            input.destination = nodes[destination];
+            input.perimeterStartPosition = perimeterStart;
+            input.faceFirstSender = faceFirstSender;
+            input.faceFirstReceiver = faceFirstReceiver;
+            Vec3 senderPosition;
+            if (previous >= 0) {
+                senderPosition = nodes[previous];
+                input.senderPosition = &senderPosition;
+                input.senderId = previous + 1;
+            }
+            PerimeterResult result;
+            if (recovery == Recovery::FACE)
+                result = findPerimeterNextHop(params, input, neighbors);
+            else if (recovery == Recovery::BOUNDED)
+                result = findBoundedPerimeterNextHop(params, input, bound, 2.0, neighbors);
+            else
+                result = findProjectedPerimeterNextHop(params, input, plane, neighbors);
+            if (result.outcome == PerimeterResult::SWITCH_TO_GREEDY) {
+                perimeter = false;
+                previous = -1;
+                continue;
+            }
+            if (result.faceChanged) {
+                faceFirstSender = current + 1;
+                faceFirstReceiver = 0;
+            }
+            if (result.outcome != PerimeterResult::NEXT_HOP)
+                break;
+            next = indices[result.nextHop];
+            if (result.firstReceiverSet)
+                faceFirstReceiver = next + 1;
+        }
+        previous = current;
+        current = next;
+        route.hops++;
+    }
+    return route;
+}
+
+static void findFarthestPair(const std::vector<Vec3>& nodes, int& source, int& destination)
+{
+    source = 0;
+    destination = 1;
+    for (int i = 0; i < (int)nodes.size(); i++)
+        for (int j = 0; j < (int)nodes.size(); j++)
+            if (nodes[i].distance(nodes[j]) > nodes[source].distance(nodes[destination])) {
+                source = i;
+                destination = j;
+            }
+}
+
+static bool isConnected(const std::vector<Vec3>& nodes, double range, int source, int destination)
+{
+    std::vector<bool> seen(nodes.size(), false);
+    std::vector<int> queue { source };
+    seen[source] = true;
+    for (size_t k = 0; k < queue.size(); k++)
+        for (int j = 0; j < (int)nodes.size(); j++)
+            if (!seen[j] && nodes[j].distance(nodes[queue[k]]) <= range) {
+                seen[j] = true;
+                queue.push_back(j);
+            }
+    return seen[destination];
+}
+
+//
+// Geometry
+//
+
+static void testGeometry()
+{
+    // angles are counter-clockwise with the y axis pointing down
+    CHECK_NEAR(getVectorAngle(Vec3(1, 0, 0)), 0, 1e-12);
+    CHECK_NEAR(getVectorAngle(Vec3(0, -1, 0)), M_PI / 2, 1e-12);
+    CHECK_NEAR(getVectorAngle(Vec3(-1, 0, 0)), M_PI, 1e-12);
+    CHECK_NEAR(getVectorAngle(Vec3(0, 1, 0)), 3 * M_PI / 2, 1e-12);
+
+    Vec3 intersection = computeIntersectionInsideLineSegments(Vec3(0, 0, 0), Vec3(2, 2, 0), Vec3(0, 2, 0), Vec3(2, 0, 0));
+    CHECK_NEAR(intersection.x, 1, 1e-12);
+    CHECK_NEAR(intersection.y, 1, 1e-12);
+    CHECK(computeIntersectionInsideLineSegments(Vec3(0, 0, 0), Vec3(1, 1, 0), Vec3(2, 0, 0), Vec3(3, 1, 0)).isNil());
+    // segments sharing an end point do not intersect inside
+    CHECK(computeIntersectionInsideLineSegments(Vec3(0, 0, 0), Vec3(2, 2, 0), Vec3(2, 2, 0), Vec3(4, 0, 0)).isNil());
+
+    CHECK(projectToPlane(Vec3(1, 2, 3), 0) == Vec3(1, 2, 0));
+    CHECK(projectToPlane(Vec3(1, 2, 3), 1) == Vec3(1, 3, 0));
+    CHECK(projectToPlane(Vec3(1, 2, 3), 2) == Vec3(2, 3, 0));
+}
+
+static void testPlanarization()
+{
+    // the neighbor at (5, 1) lies inside the circle with diameter self - (10, 0), so GG and RNG drop that edge
+    std::vector<Neighbor> neighbors { makeNeighbor(1, Vec3(10, 0, 0)), makeNeighbor(2, Vec3(5, 1, 0)), makeNeighbor(3, Vec3(-10, 0, 0)) };
+    Params params;
+    for (Planarization planarization : { Planarization::GG, Planarization::RNG }) {
+        params.planarization = planarization;
+        std::vector<int> planar = getPlanarNeighbors(params, Vec3(), neighbors);
+        CHECK((planar == std::vector<int> { 1, 2 }));
+    }
+    params.planarization = Planarization::NONE;
+    CHECK(getPlanarNeighbors(params, Vec3(), neighbors).size() == 3);
+
+    // counter-clockwise from angle 0: (5, 1) points slightly down on screen (angle just below 2pi), so it
+    // comes after (-10, 0) at pi; clockwise from angle 0 the order is reversed
+    params.planarization = Planarization::GG;
+    CHECK((getPlanarNeighborsCounterClockwise(params, Vec3(), neighbors, 0) == std::vector<int> { 2, 1 }));
+    CHECK((getPlanarNeighborsClockwise(params, Vec3(), neighbors, 0) == std::vector<int> { 1, 2 }));
+}
+
+//
+// Greedy forwarding
+//
+
+static void testGreedy()
+{
+    Params params;
+    Vec3 self(0, 0, 0), destination(100, 0, 0);
+    std::vector<Neighbor> neighbors { makeNeighbor(1, Vec3(30, 10, 0)), makeNeighbor(2, Vec3(40, 0, 0)), makeNeighbor(3, Vec3(-20, 0, 0)) };
+    GreedyResult result = findGreedyNextHop(params, self, destination, neighbors);
+    CHECK(result.nextHop == 1);
+    CHECK_NEAR(result.distance, 60, 1e-12);
+
+    // a local minimum: no neighbor is closer to the destination than self
+    std::vector<Neighbor> behind { makeNeighbor(1, Vec3(-20, 0, 0)), makeNeighbor(2, Vec3(0, 30, 0)) };
+    CHECK(findGreedyNextHop(params, self, destination, behind).nextHop == NO_NEIGHBOR);
+    CHECK(findGreedyCandidateSet(params, self, destination, behind).empty());
+    CHECK(findLowestDelayNextHop(params, self, destination, behind) == NO_NEIGHBOR);
+
+    // delay tiebreaker: of two neighbors within distanceEqualityThreshold the one with the shorter queue wins
+    params.enableDelayTiebreaker = true;
+    params.enableQueueDelay = true;
+    params.maxInfoAge = 5;
+    params.distanceEqualityThreshold = 1;
+    std::vector<Neighbor> tied { makeNeighbor(1, Vec3(40, 0, 0)), makeNeighbor(2, Vec3(39.5, 0, 0)) };
+    tied[0].backlogBytes = 10000;
+    tied[0].txBitrate = 1e6;
+    tied[0].queueInfoAge = 1;
+    tied[1].backlogBytes = 0;
+    tied[1].txBitrate = 1e6;
+    tied[1].queueInfoAge = 1;
+    int ties = 0;
+    result = findGreedyNextHop(params, self, destination, tied, [&] (const TieEvent& tie) { ties++; });
+    CHECK(result.nextHop == 1);
+    CHECK(result.tiebreakerActivations == 1);
+    CHECK(ties == 1);
+    // the closer neighbor wins once the distance difference exceeds the threshold
+    params.distanceEqualityThreshold = 0.1;
+    CHECK(findGreedyNextHop(params, self, destination, tied).nextHop == 0);
+}
+
+//
+// Face routing
+//
+
+// A chain that leaves the source away from the destination and bends back around the void:
+// greedy fails at the source, face routing follows the chain until (180, 190) is closer to the
+// destination than the source and greedy finishes
+static std::vector<Vec3> makeDetourChain(double z)
+{
+    return { Vec3(0, 0, z), Vec3(-50, 90, z), Vec3(60, 190, z), Vec3(180, 190, z), Vec3(290, 110, z), Vec3(300, 0, z) };
+}
+
+static void testFaceDetour()
+{
+    Params params;
+    std::vector<Vec3> nodes = makeDetourChain(0);
+    for (Recovery recovery : { Recovery::FACE, Recovery::BOUNDED, Recovery::PROJECTED }) {
+        Route route = routePacket(params, nodes, 150, 0, 5, recovery, 100);
+        CHECK(route.delivered);
+        CHECK(route.hops == 5);
+    }
+
+    // at the entry node the traversal starts with the only neighbor
+    std::vector<Neighbor> neighbors { makeNeighbor(2, nodes[1]) };
+    PerimeterInput input;
+    input.selfId = 1;
+    input.self = nodes[0];
+    input.destination = nodes[5];
+    input.perimeterStartPosition = nodes[0];
+    input.faceFirstSender = 1;
+    PerimeterResult result = findPerimeterNextHop(params, input, neighbors);
+    CHECK(result.outcome == PerimeterResult::NEXT_HOP);
+    CHECK(result.nextHop == 0);
+    CHECK(result.firstReceiverSet);
+
+    // a node closer to the destination than the entry node resumes greedy forwarding
+    input.self = nodes[3];
+    input.selfId = 4;
+    CHECK(findPerimeterNextHop(params, input, neighbors).outcome == PerimeterResult::SWITCH_TO_GREEDY);
+    int plane = 0;
+    CHECK(findProjectedPerimeterNextHop(params, input, plane, neighbors).outcome == PerimeterResult::SWITCH_TO_GREEDY);
+
+    // a neighbor at our own position has no direction and is left out of the face
+    input.self = nodes[0];
+    input.selfId = 1;
+    std::vector<Neighbor> coincident { makeNeighbor(7, nodes[0]), makeNeighbor(2, nodes[1]) };
+    result = findPerimeterNextHop(params, input, coincident);
+    CHECK(result.outcome == PerimeterResult::NEXT_HOP);
+    CHECK(result.nextHop == 1);
+    input.senderPosition = &nodes[0];
+    input.senderId = 7;
+    CHECK(findPerimeterNextHop(params, input, coincident).nextHop == 1);
+    input.senderPosition = nullptr;
+    input.senderId = 0;
+
+    // without neighbors there is nothing to traverse
+    CHECK(findPerimeterNextHop(params, input, NeighborSpan()).outcome == PerimeterResult::NO_NEIGHBOR_FOUND);
+}
+
+static void testBoundedFace()
+{
+    Params params;
+    std::vector<Vec3> nodes = makeDetourChain(0);
+    std::vector<Neighbor> neighbors { makeNeighbor(1, nodes[0]), makeNeighbor(3, nodes[2]) };
+    PerimeterInput input;
+    input.selfId = 2;
+    input.self = nodes[1];
+    input.destination = nodes[5];
+    input.perimeterStartPosition = nodes[0];
+    input.faceFirstSender = 1;
+    input.faceFirstReceiver = 2;
+    input.senderPosition = &nodes[0];
+    input.senderId = 1;
+
+    // within the circle the bounded traversal takes the same edge as the plain one
+    FaceBound bound;
+    bound.radius = 1000;
+    PerimeterResult plain = findPerimeterNextHop(params, input, neighbors);
+    PerimeterResult bounded = findBoundedPerimeterNextHop(params, input, bound, 2.0, neighbors);
+    CHECK(plain.outcome == PerimeterResult::NEXT_HOP);
+    CHECK(bounded.outcome == PerimeterResult::NEXT_HOP);
+    CHECK(bounded.nextHop == plain.nextHop);
+    CHECK(bound.reversals == 0);
+
+    // an edge leaving the circle turns the traversal back to the sender in the other direction
+    bound = FaceBound();
+    bound.radius = 303;  // (60, 190) is 306 m from the destination, the sender 300 m
+    bounded = findBoundedPerimeterNextHop(params, input, bound, 2.0, neighbors);
+    CHECK(bound.reversals == 1);
+    CHECK(bound.reverse);
+    CHECK(bounded.outcome == PerimeterResult::NEXT_HOP);
+    CHECK(bounded.nextHop == 0);
+    CHECK(bounded.faceChanged);
+
+    // hit in both directions: the circle grows and the traversal continues
+    bound = FaceBound();
+    bound.radius = 200;
+    bound.reverse = true;
+    bound.boundaryHits = 1;
+    bounded = findBoundedPerimeterNextHop(params, input, bound, 2.0, neighbors);
+    CHECK(bounded.outcome == PerimeterResult::NEXT_HOP);
+    CHECK(bound.expansions == 1);
+    CHECK(bound.radius == 400);
+}
+
+// Bounded face recovery around a circular void: 300 topologies of 150 nodes in 1000 x 1000 m
+// without nodes within 250 m of the center, between the two farthest nodes (range 120 m).
+// Bounded recovery delivers the same packets as plain face routing with 22% fewer hops.
+static void testBoundedFaceScenario()
+{
+    std::mt19937 rng(3);
+    Params params;
+    Route face, bounded;
+    int faceHops = 0, boundedHops = 0, faceDelivered = 0, boundedDelivered = 0;
+    for (int trial = 0; trial < 300; trial++) {
+        std::uniform_real_distribution<double> uniform(0, 1000);
+        std::vector<Vec3> nodes;
+        while (nodes.size() < 150) {
+            // NOTE: drawn in separate statements to fix the order (y first, as in the original evaluation)
+            double y = uniform(rng);
+            double x = uniform(rng);
+            Vec3 position(x, y, 0);
+            double dx = position.x - 500, dy = position.y - 500;
+            if (dx * dx + dy * dy >= 250 * 250)
+                nodes.push_back(position);
+        }
+        int source, destination;
+        findFarthestPair(nodes, source, destination);
+        face = routePacket(params, nodes, 120, source, destination, Recovery::FACE, 2000);
+        bounded = routePacket(params, nodes, 120, source, destination, Recovery::BOUNDED, 2000);
+        if (face.delivered) {
+            faceDelivered++;
+            faceHops += face.hops;
+        }
+        if (bounded.delivered) {
+            boundedDelivered++;
+            boundedHops += bounded.hops;
+        }
+    }
+    double faceMean = (double)faceHops / faceDelivered, boundedMean = (double)boundedHops / boundedDelivered;
+    std::printf("bounded face scenario: face delivered %d (%d hops, avg %.2f), bounded delivered %d (%d hops, avg %.2f)\n",
+                faceDelivered, faceHops, faceMean, boundedDelivered, boundedHops, boundedMean);
+    CHECK(faceDelivered == 192);
+    CHECK(boundedDelivered == 192);
+    CHECK(faceHops == 10027);     // 52.22 per delivered packet
+    CHECK(boundedHops == 7848);   // 40.88 per delivered packet
+    CHECK(boundedMean < 0.8 * faceMean);
+}
+
+// Projected 3D recovery: 300 topologies of 120 nodes in 1000 x 1000 x 400 m (range 170 m), of which
+// 117 connect the two farthest nodes. Face routing on the xy plane alone delivers 99 of them,
+// projected recovery 110.
+static void testProjectedFaceScenario()
+{
+    std::mt19937 rng(5);
+    Params params;
+    int connected = 0, faceDelivered = 0, projectedDelivered = 0;
+    for (int trial = 0; trial < 300; trial++) {
+        std::uniform_real_distribution<double> uniform(0, 1000), uniformZ(0, 400);
+        std::vector<Vec3> nodes;
+        while (nodes.size() < 120) {
+            // NOTE: drawn in separate statements to fix the order (z first, as in the original evaluation)
+            double z = uniformZ(rng);
+            double y = uniform(rng);
+            double x = uniform(rng);
+            nodes.push_back(Vec3(x, y, z));
+        }
+        int source, destination;
+        findFarthestPair(nodes, source, destination);
+        if (!isConnected(nodes, 170, source, destination))
+            continue;
+        connected++;
+        if (routePacket(params, nodes, 170, source, destination, Recovery::FACE, 3000).delivered)
+            faceDelivered++;
+        if (routePacket(params, nodes, 170, source, destination, Recovery::PROJECTED, 3000).delivered)
+            projectedDelivered++;
+    }
+    std::printf("projected face scenario: %d connected, 2D face delivered %d, projected delivered %d\n",
+                connected, faceDelivered, projectedDelivered);
+    CHECK(connected == 117);
+    CHECK(faceDelivered == 99);
+    CHECK(projectedDelivered == 110);
+}
+
+//
+// Estimators
+//
+
+static void testQueueAndLinkDelay()
+{
+    Params params;
+    params.enableQueueDelay = true;
+    params.maxInfoAge = 2;
+    params.delayEstimationFactor = 0.001;
+    Vec3 self;
+    Neighbor neighbor = makeNeighbor(1, Vec3(30, 40, 0));
+    neighbor.backlogBytes = 1250;
+    neighbor.txBitrate = 1e6;
+    neighbor.queueInfoAge = 1;
+
+    // backlog / bitrate, unless a sojourn time is advertised
+    CHECK_NEAR(estimateNeighborQueueDelay(params, neighbor), 0.01, 1e-15);
+    neighbor.sojournTime = 0.003;
+    CHECK_NEAR(estimateNeighborQueueDelay(params, neighbor), 0.003, 1e-15);
+    // stale, unknown or disabled queue information leaves no queueing term
+    neighbor.queueInfoAge = 3;
+    CHECK(estimateNeighborQueueDelay(params, neighbor) == 0);
+    neighbor.queueInfoAge = -1;
+    CHECK(estimateNeighborQueueDelay(params, neighbor) == 0);
+    neighbor.queueInfoAge = 1;
+    params.enableQueueDelay = false;
+    CHECK(estimateNeighborQueueDelay(params, neighbor) == 0);
+    params.enableQueueDelay = true;
+
+    // distance model: 50 m at 1 ms/m
+    CHECK_NEAR(estimateLinkDelay(params, self, neighbor), 0.05, 1e-15);
+    CHECK_NEAR(estimateNeighborDelay(params, self, neighbor), 0.053, 1e-15);
+    // a measured link delay replaces the distance term only when enabled and fresh
+    neighbor.linkDelayMean = 0.002;
+    neighbor.linkDelayVariance = 0.0001;
+    CHECK(!hasMeasuredLinkDelay(params, neighbor));
+    params.measuredLinkDelay = true;
+    CHECK(hasMeasuredLinkDelay(params, neighbor));
+    CHECK_NEAR(estimateLinkDelay(params, self, neighbor), 0.002, 1e-15);
+    params.linkDelayDeviationWeight = 2;
+    CHECK_NEAR(estimateLinkDelay(params, self, neighbor), 0.022, 1e-15);
+    neighbor.queueInfoAge = 3;
+    CHECK_NEAR(estimateLinkDelay(params, self, neighbor), 0.05, 1e-15);
+
+    // progress cost: one-hop delay per meter of progress, +inf without progress
+    params = Params();
+    neighbor = makeNeighbor(1, Vec3(40, 0, 0));
+    CHECK_NEAR(estimateProgressCost(params, self, Vec3(100, 0, 0), neighbor), 0.001, 1e-15);
+    CHECK(std::isinf(estimateProgressCost(params, self, Vec3(-100, 0, 0), neighbor)));
+}
+
+// Measured link delays start when the sender routes the packet, so they include its own queue;
+// modeled links are charged the same local term, otherwise a long local queue alone would make
+// every measured neighbor look slower than the modeled ones
+static void testMixedLinkDelays()
+{
+    Params params;
+    params.enableDelayTiebreaker = true;
+    params.measuredLinkDelay = true;
+    params.maxInfoAge = 2;
+    params.distanceEqualityThreshold = 1;
+    params.localQueueDelay = 0.03;
+    Vec3 self, destination(100, 0, 0);
+    // equally far from the destination; modeled: 50 m at 1 ms/m; measured: 30 ms on the air behind our 30 ms queue,
+    // which loses against the bare distance model (50 ms) but wins once the modeled link carries the queue too
+    std::vector<Neighbor> neighbors { makeNeighbor(1, Vec3(30, 40, 0)), makeNeighbor(2, Vec3(30, -40, 0)) };
+    neighbors[1].linkDelayMean = 0.06;
+    neighbors[1].queueInfoAge = 1;
+    CHECK(!hasMeasuredLinkDelay(params, neighbors[0]));
+    CHECK(hasMeasuredLinkDelay(params, neighbors[1]));
+    CHECK_NEAR(estimateLinkDelay(params, self, neighbors[0]), 0.08, 1e-15);
+    CHECK_NEAR(estimateLinkDelay(params, self, neighbors[1]), 0.06, 1e-15);
+    GreedyResult result = findGreedyNextHop(params, self, destination, neighbors);
+    CHECK(result.nextHop == 1);
+    CHECK(result.tiebreakerActivations == 1);
+    // the batch kernel agrees, including the local term of the modeled link
+    CandidateBatch batch;
+    batch.assign(params, neighbors);
+    CandidateScores scores;
+    scoreCandidates(self, destination, params.delayEstimationFactor, batch, scores);
+    CHECK(scores.delay[0] == estimateNeighborDelay(params, self, neighbors[0]));
+    CHECK(scores.delay[1] == estimateNeighborDelay(params, self, neighbors[1]));
+    CHECK(findGreedyNextHop(params, self, destination, batch, scores).nextHop == 1);
+    // without measurements the local queue is the same for every candidate and is left out
+    params.measuredLinkDelay = false;
+    CHECK_NEAR(estimateLinkDelay(params, self, neighbors[0]), 0.05, 1e-15);
+    CHECK_NEAR(estimateLinkDelay(params, self, neighbors[1]), 0.05, 1e-15);
+}
+
+static void testOffloadEstimators()
+{
+    Params params;
+    params.taskCyclesPerBit = 100;
+    params.maxInfoAge = 2;
+    Vec3 self;
+
+    // 10 kbit at 100 cycles/bit on 1 GHz, behind 1e6 queued cycles
+    CHECK_NEAR(estimateLocalProcessingTime(params, 10000, 1e9), 0.001, 1e-15);
+    CHECK_NEAR(estimateLocalTaskDelay(params, 10000, 1e9, 1e6), 0.002, 1e-15);
+    CHECK(std::isinf(estimateLocalProcessingTime(params, 10000, 0)));
+
+    Neighbor neighbor = makeNeighbor(1, Vec3(100, 0, 0));
+    CHECK(std::isinf(estimateRemoteProcessingTime(params, neighbor, 10000)));  // CPU capacity unknown
+    neighbor.cpuOffloadHz = 4e9;
+    neighbor.cpuOffloadBacklogCycles = 2e6;
+    neighbor.cpuInfoAge = 1;
+    CHECK_NEAR(estimateRemoteProcessingTime(params, neighbor, 10000), 0.00025 + 0.0005, 1e-15);
+    CHECK_NEAR(estimateOffloadTotalDelay(params, self, neighbor, 10000), 0.1 + 0.00075, 1e-12);
+    neighbor.cpuInfoAge = 3;
+    CHECK(std::isinf(estimateRemoteProcessingTime(params, neighbor, 10000)));
+
+    // offload when the neighbor finishes first, but never to a target that misses the slack
+    params.delayEstimationFactor = 0.00001;  // 1 ms to the neighbor
+    neighbor.cpuInfoAge = 1;
+    std::vector<Neighbor> candidates { neighbor };
+    OffloadDecision decision = makeOffloadDecision(params, self, Vec3(500, 0, 0), candidates, 10000, 1e9, 1e7, 1);
+    CHECK(decision.shouldOffload);
+    CHECK(decision.target == 0);
+    CHECK_NEAR(decision.localTime, 0.011, 1e-12);
+    CHECK_NEAR(decision.bestOffloadTime, 0.00175, 1e-12);
+    decision = makeOffloadDecision(params, self, Vec3(500, 0, 0), candidates, 10000, 1e9, 1e7, 0.001);
+    CHECK(!decision.shouldOffload);
+    CHECK(decision.target == NO_NEIGHBOR);
+    // an idle local CPU beats the neighbor
+    decision = makeOffloadDecision(params, self, Vec3(500, 0, 0), candidates, 10000, 1e9, 0, 1);
+    CHECK(!decision.shouldOffload);
+}
+
+static void testPipelineEstimators()
+{
+    Params params;
+    params.enableQueueDelay = true;
+    params.maxInfoAge = 2;
+    params.delayEstimationFactor = 0.0001;
+    params.taskCyclesPerBit = 100;
+    params.reductionFactor = 0.5;
+    Vec3 self;
+    std::vector<Neighbor> neighbors { makeNeighbor(1, Vec3(100, 0, 0)), makeNeighbor(2, Vec3(0, 50, 0)) };
+    for (Neighbor& neighbor : neighbors) {
+        neighbor.txBitrate = 1e6;
+        neighbor.queueInfoAge = 1;
+    }
+    neighbors[0].backlogBytes = 250;   // 2 ms
+    neighbors[1].sojournTime = 0.004;
+
+    PathDelayModel path = estimatePathDelayModel(params, self, neighbors);
+    CHECK_NEAR(path.hopProgress, 100, 1e-12);
+    CHECK_NEAR(path.queueDelay, 0.003, 1e-15);
+    CHECK_NEAR(path.bitrate, 1e6, 1e-6);
+    // 250 m: 3 hops of 3 ms queueing plus 5 ms transmission of 5 kbit, plus 25 ms distance term
+    CHECK_NEAR(estimatePathDelay(params, path, 250, 5000), 0.025 + 3 * 0.008, 1e-12);
+    CHECK(estimatePathDelay(params, path, 0, 5000) == 0);
+    CHECK(estimatePathDelay(params, path, std::nan(""), 5000) == 0);
+
+    PipelineDelay local = estimateLocalPipelineDelay(params, self, Vec3(250, 0, 0), 10000, 1e9, 0, path);
+    CHECK(local.transfer == 0);
+    CHECK_NEAR(local.processing, 0.001, 1e-15);
+    CHECK_NEAR(local.total(), 0.001 + 0.025 + 3 * 0.008, 1e-12);
+
+    neighbors[0].cpuOffloadHz = 1e9;
+    neighbors[0].cpuInfoAge = 1;
+    PipelineDelay remote = estimateOffloadPipelineDelay(params, self, Vec3(250, 0, 0), neighbors[0], 10000, path);
+    // 10 ms distance term and 2 ms queueing to the neighbor, 10 ms for the 10 kbit input
+    CHECK_NEAR(remote.transfer, 0.01 + 0.002 + 0.01, 1e-12);
+    CHECK_NEAR(remote.processing, 0.001, 1e-15);
+    CHECK_NEAR(remote.delivery, 0.015 + 2 * 0.008, 1e-12);
+}
+
+static void testLoadSpreading()
+{
+    Params params;
+    params.distanceEqualityThreshold = 5;
+    Vec3 self, destination(100, 0, 0);
+    std::vector<Neighbor> neighbors { makeNeighbor(1, Vec3(40, 3, 0)), makeNeighbor(2, Vec3(40, 0, 0)), makeNeighbor(3, Vec3(20, 0, 0)) };
+    std::vector<int> candidates = findGreedyCandidateSet(params, self, destination, neighbors);
+    CHECK((candidates == std::vector<int> { 1, 0 }));
+    std::vector<double> weights = getLoadSpreadingWeights(params, self, neighbors, candidates);
+    CHECK(weights.size() == 2);
+    CHECK_NEAR(weights[0] + weights[1], 1, 1e-12);
+    CHECK(weights[0] > weights[1]);  // the nearer hop is faster
+    CHECK(selectWeightedRandom({ 0.25, 0.75 }, 0.1) == 0);
+    CHECK(selectWeightedRandom({ 0.25, 0.75 }, 0.5) == 1);
+    std::vector<double> deficits(2, 0);
+    int served[2] = { 0, 0 };
+    for (int i = 0; i < 100; i++)
+        served[selectDeficitRoundRobin({ 0.25, 0.75 }, deficits)]++;
+    CHECK(served[0] == 25);
+    CHECK(served[1] == 75);
+}
+
+//
+// Vectorized candidate scoring
+//
+
+static void testCandidateScoring()
+{
+    std::mt19937 rng(11);
+    std::uniform_real_distribution<double> uniform(0, 1000), unit(0, 1);
+    Params params;
+    params.enableQueueDelay = true;
+    params.enableDelayTiebreaker = true;
+    params.measuredLinkDelay = true;
+    params.localQueueDelay = 0.004;
+    params.maxInfoAge = 2;
+    params.distanceEqualityThreshold = 20;
+    int mismatches = 0, greedyMismatches = 0;
+    for (int trial = 0; trial < 200; trial++) {
+        Vec3 self(uniform(rng), uniform(rng), 0), destination(uniform(rng), uniform(rng), 0);
+        std::vector<Neighbor> neighbors;
+        for (int i = 0; i < 1 + trial % 37; i++) {
+            Neighbor neighbor = makeNeighbor(i + 1, Vec3(uniform(rng), uniform(rng), uniform(rng) / 10));
+            neighbor.backlogBytes = 5000 * unit(rng);
+            neighbor.txBitrate = 1e6;
+            neighbor.queueInfoAge = 3 * unit(rng);
+            if (unit(rng) < 0.5) {
+                neighbor.linkDelayMean = 0.01 * unit(rng);
+                neighbor.linkDelayVariance = 1e-6 * unit(rng);
+            }
+            neighbors.push_back(neighbor);
+        }
+        CandidateBatch batch;
+        batch.assign(params, neighbors);
+        CandidateScores vectorized, scalar;
+        scoreCandidates(self, destination, params.delayEstimationFactor, batch, vectorized);
+        scoreCandidatesScalar(self, destination, params.delayEstimationFactor, batch, scalar);
+        for (size_t i = 0; i < neighbors.size(); i++) {
+            double delay = estimateNeighborDelay(params, self, neighbors[i]);
+            if (vectorized.delay[i] != delay || scalar.delay[i] != delay || vectorized.distance[i] != scalar.distance[i] ||
+                vectorized.cost[i] != scalar.cost[i])
+                mismatches++;
+        }
+        CandidateScores scores;
+        GreedyResult batched = findGreedyNextHop(params, self, destination, batch, scores);
+        GreedyResult spanned = findGreedyNextHop(params, self, destination, neighbors);
+        if (batched.nextHop != spanned.nextHop || batched.delay != spanned.delay || batched.tiebreakerActivations != spanned.tiebreakerActivations)
+            greedyMismatches++;
+    }
+    std::printf("candidate scoring (%s): %d score mismatches, %d greedy mismatches\n", getCandidateScoringIsa(), mismatches, greedyMismatches);
+    CHECK(mismatches == 0);
+    CHECK(greedyMismatches == 0);
+}
+
+int main(int argc, char **argv)
+{
+    testGeometry();
+    testPlanarization();
+    testGreedy();
+    testFaceDetour();
+    testBoundedFace();
+    testBoundedFaceScenario();
+    testProjectedFaceScenario();
+    testQueueAndLinkDelay();
+    testMixedLinkDelays();
+    testOffloadEstimators();
+    testPipelineEstimators();
+    testLoadSpreading();
+    testCandidateScoring();
+    std::printf("%d checks, %d failures\n", numChecks, numFailures);
+    return numFailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,383 @@
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+//
+// Offline replay of QueueGpsr decision traces.
+//
+// Reads the <host>.trace files written with recordDecisionTrace = true and
+// evaluates alternative forwarding/offload policies against the recorded
+// decision inputs, without the wireless stack. Records are split across
+// worker threads; each policy reports its agreement with the recorded
+// decisions and the estimated cost of its own choices.
+//
+// Usage: decisionreplay [-t threads] [-p policy,policy,...] trace...
+//
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "DecisionTrace.h"
+#include "GpsrCore.h"
+
+using namespace researchproject;
+
+namespace {
+
+const double INF = std::numeric_limits<double>::infinity();
+const int GREEDY = 1;       // GPSR_GREEDY_ROUTING
+const int PERIMETER = 2;    // GPSR_PERIMETER_ROUTING
+
+// Choice returned by a policy: neighbor index, or one of these
+const int NO_NEIGHBOR = gpsrcore::NO_NEIGHBOR;
+const int PROCESS_LOCALLY = -2;
+
+struct Context {
+    const DecisionTraceHeader& header;
+    const DecisionRecord& record;
+    const DecisionTraceNeighbor *neighbors;
+    gpsrcore::Params params;            // recorded configuration
+    gpsrcore::Vec3 self;
+    gpsrcore::Vec3 destination;
+    gpsrcore::NeighborSpan coreNeighbors;
+};
+
+gpsrcore::Params makeParams(const DecisionTraceHeader& header)
+{
+    gpsrcore::Params params;
+    params.enableDelayTiebreaker = header.flags & TRACE_DELAY_TIEBREAKER;
+    params.enableQueueDelay = header.flags & TRACE_QUEUE_DELAY;
+    params.distanceEqualityThreshold = header.distanceEqualityThreshold;
+    params.delayEstimationFactor = header.delayEstimationFactor;
+    params.maxInfoAge = header.maxInfoAge;
+    params.taskCyclesPerBit = header.taskCyclesPerBit;
+    params.offloadPipelineDelay = header.flags & TRACE_OFFLOAD_PIPELINE_DELAY;
+    params.reductionFactor = header.reductionFactor;
+    params.measuredLinkDelay = header.flags & TRACE_MEASURED_LINK_DELAY;
+    params.linkDelayDeviationWeight = header.linkDelayDeviationWeight;
+    return params;
+}
+
+void convertNeighbors(const DecisionRecord& record, const DecisionTraceNeighbor *neighbors, std::vector<gpsrcore::Neighbor>& result)
+{
+    result.resize(record.numNeighbors);
+    for (uint32_t i = 0; i < record.numNeighbors; i++) {
+        const DecisionTraceNeighbor& n = neighbors[i];
+        gpsrcore::Neighbor& neighbor = result[i];
+        neighbor.id = n.address;
+        neighbor.position = gpsrcore::Vec3(n.x, n.y, n.z);
+        neighbor.backlogBytes = n.backlogBytes;
+        neighbor.sojournTime = n.sojournTime;
+        neighbor.linkDelayMean = n.linkDelayMean;
+        neighbor.linkDelayVariance = n.linkDelayVariance;
+        neighbor.txBitrate = n.txBitrate;
+        neighbor.queueInfoAge = n.queueInfoAge;
+        neighbor.cpuOffloadHz = n.cpuOffloadHz;
+        neighbor.cpuOffloadBacklogCycles = n.cpuOffloadBacklogCycles;
+        neighbor.cpuInfoAge = n.cpuInfoAge;
+    }
+}
+
+//
+// Estimators: the routing core shared with QueueGpsr, with the recorded configuration
+//
+
+double distanceToDestination(const Context& c, int i)
+{
+    return c.destination.distance(c.coreNeighbors[i].position);
+}
+
+double estimateNeighborDelay(const Context& c, int i, bool queueDelay)
+{
+    gpsrcore::Params params = c.params;
+    params.enableQueueDelay = queueDelay;
+    return gpsrcore::estimateNeighborDelay(params, c.self, c.coreNeighbors[i]);
+}
+
+double estimateLocalTaskDelay(const Context& c)
+{
+    return gpsrcore::estimateLocalTaskDelay(c.params, c.record.taskBits, c.record.localCpuHz, c.record.localBacklogCycles);
+}
+
+double estimateOffloadTotalDelay(const Context& c, int i)
+{
+    return gpsrcore::estimateOffloadTotalDelay(c.params, c.self, c.coreNeighbors[i], c.record.taskBits);
+}
+
+//
+// Forwarding policies (greedy mode)
+//
+
+// QueueGpsr::findGreedyRoutingNextHop, optionally with a modified configuration
+int forwardRecorded(const Context& c, bool tiebreaker, bool queueDelay, double threshold)
+{
+    gpsrcore::Params params = c.params;
+    params.enableDelayTiebreaker = tiebreaker;
+    params.enableQueueDelay = queueDelay;
+    params.distanceEqualityThreshold = threshold;
+    return gpsrcore::findGreedyNextHop(params, c.self, c.destination, c.coreNeighbors).nextHop;
+}
+
+// Among neighbors making progress, minimize estimated delay per meter of progress
+int forwardMinDelayPerProgress(const Context& c)
+{
+    double selfDistance = c.destination.distance(c.self);
+    double bestCost = INF;
+    int best = NO_NEIGHBOR;
+    for (uint32_t i = 0; i < c.record.numNeighbors; i++) {
+        double progress = selfDistance - distanceToDestination(c, i);
+        if (progress <= 0)
+            continue;
+        double cost = estimateNeighborDelay(c, i, true) / progress;
+        if (cost < bestCost) {
+            bestCost = cost;
+            best = i;
+        }
+    }
+    return best;
+}
+
+//
+// Offload policies
+//
+
+// QueueGpsr::makeOffloadDecision
+int offloadRecorded(const Context& c)
+{
+    double slack = c.record.deadline > 0 ? c.record.deadline - c.record.time : INF;
+    gpsrcore::OffloadDecision decision = gpsrcore::makeOffloadDecision(c.params, c.self, c.destination, c.coreNeighbors, c.record.taskBits,
+            c.record.localCpuHz, c.record.localBacklogCycles, slack);
+    return decision.shouldOffload ? decision.target : PROCESS_LOCALLY;
+}
+
+// Offload to the fastest fresh CPU whenever it beats local processing, ignoring transfer cost in the choice
+int offloadMaxCpu(const Context& c)
+{
+    int best = NO_NEIGHBOR;
+    for (uint32_t i = 0; i < c.record.numNeighbors; i++) {
+        if (gpsrcore::estimateRemoteProcessingTime(c.params, c.coreNeighbors[i], c.record.taskBits) < INF && (best == NO_NEIGHBOR || c.neighbors[i].cpuOffloadHz > c.neighbors[best].cpuOffloadHz))
+            best = i;
+    }
+    return best != NO_NEIGHBOR && estimateOffloadTotalDelay(c, best) < estimateLocalTaskDelay(c) ? best : PROCESS_LOCALLY;
+}
+
+struct Policy {
+    std::string name;
+    std::function<int(const Context&)> forward;
+    std::function<int(const Context&)> offload;
+};
+
+std::vector<Policy> makePolicies(double thresholdOverride)
+{
+    auto threshold = [=](const Context& c) { return thresholdOverride >= 0 ? thresholdOverride : c.header.distanceEqualityThreshold; };
+    return {
+        { "recorded", [=](const Context& c) { return forwardRecorded(c, c.header.flags & TRACE_DELAY_TIEBREAKER, c.header.flags & TRACE_QUEUE_DELAY, threshold(c)); }, offloadRecorded },
+        { "greedy", [](const Context& c) { return forwardRecorded(c, false, false, 0); }, offloadRecorded },
+        { "tiebreaker", [=](const Context& c) { return forwardRecorded(c, true, true, threshold(c)); }, offloadRecorded },
+        { "mindelay", forwardMinDelayPerProgress, offloadRecorded },
+        { "local", [=](const Context& c) { return forwardRecorded(c, c.header.flags & TRACE_DELAY_TIEBREAKER, c.header.flags & TRACE_QUEUE_DELAY, threshold(c)); },
+                   [](const Context&) { return PROCESS_LOCALLY; } },
+        { "maxcpu", [=](const Context& c) { return forwardRecorded(c, c.header.flags & TRACE_DELAY_TIEBREAKER, c.header.flags & TRACE_QUEUE_DELAY, threshold(c)); }, offloadMaxCpu },
+    };
+}
+
+//
+// Evaluation
+//
+
+struct Stats {
+    long forwardDecisions = 0;
+    long forwardAgreements = 0;
+    long forwardNoNeighbor = 0;
+    double forwardDelaySum = 0;     // estimated hop delay of the chosen neighbor
+    double forwardProgressSum = 0;  // distance gained towards the destination
+    long offloadDecisions = 0;
+    long offloadAgreements = 0;
+    long offloaded = 0;
+    long offloadInfeasible = 0;     // chosen option misses the deadline by estimate
+    double offloadDelaySum = 0;     // estimated task completion delay of the choice
+    long offloadDelayCount = 0;
+
+    void add(const Stats& o)
+    {
+        forwardDecisions += o.forwardDecisions;
+        forwardAgreements += o.forwardAgreements;
+        forwardNoNeighbor += o.forwardNoNeighbor;
+        forwardDelaySum += o.forwardDelaySum;
+        forwardProgressSum += o.forwardProgressSum;
+        offloadDecisions += o.offloadDecisions;
+        offloadAgreements += o.offloadAgreements;
+        offloaded += o.offloaded;
+        offloadInfeasible += o.offloadInfeasible;
+        offloadDelaySum += o.offloadDelaySum;
+        offloadDelayCount += o.offloadDelayCount;
+    }
+};
+
+uint32_t chosenAddress(const Context& c, int choice)
+{
+    if (choice == PROCESS_LOCALLY)
+        return c.record.node;
+    return choice == NO_NEIGHBOR ? 0 : c.neighbors[choice].address;
+}
+
+void evaluate(const Policy& policy, const Context& c, Stats& stats)
+{
+    if (c.record.kind == DECISION_FORWARD) {
+        // perimeter decisions depend on face state that is not part of the trace
+        if (c.record.routingModeBefore != GREEDY)
+            return;
+        int choice = policy.forward(c);
+        bool recordedFallback = c.record.routingModeAfter == PERIMETER;
+        stats.forwardDecisions++;
+        if (choice == NO_NEIGHBOR) {
+            stats.forwardNoNeighbor++;
+            stats.forwardAgreements += recordedFallback;
+            return;
+        }
+        stats.forwardAgreements += !recordedFallback && chosenAddress(c, choice) == c.record.chosen;
+        stats.forwardDelaySum += estimateNeighborDelay(c, choice, true);
+        stats.forwardProgressSum += c.destination.distance(c.self) - distanceToDestination(c, choice);
+    }
+    else if (c.record.kind == DECISION_OFFLOAD) {
+        int choice = policy.offload(c);
+        stats.offloadDecisions++;
+        stats.offloadAgreements += chosenAddress(c, choice) == c.record.chosen;
+        double delay = choice >= 0 ? estimateOffloadTotalDelay(c, choice) : estimateLocalTaskDelay(c);
+        stats.offloaded += choice >= 0;
+        if (c.record.deadline > 0 && c.record.time + delay > c.record.deadline)
+            stats.offloadInfeasible++;
+        if (delay < INF) {
+            stats.offloadDelaySum += delay;
+            stats.offloadDelayCount++;
+        }
+    }
+}
+
+std::vector<std::string> split(const std::string& text, char separator)
+{
+    std::vector<std::string> parts;
+    std::stringstream stream(text);
+    std::string part;
+    while (std::getline(stream, part, separator))
+        if (!part.empty())
+            parts.push_back(part);
+    return parts;
+}
+
+void usage()
+{
+    std::fprintf(stderr,
+            "Usage: decisionreplay [options] trace...\n"
+            "  -t <n>         worker threads (default: hardware concurrency)\n"
+            "  -p <list>      comma-separated policies (default: all)\n"
+            "                 recorded, greedy, tiebreaker, mindelay, local, maxcpu\n"
+            "  -T <meters>    override the distance equality threshold of the trace\n");
+    std::exit(1);
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    unsigned numThreads = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<std::string> policyNames;
+    double thresholdOverride = -1;
+    std::vector<std::string> files;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "-t" && i + 1 < argc)
+            numThreads = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "-p" && i + 1 < argc)
+            policyNames = split(argv[++i], ',');
+        else if (arg == "-T" && i + 1 < argc)
+            thresholdOverride = std::atof(argv[++i]);
+        else if (!arg.empty() && arg[0] == '-')
+            usage();
+        else
+            files.push_back(arg);
+    }
+    if (files.empty())
+        usage();
+
+    std::vector<Policy> policies;
+    for (const auto& policy : makePolicies(thresholdOverride))
+        if (policyNames.empty() || std::find(policyNames.begin(), policyNames.end(), policy.name) != policyNames.end())
+            policies.push_back(policy);
+    if (policies.empty()) {
+        std::fprintf(stderr, "No known policy selected\n");
+        return 1;
+    }
+
+    std::vector<DecisionTraceReader> traces(files.size());
+    size_t numRecords = 0;
+    for (size_t i = 0; i < files.size(); i++) {
+        std::string error = traces[i].load(files[i]);
+        if (!error.empty()) {
+            std::fprintf(stderr, "Error: %s\n", error.c_str());
+            return 1;
+        }
+        numRecords += traces[i].getNumRecords();
+    }
+
+    // Work is handed out in blocks of records through a shared counter
+    const size_t blockSize = 4096;
+    std::vector<std::pair<size_t, size_t>> blocks;  // (trace, first record)
+    for (size_t t = 0; t < traces.size(); t++)
+        for (size_t r = 0; r < traces[t].getNumRecords(); r += blockSize)
+            blocks.push_back({ t, r });
+    std::atomic<size_t> nextBlock(0);
+    std::vector<std::vector<Stats>> threadStats(numThreads, std::vector<Stats>(policies.size()));
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (unsigned w = 0; w < numThreads; w++) {
+        workers.emplace_back([&, w]() {
+            std::vector<gpsrcore::Neighbor> neighbors;
+            for (size_t b; (b = nextBlock++) < blocks.size();) {
+                const DecisionTraceReader& trace = traces[blocks[b].first];
+                gpsrcore::Params params = makeParams(trace.getHeader());
+                size_t end = std::min(blocks[b].second + blockSize, trace.getNumRecords());
+                for (size_t r = blocks[b].second; r < end; r++) {
+                    const DecisionRecord& record = trace.getRecord(r);
+                    convertNeighbors(record, trace.getNeighbors(r), neighbors);
+                    params.localQueueDelay = record.localQueueDelay;
+                    Context c { trace.getHeader(), record, trace.getNeighbors(r), params,
+                                gpsrcore::Vec3(record.selfX, record.selfY, record.selfZ),
+                                gpsrcore::Vec3(record.destX, record.destY, record.destZ), neighbors };
+                    for (size_t p = 0; p < policies.size(); p++)
+                        evaluate(policies[p], c, threadStats[w][p]);
+                }
+            }
+        });
+    }
+    for (auto& worker : workers)
+        worker.join();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::printf("%zu decision(s) from %zu trace(s), %u thread(s), %.3f s (%.2f M decisions x policies / s)\n\n",
+            numRecords, traces.size(), numThreads, seconds, numRecords * policies.size() / std::max(seconds, 1e-9) / 1e6);
+    std::printf("%-12s %10s %9s %9s %12s %11s | %10s %9s %9s %9s %12s\n", "policy", "forward", "agree%", "noHop%",
+            "hopDelay[ms]", "progress[m]", "offload", "agree%", "remote%", "late%", "taskDelay[ms]");
+    for (size_t p = 0; p < policies.size(); p++) {
+        Stats s;
+        for (unsigned w = 0; w < numThreads; w++)
+            s.add(threadStats[w][p]);
+        long hops = s.forwardDecisions - s.forwardNoNeighbor;
+        auto pct = [](long a, long b) { return b > 0 ? 100.0 * a / b : 0.0; };
+        std::printf("%-12s %10ld %9.2f %9.2f %12.4f %11.2f | %10ld %9.2f %9.2f %9.2f %12.4f\n", policies[p].name.c_str(),
+                s.forwardDecisions, pct(s.forwardAgreements, s.forwardDecisions), pct(s.forwardNoNeighbor, s.forwardDecisions),
+                hops > 0 ? 1e3 * s.forwardDelaySum / hops : 0.0, hops > 0 ? s.forwardProgressSum / hops : 0.0,
+                s.offloadDecisions, pct(s.offloadAgreements, s.offloadDecisions), pct(s.offloaded, s.offloadDecisions),
+                pct(s.offloadInfeasible, s.offloadDecisions), s.offloadDelayCount > 0 ? 1e3 * s.offloadDelaySum / s.offloadDelayCount : 0.0);
+    }
+    return 0;
+}